@@ -906,6 +906,62 @@ void Execute_MatMul_CPU(bool async) {
 TEST(CAPI, Execute_MatMul_CPU) { Execute_MatMul_CPU(false); }
 TEST(CAPI, Execute_MatMul_CPUAsync) { Execute_MatMul_CPU(true); }
 
+void ExpectMatMulProduct(TFE_Op* matmul, const std::vector<float>& expected) {
+  TF_Status* status = TF_NewStatus();
+  TFE_TensorHandle* retvals[1] = {nullptr};
+  int num_retvals = 1;
+  TFE_Execute(matmul, &retvals[0], &num_retvals, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TF_Tensor* t = TFE_TensorHandleResolve(retvals[0], status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_DeleteTensorHandle(retvals[0]);
+  std::vector<float> product(expected.size());
+  ASSERT_EQ(product.size() * sizeof(float), TF_TensorByteSize(t));
+  memcpy(product.data(), TF_TensorData(t), TF_TensorByteSize(t));
+  TF_DeleteTensor(t);
+  EXPECT_EQ(expected, product);
+  TF_DeleteStatus(status);
+}
+
+void Execute_MatMul_CPU_Repeatedly(bool async) {
+  TF_Status* status = TF_NewStatus();
+  TFE_ContextOptions* opts = TFE_NewContextOptions();
+  TFE_ContextOptionsSetAsync(opts, static_cast<unsigned char>(async));
+  TFE_Context* ctx = TFE_NewContext(opts, status);
+  CHECK_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_DeleteContextOptions(opts);
+
+  TFE_TensorHandle* m = TestMatrixTensorHandle();
+  TFE_Op* matmul = MatMulOp(ctx, m, m);
+  // The second execution reuses the kernel cached in the operation.
+  ExpectMatMulProduct(matmul, {7, 10, 15, 22});
+  ExpectMatMulProduct(matmul, {7, 10, 15, 22});
+
+  // Changing an attribute or the device must not reuse the cached kernel.
+  TFE_OpSetAttrBool(matmul, "transpose_a", 1);
+  ExpectMatMulProduct(matmul, {10, 14, 14, 20});
+  TFE_OpSetDevice(matmul, "/job:localhost/replica:0/task:0/device:CPU:0",
+                  status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  ExpectMatMulProduct(matmul, {10, 14, 14, 20});
+
+  // Clearing the context's caches deletes the cached kernel.
+  TFE_ContextClearCaches(ctx, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  ExpectMatMulProduct(matmul, {10, 14, 14, 20});
+
+  TFE_DeleteOp(matmul);
+  TFE_DeleteTensorHandle(m);
+  TFE_DeleteContext(ctx);
+  TF_DeleteStatus(status);
+}
+TEST(CAPI, Execute_MatMul_CPU_Repeatedly) {
+  Execute_MatMul_CPU_Repeatedly(false);
+}
+TEST(CAPI, Execute_MatMul_CPU_RepeatedlyAsync) {
+  Execute_MatMul_CPU_Repeatedly(true);
+}
+
 void Execute_MatMul_CPU_Runtime_Error(bool async) {
   TF_Status* status = TF_NewStatus();
   TFE_ContextOptions* opts = TFE_NewContextOptions();
@@ -36,10 +36,12 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/denormal.h"
 #include "tensorflow/core/platform/setround.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -558,8 +560,156 @@ bool ReplaceTensorWithConstant(
   return true;
 }
 
+// Computes the ConstantFoldingCache key for fetching `fetch_names` from
+// `constant_graph`. The key only depends on the ops, attributes and edges of
+// the graph, not on node names, which differ between otherwise identical
+// graphs because folded constants get unique names. Returns false if the
+// outputs must not be cached: because they are computed by functions, whose
+// definitions are not part of the key, or read from files.
+bool ConstantGraphCacheKey(const Graph& constant_graph,
+                           const std::vector<string>& fetch_names,
+                           FunctionLibraryRuntime* function_library,
+                           Fprint128* key) {
+  const FunctionLibraryDefinition* flib_def =
+      function_library == nullptr
+          ? nullptr
+          : function_library->GetFunctionLibraryDefinition();
+  std::unordered_map<string, int> canonical_ids;
+  string canonical;
+  strings::StrAppend(&canonical, constant_graph.versions().producer(), ";");
+  for (const Node* n : constant_graph.op_nodes()) {
+    if (n->type_string() == "ImmutableConst" ||
+        (flib_def != nullptr && flib_def->Find(n->type_string()) != nullptr)) {
+      return false;
+    }
+    // Ops such as PartitionedCall, StatelessIf and StatelessWhile only name
+    // the functions they call, which may be redefined under the same name.
+    for (const auto& attr : n->attrs()) {
+      if (attr.second.has_func() || attr.second.list().func_size() > 0) {
+        return false;
+      }
+    }
+    const int canonical_id = canonical_ids.size();
+    canonical_ids[n->name()] = canonical_id;
+
+    strings::StrAppend(&canonical, n->type_string(), "(");
+    std::vector<const Edge*> inputs(n->num_inputs(), nullptr);
+    for (const Edge* e : n->in_edges()) {
+      if (!e->IsControlEdge()) inputs[e->dst_input()] = e;
+    }
+    for (const Edge* e : inputs) {
+      if (e == nullptr) return false;
+      auto it = canonical_ids.find(e->src()->name());
+      if (it == canonical_ids.end()) return false;
+      strings::StrAppend(&canonical, it->second, ":", e->src_output(), ",");
+    }
+    strings::StrAppend(&canonical, ")");
+
+    std::vector<std::pair<string, const AttrValue*>> attrs;
+    for (const auto& attr : n->attrs()) {
+      attrs.emplace_back(attr.first, &attr.second);
+    }
+    std::sort(attrs.begin(), attrs.end());
+    for (const auto& attr : attrs) {
+      string serialized;
+      if (!SerializeToStringDeterministic(*attr.second, &serialized)) {
+        return false;
+      }
+      const Fprint128 fp = Fingerprint128(serialized);
+      strings::StrAppend(&canonical, attr.first, "=", fp.low64, ".", fp.high64,
+                         ",");
+    }
+    strings::StrAppend(&canonical, ";");
+  }
+  for (const string& fetch_name : fetch_names) {
+    const auto colon = fetch_name.rfind(':');
+    auto it = canonical_ids.find(fetch_name.substr(0, colon));
+    if (it == canonical_ids.end()) return false;
+    strings::StrAppend(&canonical, "fetch=", it->second,
+                       fetch_name.substr(colon), ";");
+  }
+  *key = Fingerprint128(canonical);
+  return true;
+}
+
 }  // namespace
 
+ConstantFoldingCache::ConstantFoldingCache(int64 capacity_bytes)
+    : capacity_bytes_(capacity_bytes) {}
+
+/* static */
+ConstantFoldingCache* ConstantFoldingCache::Global() {
+  static ConstantFoldingCache* cache = []() {
+    int64 capacity_mb;
+    Status s =
+        ReadInt64FromEnvVar("TF_CONSTANT_FOLDING_CACHE_MB", 0, &capacity_mb);
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      capacity_mb = 0;
+    }
+    return new ConstantFoldingCache(std::max<int64>(capacity_mb, 0) << 20);
+  }();
+  return cache;
+}
+
+bool ConstantFoldingCache::Lookup(const Fprint128& key,
+                                  std::vector<Tensor>* outputs) {
+  mutex_lock l(mu_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    ++num_misses_;
+    return false;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  *outputs = it->second->outputs;
+  ++num_hits_;
+  return true;
+}
+
+void ConstantFoldingCache::Insert(const Fprint128& key,
+                                  const std::vector<Tensor>& outputs) {
+  // Also count the entry itself, so that empty tensors are bounded too.
+  int64 bytes = sizeof(Entry);
+  for (const Tensor& t : outputs) bytes += t.TotalBytes();
+  if (bytes > capacity_bytes_) return;
+
+  mutex_lock l(mu_);
+  if (entries_.count(key) > 0) return;
+  while (size_bytes_ + bytes > capacity_bytes_) {
+    const Entry& last = lru_.back();
+    size_bytes_ -= last.bytes;
+    entries_.erase(last.key);
+    lru_.pop_back();
+  }
+  lru_.push_front({key, outputs, bytes});
+  entries_[key] = lru_.begin();
+  size_bytes_ += bytes;
+}
+
+void ConstantFoldingCache::Clear() {
+  mutex_lock l(mu_);
+  lru_.clear();
+  entries_.clear();
+  size_bytes_ = 0;
+  num_hits_ = 0;
+  num_misses_ = 0;
+}
+
+int64 ConstantFoldingCache::num_hits() const {
+  mutex_lock l(mu_);
+  return num_hits_;
+}
+
+int64 ConstantFoldingCache::num_misses() const {
+  mutex_lock l(mu_);
+  return num_misses_;
+}
+
+int64 ConstantFoldingCache::size_bytes() const {
+  mutex_lock l(mu_);
+  return size_bytes_;
+}
+
 Status ConstantFold(const ConstantFoldingOptions& opts,
                     FunctionLibraryRuntime* function_library, Env* env,
                     const Device* partition_device, Graph* graph,
@@ -631,13 +781,26 @@ Status ConstantFold(const ConstantFoldingOptions& opts,
     graph_runner.reset(nullptr);
   });
 
-  Status s =
-      graph_runner->Run(constant_graph.get(), function_library, {} /* inputs*/,
-                        tensors_to_fetch_names, &outputs);
-  if (!s.ok()) {
-    VLOG(1) << "Could not fetch constants: " << s;
-    *was_mutated = false;
-    return s;
+  ConstantFoldingCache* cache =
+      opts.cache != nullptr ? opts.cache : ConstantFoldingCache::Global();
+  // Don't compute the key, which is costly, if the cache is disabled.
+  Fprint128 cache_key;
+  const bool use_cache =
+      cache->capacity_bytes() > 0 &&
+      ConstantGraphCacheKey(*constant_graph, tensors_to_fetch_names,
+                            function_library, &cache_key);
+  if (use_cache && cache->Lookup(cache_key, &outputs)) {
+    VLOG(1) << "Reusing " << outputs.size() << " cached constants";
+  } else {
+    Status s = graph_runner->Run(constant_graph.get(), function_library,
+                                 {} /* inputs*/, tensors_to_fetch_names,
+                                 &outputs);
+    if (!s.ok()) {
+      VLOG(1) << "Could not fetch constants: " << s;
+      *was_mutated = false;
+      return s;
+    }
+    if (use_cache) cache->Insert(cache_key, outputs);
   }
 
   // Fetch the constant tensors and replace the corresponding tensors in the
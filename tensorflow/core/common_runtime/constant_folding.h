@@ -16,11 +16,18 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_CONSTANT_FOLDING_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_CONSTANT_FOLDING_H_
 
+#include <list>
+#include <unordered_map>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 
 // TODO(skyewm): can this be combined with EvaluateConstantTensor?
 
@@ -31,6 +38,8 @@ namespace tensorflow {
 using ConstantFoldNameGenerator =
     std::function<string(Graph* graph, string old_name)>;
 
+class ConstantFoldingCache;
+
 // Options specific to constant folding optimizations.
 struct ConstantFoldingOptions {
   // If "consider" is not a nullptr, then only constant fold a node "n" if
@@ -49,6 +58,60 @@ struct ConstantFoldingOptions {
   // default id generator that monotonically increases is used if nullptr is
   // passed.
   ConstantFoldNameGenerator generate_new_name = nullptr;
+
+  // The cache of folded constants to use. If nullptr, the process-wide cache
+  // is used.
+  ConstantFoldingCache* cache = nullptr;  // not owned
+};
+
+// A cache of the tensors that ConstantFold() computed, keyed by a fingerprint
+// of the subgraph that was evaluated. When the same graph is optimized again,
+// for example after Session::Extend or when a function is instantiated
+// repeatedly, ConstantFold() reuses the cached tensors instead of running the
+// subgraph. The cache holds at most `capacity_bytes` of tensor data and evicts
+// the least recently used entries first.
+class ConstantFoldingCache {
+ public:
+  explicit ConstantFoldingCache(int64 capacity_bytes);
+
+  // Returns the process-wide cache used by ConstantFold(). Its capacity is
+  // read from the TF_CONSTANT_FOLDING_CACHE_MB environment variable. It
+  // defaults to 0, which disables caching: the key of a subgraph costs a
+  // serialization and a fingerprint of every constant it reads.
+  static ConstantFoldingCache* Global();
+
+  // Returns true and sets `*outputs` if there is an entry for `key`.
+  bool Lookup(const Fprint128& key, std::vector<Tensor>* outputs);
+
+  // Stores `outputs` under `key`, evicting older entries to stay within the
+  // capacity. Does nothing if `outputs` alone exceed the capacity.
+  void Insert(const Fprint128& key, const std::vector<Tensor>& outputs);
+
+  void Clear();
+
+  int64 capacity_bytes() const { return capacity_bytes_; }
+  int64 num_hits() const;
+  int64 num_misses() const;
+  int64 size_bytes() const;
+
+ private:
+  struct Entry {
+    Fprint128 key;
+    std::vector<Tensor> outputs;
+    int64 bytes;
+  };
+
+  const int64 capacity_bytes_;
+  mutable mutex mu_;
+  // Most recently used first.
+  std::list<Entry> lru_ GUARDED_BY(mu_);
+  std::unordered_map<Fprint128, std::list<Entry>::iterator, Fprint128Hasher>
+      entries_ GUARDED_BY(mu_);
+  int64 size_bytes_ GUARDED_BY(mu_) = 0;
+  int64 num_hits_ GUARDED_BY(mu_) = 0;
+  int64 num_misses_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ConstantFoldingCache);
 };
 
 // Perform constant folding optimization on "graph".
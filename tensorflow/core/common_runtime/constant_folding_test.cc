@@ -22,11 +22,13 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/constant_folding.h"
 
 #include "tensorflow/cc/ops/array_ops_internal.h"
+#include "tensorflow/cc/ops/functional_ops.h"
 #include "tensorflow/cc/ops/sendrecv_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/node_def_util.h"
@@ -41,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/platform/null_file_system.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
 
 namespace tensorflow {
 namespace {
@@ -134,6 +137,141 @@ TEST_F(ConstantFoldingTest, Basic) {
                          {2, 2});
 }
 
+TEST_F(ConstantFoldingTest, ReusesCachedConstants) {
+  ConstantFoldingCache cache(64 << 20);
+  ConstantFoldingOptions opts;
+  opts.cache = &cache;
+  bool was_mutated;
+  {
+    Scope s = Scope::NewRootScope();
+    BuildSimpleGraph(&s);
+    Graph g(OpRegistry::Global());
+    TF_ASSERT_OK(s.ToGraph(&g));
+    TF_ASSERT_OK(ConstantFold(opts, nullptr, Env::Default(), nullptr, &g,
+                              &was_mutated));
+    EXPECT_TRUE(was_mutated);
+    EXPECT_EQ(0, cache.num_hits());
+    EXPECT_EQ(1, cache.num_misses());
+  }
+
+  // The same subgraph under other names is not evaluated again.
+  Scope s = Scope::NewRootScope().NewSubScope("other");
+  BuildSimpleGraph(&s);
+  Graph g(OpRegistry::Global());
+  TF_ASSERT_OK(s.ToGraph(&g));
+  TF_ASSERT_OK(
+      ConstantFold(opts, nullptr, Env::Default(), nullptr, &g, &was_mutated));
+  EXPECT_TRUE(was_mutated);
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_EQ(1, cache.num_misses());
+
+  std::unordered_map<string, Node*> index = g.BuildNodeNameIndex();
+  Node* s1 = index.at("other/s1");
+  Node* s2 = index.at("other/s2");
+  ExpectNodeClose<float>(*(s1->in_nodes().begin()), {1.0, 2.0, 3.0, 4.0},
+                         {2, 2});
+  ExpectNodeClose<float>(*(s2->in_nodes().begin()), {2.0, 1.0, 4.0, 3.0},
+                         {2, 2});
+
+  // Different constants are a different subgraph.
+  Scope s3 = Scope::NewRootScope();
+  auto a = ops::Const<float>(s3, {2.0, 0.0, 0.0, 2.0}, {2, 2});
+  auto m = ops::MatMul(s3, a, a);
+  ops::_Send(s3.WithOpName("s"), m, "m", "sender", 0, "receiver");
+  Graph g3(OpRegistry::Global());
+  TF_ASSERT_OK(s3.ToGraph(&g3));
+  TF_ASSERT_OK(
+      ConstantFold(opts, nullptr, Env::Default(), nullptr, &g3, &was_mutated));
+  EXPECT_TRUE(was_mutated);
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_EQ(2, cache.num_misses());
+  index = g3.BuildNodeNameIndex();
+  ExpectNodeClose<float>(*(index.at("s")->in_nodes().begin()),
+                         {4.0, 0.0, 0.0, 4.0}, {2, 2});
+}
+
+// Folds PartitionedCall(f=Fn) of the constant 3, where Fn is defined by
+// `fdef`, and returns the folded value.
+float FoldCallToFn(const FunctionDef& fdef, ConstantFoldingCache* cache) {
+  FunctionDefLibrary proto;
+  *proto.add_function() = fdef;
+  FunctionLibraryDefinition lib_def(OpRegistry::Global(), proto);
+  std::vector<std::unique_ptr<Device>> devices;
+  TF_CHECK_OK(DeviceFactory::AddDevices(
+      SessionOptions(), "/job:localhost/replica:0/task:0", &devices));
+  DeviceMgr device_mgr(std::move(devices));
+  ProcessFunctionLibraryRuntime pflr(&device_mgr, Env::Default(),
+                                     TF_GRAPH_DEF_VERSION, &lib_def,
+                                     OptimizerOptions());
+  FunctionLibraryRuntime* flr =
+      pflr.GetFLR("/job:localhost/replica:0/task:0/cpu:0");
+
+  Scope s = Scope::NewRootScope();
+  auto c = ops::Const<float>(s.WithOpName("c"), 3.0f);
+  NameAttrList f;
+  f.set_name("Fn");
+  ops::PartitionedCall call(s.WithOpName("call"), {c}, {DT_FLOAT}, f);
+  ops::_Send(s.WithOpName("send"), call.output[0], "call", "sender", 0,
+             "receiver");
+  Graph g(lib_def);
+  TF_CHECK_OK(s.ToGraph(&g));
+
+  ConstantFoldingOptions opts;
+  opts.cache = cache;
+  bool was_mutated;
+  TF_CHECK_OK(ConstantFold(opts, flr, Env::Default(), nullptr, &g,
+                           &was_mutated));
+  CHECK(was_mutated);
+  const Node* folded = *g.BuildNodeNameIndex().at("send")->in_nodes().begin();
+  const TensorProto* tensor_proto;
+  TF_CHECK_OK(GetNodeAttr(folded->attrs(), "value", &tensor_proto));
+  Tensor t;
+  CHECK(t.FromProto(*tensor_proto));
+  return t.scalar<float>()();
+}
+
+TEST_F(ConstantFoldingTest, DoesNotCacheFunctionCalls) {
+  ConstantFoldingCache cache(64 << 20);
+  const FunctionDef square = FunctionDefHelper::Define(
+      "Fn", {"x: float"}, {"y: float"}, {},
+      {{{"y"}, "Mul", {"x", "x"}, {{"T", DT_FLOAT}}}});
+  const FunctionDef twice = FunctionDefHelper::Define(
+      "Fn", {"x: float"}, {"y: float"}, {},
+      {{{"y"}, "Add", {"x", "x"}, {{"T", DT_FLOAT}}}});
+
+  // Redefining Fn under the same name changes the folded value.
+  EXPECT_EQ(9.0f, FoldCallToFn(square, &cache));
+  EXPECT_EQ(6.0f, FoldCallToFn(twice, &cache));
+  EXPECT_EQ(0, cache.num_hits());
+}
+
+TEST(ConstantFoldingCacheTest, EvictsLeastRecentlyUsed) {
+  // Room for two entries of 1000 floats, but not for three.
+  ConstantFoldingCache cache(10000);
+  const Fprint128 k1 = Fingerprint128("k1");
+  const Fprint128 k2 = Fingerprint128("k2");
+  const Fprint128 k3 = Fingerprint128("k3");
+  std::vector<Tensor> outputs = {Tensor(DT_FLOAT, TensorShape({1000}))};
+  cache.Insert(k1, outputs);
+  cache.Insert(k2, outputs);
+  std::vector<Tensor> found;
+  EXPECT_TRUE(cache.Lookup(k1, &found));
+  ASSERT_EQ(1, found.size());
+  EXPECT_EQ(outputs[0].data(), found[0].data());
+
+  cache.Insert(k3, outputs);
+  EXPECT_TRUE(cache.Lookup(k1, &found));
+  EXPECT_FALSE(cache.Lookup(k2, &found));
+  EXPECT_TRUE(cache.Lookup(k3, &found));
+  EXPECT_LE(cache.size_bytes(), 10000);
+
+  // Entries larger than the whole cache are not stored.
+  const Fprint128 k4 = Fingerprint128("k4");
+  cache.Insert(k4, {Tensor(DT_FLOAT, TensorShape({3000}))});
+  EXPECT_FALSE(cache.Lookup(k4, &found));
+  EXPECT_TRUE(cache.Lookup(k1, &found));
+}
+
 // Tests that different node creation ordering creates same graph after constant
 // folding.
 TEST_F(ConstantFoldingTest, DeterministicFolding) {
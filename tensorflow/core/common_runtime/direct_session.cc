@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/common_runtime/graph_optimizer.h"
+#include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/memory_types.h"
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
@@ -56,10 +57,12 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/byte_order.h"
@@ -87,13 +90,16 @@ Status NewThreadPoolFromThreadPoolOptions(
   if (num_threads == 0) {
     num_threads = NumInterOpThreadsFromSessionOptions(options);
   }
+  ThreadOptions thread_opts;
+  thread_opts.cpu_affinity.assign(thread_pool_options.cpu_affinity().begin(),
+                                  thread_pool_options.cpu_affinity().end());
   const string& name = thread_pool_options.global_name();
   if (name.empty()) {
     // Session-local threadpool.
     VLOG(1) << "Direct session inter op parallelism threads for pool "
             << pool_number << ": " << num_threads;
     *pool = new thread::ThreadPool(
-        options.env, ThreadOptions(), strings::StrCat("Compute", pool_number),
+        options.env, thread_opts, strings::StrCat("Compute", pool_number),
         num_threads, !options.config.experimental().disable_thread_spinning(),
         /*allocator=*/nullptr);
     *owned = true;
@@ -101,29 +107,41 @@ Status NewThreadPoolFromThreadPoolOptions(
   }
 
   // Global, named threadpool.
-  typedef std::pair<int32, thread::ThreadPool*> MapValue;
+  struct MapValue {
+    int32 num_threads = 0;
+    std::vector<int> cpu_affinity;
+    thread::ThreadPool* pool = nullptr;
+  };
   static std::map<string, MapValue>* global_pool_map =
       new std::map<string, MapValue>;
   static mutex* mu = new mutex();
   mutex_lock l(*mu);
   MapValue* mvalue = &(*global_pool_map)[name];
-  if (mvalue->second == nullptr) {
-    mvalue->first = thread_pool_options.num_threads();
-    mvalue->second = new thread::ThreadPool(
-        options.env, ThreadOptions(), strings::StrCat("Compute", pool_number),
+  if (mvalue->pool == nullptr) {
+    mvalue->num_threads = thread_pool_options.num_threads();
+    mvalue->cpu_affinity = thread_opts.cpu_affinity;
+    mvalue->pool = new thread::ThreadPool(
+        options.env, thread_opts, strings::StrCat("Compute", pool_number),
         num_threads, !options.config.experimental().disable_thread_spinning(),
         /*allocator=*/nullptr);
   } else {
-    if (mvalue->first != thread_pool_options.num_threads()) {
+    if (mvalue->num_threads != thread_pool_options.num_threads()) {
       return errors::InvalidArgument(
           "Pool ", name,
-          " configured previously with num_threads=", mvalue->first,
+          " configured previously with num_threads=", mvalue->num_threads,
           "; cannot re-configure with num_threads=",
           thread_pool_options.num_threads());
     }
+    if (mvalue->cpu_affinity != thread_opts.cpu_affinity) {
+      return errors::InvalidArgument(
+          "Pool ", name, " configured previously with cpu_affinity=[",
+          str_util::Join(mvalue->cpu_affinity, ","),
+          "]; cannot re-configure with cpu_affinity=[",
+          str_util::Join(thread_opts.cpu_affinity, ","), "]");
+    }
   }
   *owned = false;
-  *pool = mvalue->second;
+  *pool = mvalue->pool;
   return Status::OK();
 }
 
@@ -145,6 +163,22 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Returns true if running `graph` may modify state, e.g. assign a variable,
+// dequeue an element or draw random numbers. Only reading variables and
+// sending tensors between partitions is known not to.
+bool MayModifyState(const Graph& graph) {
+  static const auto* const kReadOnlyStatefulOps = new gtl::FlatSet<string>{
+      "IsVariableInitialized", "ReadVariableOp", "VarHandleOp",
+      "VarIsInitializedOp",    "Variable",       "VariableV2"};
+  for (const Node* n : graph.op_nodes()) {
+    if (n->op_def().is_stateful() && !n->IsSend() && !n->IsRecv() &&
+        kReadOnlyStatefulOps->count(n->type_string()) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -161,6 +195,9 @@ class DirectSessionFactory : public SessionFactory {
     if (options.config.graph_options().build_cost_model() > 0) {
       EnableCPUAllocatorFullStats(true);
     }
+    // Like the inter-op thread pools, a named intra-op thread pool can't be
+    // reused with other options.
+    TF_RETURN_IF_ERROR(LocalDevice::CreateNamedThreadPool(options));
     std::vector<std::unique_ptr<Device>> devices;
     TF_RETURN_IF_ERROR(DeviceFactory::AddDevices(
         options, "/job:localhost/replica:0/task:0", &devices));
@@ -266,6 +303,15 @@ DirectSession::DirectSession(const SessionOptions& options,
   } else {
     thread_pools_.emplace_back(GlobalThreadPool(options), false /* owned */);
   }
+  const auto& experimental = options_.config.experimental();
+  if (experimental.run_batching_timeout_micros() > 0) {
+    const int max_batch_size = experimental.run_batching_max_batch_size() > 0
+                                   ? experimental.run_batching_max_batch_size()
+                                   : 32;
+    run_batcher_.reset(new RunBatcher(
+        options_.env, experimental.run_batching_timeout_micros(),
+        max_batch_size));
+  }
   // The default value of sync_on_finish will be flipped soon and this
   // environment variable will be removed as well.
   const Status status =
@@ -691,6 +737,57 @@ Status DirectSession::Run(const RunOptions& run_options,
                           const std::vector<string>& target_nodes,
                           std::vector<Tensor>* outputs,
                           RunMetadata* run_metadata) {
+  // Steps whose RunMetadata or debugging output is requested are not
+  // batched, since it would describe the batched step. Steps with targets
+  // are not batched either, since a batch would run them only once.
+  if (run_batcher_ == nullptr || !target_nodes.empty() ||
+      run_options.trace_level() != RunOptions::NO_TRACE ||
+      run_options.output_partition_graphs() ||
+      !run_options.debug_options().debug_tensor_watch_opts().empty() ||
+      run_options.experimental().collective_graph_key() != 0) {
+    return RunUnbatched(run_options, inputs, output_names, target_nodes,
+                        outputs, run_metadata);
+  }
+  // The batch runs with the RunOptions of its first call, so only calls with
+  // the same RunOptions (e.g. timeout and inter-op thread pool) are batched.
+  string run_key;
+  if (!SerializeToStringDeterministic(run_options, &run_key)) {
+    return RunUnbatched(run_options, inputs, output_names, target_nodes,
+                        outputs, run_metadata);
+  }
+  // A batch would modify the state (e.g. assign a variable) only once for all
+  // of its calls. Errors are reported by RunUnbatched().
+  std::vector<string> input_tensor_names;
+  input_tensor_names.reserve(inputs.size());
+  for (const auto& it : inputs) {
+    input_tensor_names.push_back(it.first);
+  }
+  ExecutorsAndKeys* executors_and_keys;
+  RunStateArgs run_state_args(run_options.debug_options());
+  if (!CheckNotClosed().ok() || !CheckGraphCreated("Run()").ok() ||
+      !GetOrCreateExecutors(input_tensor_names, output_names, target_nodes,
+                            &executors_and_keys, &run_state_args)
+           .ok() ||
+      executors_and_keys->may_modify_state) {
+    return RunUnbatched(run_options, inputs, output_names, target_nodes,
+                        outputs, run_metadata);
+  }
+  return run_batcher_->Run(
+      inputs, output_names, run_key, outputs,
+      [this, &run_options, &output_names, &target_nodes, run_metadata](
+          const NamedTensorList& batch_inputs,
+          std::vector<Tensor>* batch_outputs) {
+        return RunUnbatched(run_options, batch_inputs, output_names,
+                            target_nodes, batch_outputs, run_metadata);
+      });
+}
+
+Status DirectSession::RunUnbatched(const RunOptions& run_options,
+                                   const NamedTensorList& inputs,
+                                   const std::vector<string>& output_names,
+                                   const std::vector<string>& target_nodes,
+                                   std::vector<Tensor>* outputs,
+                                   RunMetadata* run_metadata) {
   TF_RETURN_IF_ERROR(CheckNotClosed());
   TF_RETURN_IF_ERROR(CheckGraphCreated("Run()"));
   direct_session_runs->GetCell()->IncrementBy(1);
@@ -1248,6 +1345,8 @@ Status DirectSession::CreateExecutors(
       if (kernel && !OpSegment::ShouldOwnKernel(lib, kernel->type_string()))
         delete kernel;
     };
+    params.use_compiled_plan =
+        callable_options.run_options().experimental().use_compiled_plan();
 
     optimizer.Optimize(lib, options_.env, device, &partition_graph,
                        /*shape_map=*/nullptr);
@@ -1263,6 +1362,7 @@ Status DirectSession::CreateExecutors(
     TF_RETURN_IF_ERROR(EnsureMemoryTypes(DeviceType(device->device_type()),
                                          device->name(),
                                          partition_graph.get()));
+    ek->may_modify_state |= MayModifyState(*partition_graph);
     // NewLocalExecutor takes ownership of partition_graph.
     item->graph = partition_graph.get();
     item->executor = nullptr;
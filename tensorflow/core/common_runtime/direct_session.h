@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/graph_execution_state.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
+#include "tensorflow/core/common_runtime/run_batcher.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
@@ -155,6 +156,9 @@ class DirectSession : public Session {
     CallableOptions callable_options;
 
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+
+    // True if running the graph may modify state, e.g. assign a variable.
+    bool may_modify_state = false;
   };
 
   // A FunctionInfo object is created for every unique set of feeds/fetches.
@@ -209,6 +213,9 @@ class DirectSession : public Session {
     std::unique_ptr<Graph> graph;
     const DebugOptions& debug_options;
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+
+    // True if running the graph may modify state, e.g. assign a variable.
+    bool may_modify_state = false;
   };
 
   // Initializes the base execution state given the 'graph',
@@ -247,6 +254,14 @@ class DirectSession : public Session {
                                    ExecutorsAndKeys* executors_and_keys,
                                    RunMetadata* run_metadata);
 
+  // Runs a single step for Run(), without batching it with concurrent calls.
+  ::tensorflow::Status RunUnbatched(const RunOptions& run_options,
+                                    const NamedTensorList& inputs,
+                                    const std::vector<string>& output_names,
+                                    const std::vector<string>& target_nodes,
+                                    std::vector<Tensor>* outputs,
+                                    RunMetadata* run_metadata);
+
   // Returns whether inter-op execution uses a global pool or the input
   // `run_options` requests being run on inter_op_thread_pool = 0 in case
   // multiple pools are configured.
@@ -394,6 +409,10 @@ class DirectSession : public Session {
   // Global timeout for all blocking operations in this session.
   const int64 operation_timeout_in_ms_ = 0;
 
+  // Coalesces concurrent Run() calls, if enabled by
+  // ConfigProto.Experimental.run_batching_timeout_micros.
+  std::unique_ptr<RunBatcher> run_batcher_;
+
   // Manages all the cost models for the graphs executed in this session.
   CostModelManager cost_model_manager_;
 
@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
@@ -403,6 +404,35 @@ TEST_F(DirectSessionMinusAXTest, TestFeed_Callable) {
   EXPECT_FLOAT_EQ(39.0, mat(1, 0));
 }
 
+TEST_F(DirectSessionMinusAXTest, TestFeed_CompiledPlanCallable) {
+  Initialize({1, 2, 3, 4});
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+
+  TF_ASSERT_OK(session->Create(def_));
+
+  // The graph spans two devices, so its partitions contain send/recv nodes
+  // and must fall back to the default executor.
+  CallableOptions callable_options =
+      MakeCallableOptions({x_}, {y_ + ":0"}, {});
+  callable_options.mutable_run_options()
+      ->mutable_experimental()
+      ->set_use_compiled_plan(true);
+  Session::CallableHandle handle;
+  TF_ASSERT_OK(session->MakeCallable(callable_options, &handle));
+  Tensor t(DT_FLOAT, TensorShape({2, 1}));
+  t.matrix<float>()(0, 0) = 5;
+  t.matrix<float>()(1, 0) = 6;
+  std::vector<Tensor> outputs;
+
+  TF_ASSERT_OK(session->RunCallable(handle, {t}, &outputs, nullptr));
+
+  ASSERT_EQ(1, outputs.size());
+  auto mat = outputs[0].matrix<float>();
+  EXPECT_FLOAT_EQ(17.0, mat(0, 0));
+  EXPECT_FLOAT_EQ(39.0, mat(1, 0));
+}
+
 TEST_F(DirectSessionMinusAXTest, TestConcurrency) {
   Initialize({1, 2, 3, 4});
   auto session = CreateSession();
@@ -435,6 +465,101 @@ TEST_F(DirectSessionMinusAXTest, TestConcurrency) {
   delete tp;
 }
 
+TEST(DirectSessionTest, TestConcurrencyWithRunBatching) {
+  Graph graph(OpRegistry::Global());
+  Tensor a_tensor(DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&a_tensor, {1, 2, 3, 4});
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Node* x =
+      test::graph::Constant(&graph, Tensor(DT_FLOAT, TensorShape({1, 2})));
+  // Each row of y only depends on the same row of x.
+  Node* y = test::graph::Matmul(&graph, x, a, false, false);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+
+  SessionOptions options;
+  auto* experimental = options.config.mutable_experimental();
+  experimental->set_run_batching_timeout_micros(1000);
+  experimental->set_run_batching_max_batch_size(4);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+
+  // Feed a different x in each thread, so that mixing up the rows of
+  // batched runs would be noticed.
+  thread::ThreadPool* tp = new thread::ThreadPool(Env::Default(), "test", 4);
+  auto fn = [&session, x, y](float value) {
+    for (int i = 0; i < 100; ++i) {
+      std::vector<std::pair<string, Tensor>> inputs = {
+          {x->name(), test::AsTensor<float>({value, 1}, {1, 2})}};
+      std::vector<Tensor> outputs;
+      TF_ASSERT_OK(session->Run(inputs, {y->name() + ":0"}, {}, &outputs));
+      ASSERT_EQ(1, outputs.size());
+      test::ExpectTensorEqual<float>(
+          test::AsTensor<float>({value + 3, 2 * value + 4}, {1, 2}),
+          outputs[0]);
+    }
+  };
+  for (int i = 0; i < 4; ++i) {
+    tp->Schedule([fn, i]() { fn(i); });
+  }
+
+  // Wait for the functions to finish.
+  delete tp;
+}
+
+TEST(DirectSessionTest, RunBatchingSkipsStepsThatModifyState) {
+  Graph graph(OpRegistry::Global());
+  Node* var = test::graph::Var(&graph, DT_FLOAT, TensorShape({1, 2}));
+  Node* init = test::graph::Assign(
+      &graph, var,
+      test::graph::Constant(&graph, test::AsTensor<float>({0, 0}, {1, 2})));
+  Node* one =
+      test::graph::Constant(&graph, test::AsTensor<float>({1, 1}, {1, 2}));
+  Node* count;
+  TF_ASSERT_OK(NodeBuilder(graph.NewName("count"), "AssignAdd")
+                   .Input(var)
+                   .Input(one)
+                   .Finalize(&graph, &count));
+  Node* x =
+      test::graph::Constant(&graph, Tensor(DT_FLOAT, TensorShape({1, 2})));
+  // Each row of y can be split, but a batch would only count once.
+  Node* y = test::graph::Add(&graph, x, count);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+
+  SessionOptions options;
+  auto* experimental = options.config.mutable_experimental();
+  experimental->set_run_batching_timeout_micros(1000);
+  experimental->set_run_batching_max_batch_size(4);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+  TF_ASSERT_OK(session->Run({}, {}, {init->name()}, nullptr));
+
+  thread::ThreadPool* tp = new thread::ThreadPool(Env::Default(), "test", 4);
+  for (int i = 0; i < 4; ++i) {
+    tp->Schedule([&session, x, y]() {
+      for (int i = 0; i < 25; ++i) {
+        std::vector<Tensor> outputs;
+        TF_ASSERT_OK(session->Run(
+            {{x->name(), test::AsTensor<float>({0, 0}, {1, 2})}},
+            {y->name() + ":0"}, {}, &outputs));
+        ASSERT_EQ(1, outputs.size());
+        EXPECT_EQ(TensorShape({1, 2}), outputs[0].shape());
+      }
+    });
+  }
+  delete tp;
+
+  // Each Run() call incremented the variable.
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {var->name() + ":0"}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({100, 100}, {1, 2}),
+                                 outputs[0]);
+}
+
 TEST_F(DirectSessionMinusAXTest, TestConcurrency_Callable) {
   Initialize({1, 2, 3, 4});
   auto session = CreateSession();
@@ -897,6 +1022,59 @@ TEST(DirectSessionTest, TestTensorConnectionUseTwice) {
   TF_ASSERT_OK(session->ReleaseCallable(handle));
 }
 
+TEST(DirectSessionTest, CompiledPlanCallable) {
+  Graph graph(OpRegistry::Global());
+
+  Tensor a_tensor(DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&a_tensor, {1, 2, 3, 4});
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Tensor x_tensor(DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&x_tensor, {1, 1});
+  Node* x = test::graph::Constant(&graph, x_tensor);
+  // z = -(A * x) + A * x
+  Node* y = test::graph::Matmul(&graph, a, x, false, false);
+  Node* y_neg = test::graph::Unary(&graph, "Neg", y);
+  Node* z = test::graph::Binary(&graph, "Add", y_neg, y);
+  for (Node* n : {a, x, y, y_neg, z}) {
+    n->set_assigned_device_name("/job:localhost/replica:0/task:0/cpu:0");
+  }
+
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+
+  CallableOptions callable_options =
+      MakeCallableOptions({x->name()}, {y_neg->name() + ":0", z->name()}, {});
+  callable_options.mutable_run_options()
+      ->mutable_experimental()
+      ->set_use_compiled_plan(true);
+  Session::CallableHandle handle;
+  TF_ASSERT_OK(session->MakeCallable(callable_options, &handle));
+
+  for (int i = 0; i < 3; ++i) {
+    Tensor t(DT_FLOAT, TensorShape({2, 1}));
+    test::FillValues<float>(&t, {5.0f + i, 6});
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->RunCallable(handle, {t}, &outputs, nullptr));
+    ASSERT_EQ(2, outputs.size());
+    test::ExpectTensorEqual<float>(
+        test::AsTensor<float>({-(17.0f + i), -(39.0f + 3 * i)}, {2, 1}),
+        outputs[0]);
+    test::ExpectTensorEqual<float>(test::AsTensor<float>({0, 0}, {2, 1}),
+                                   outputs[1]);
+  }
+
+  // A feed of the wrong type is reported as a kernel error.
+  std::vector<Tensor> outputs;
+  Status s = session->RunCallable(handle, {Tensor(DT_INT32, TensorShape({}))},
+                                  &outputs, nullptr);
+  EXPECT_FALSE(s.ok());
+  TF_ASSERT_OK(session->ReleaseCallable(handle));
+}
+
 TEST(DirectSessionTest, FetchMultipleTimes) {
   Graph g(OpRegistry::Global());
   Tensor seven_tensor(DT_INT32, TensorShape());
@@ -1116,6 +1294,134 @@ TEST(DirectSessionTest, PlacePrunedGraph) {
   }
 }
 
+// Returns the device that `node_name` runs on in the partition graphs of
+// `run_metadata`, or an empty string if it does not run.
+string PlacedDevice(const RunMetadata& run_metadata, const string& node_name) {
+  for (const GraphDef& partition : run_metadata.partition_graphs()) {
+    for (const NodeDef& node : partition.node()) {
+      if (node.name() == node_name) return node.device();
+    }
+  }
+  return "";
+}
+
+// Extends a graph with a node that is colocated with an existing node but
+// requests another device, and returns the devices that both nodes run on.
+void ExtendWithColocatedNode(bool incremental_placement, string* a_device,
+                             string* b_device) {
+  Graph g(OpRegistry::Global());
+  Tensor vx(DT_FLOAT, TensorShape({}));
+  vx.scalar<float>()() = 1.0;
+  Node* a = test::graph::Constant(&g, vx, "a");
+  GraphDef def;
+  test::graph::ToGraphDef(&g, &def);
+
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.set_allow_soft_placement(true);
+  options.config.mutable_experimental()->set_incremental_placement(
+      incremental_placement);
+  // Keep the nodes from being folded away.
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  std::unique_ptr<Session> sess(NewSession(options));
+  TF_ASSERT_OK(sess->Create(def));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(sess->Run({}, {"a:0"}, {}, &outputs));
+
+  GraphDef extension;
+  NodeDef* b = extension.add_node();
+  b->set_name("b");
+  b->set_op("Identity");
+  b->add_input(a->name());
+  b->set_device("/device:CPU:1");
+  AddNodeAttr("T", DT_FLOAT, b);
+  AddNodeAttr(kColocationAttrName,
+              std::vector<string>({strings::StrCat(kColocationGroupPrefix,
+                                                   a->name())}),
+              b);
+  TF_ASSERT_OK(sess->Extend(extension));
+
+  RunOptions run_options;
+  run_options.set_output_partition_graphs(true);
+  RunMetadata run_metadata;
+  TF_ASSERT_OK(sess->Run(run_options, {}, {"b:0"}, {}, &outputs,
+                         &run_metadata));
+  test::ExpectTensorEqual<float>(vx, outputs[0]);
+  *a_device = PlacedDevice(run_metadata, "a");
+  *b_device = PlacedDevice(run_metadata, "b");
+}
+
+TEST(DirectSessionTest, ExtendReplacesGraph) {
+  string a_device, b_device;
+  ExtendWithColocatedNode(false, &a_device, &b_device);
+  // The colocation group of "a" and "b" moves to the device that "b" requests.
+  EXPECT_EQ("/job:localhost/replica:0/task:0/device:CPU:1", a_device);
+  EXPECT_EQ("/job:localhost/replica:0/task:0/device:CPU:1", b_device);
+}
+
+TEST(DirectSessionTest, ExtendWithIncrementalPlacement) {
+  string a_device, b_device;
+  ExtendWithColocatedNode(true, &a_device, &b_device);
+  // "a" keeps its device, and "b" is placed with it.
+  EXPECT_EQ("/job:localhost/replica:0/task:0/device:CPU:0", a_device);
+  EXPECT_EQ("/job:localhost/replica:0/task:0/device:CPU:0", b_device);
+}
+
+TEST(DirectSessionTest, ExtendKeepsDevicesOfExistingNodes) {
+  Graph g(OpRegistry::Global());
+  Tensor vx(DT_FLOAT, TensorShape({}));
+  vx.scalar<float>()() = 1.0;
+  Node* a = test::graph::Constant(&g, vx, "a");
+  a->set_requested_device("/device:CPU:1");
+  Node* c = test::graph::Constant(&g, vx, "c");
+  GraphDef def;
+  test::graph::ToGraphDef(&g, &def);
+
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.set_allow_soft_placement(true);
+  options.config.mutable_experimental()->set_incremental_placement(true);
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  std::unique_ptr<Session> sess(NewSession(options));
+  TF_ASSERT_OK(sess->Create(def));
+  RunOptions run_options;
+  run_options.set_output_partition_graphs(true);
+  RunMetadata run_metadata;
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(sess->Run(run_options, {}, {"a:0", "c:0"}, {}, &outputs,
+                         &run_metadata));
+  const string a_device = PlacedDevice(run_metadata, "a");
+  const string c_device = PlacedDevice(run_metadata, "c");
+  EXPECT_EQ("/job:localhost/replica:0/task:0/device:CPU:1", a_device);
+
+  // Extend the graph twice, and check that the devices don't change.
+  for (const string& name : {"b", "d"}) {
+    GraphDef extension;
+    NodeDef* n = extension.add_node();
+    n->set_name(name);
+    n->set_op("Identity");
+    n->add_input(a->name());
+    AddNodeAttr("T", DT_FLOAT, n);
+    TF_ASSERT_OK(sess->Extend(extension));
+
+    RunMetadata extended_run_metadata;
+    TF_ASSERT_OK(sess->Run(run_options, {}, {"a:0", "c:0", name + ":0"}, {},
+                           &outputs, &extended_run_metadata));
+    EXPECT_EQ(a_device, PlacedDevice(extended_run_metadata, "a"));
+    EXPECT_EQ(c_device, PlacedDevice(extended_run_metadata, "c"));
+  }
+}
+
 TEST(DirectSessionTest, PartialRunTest) {
   GraphDef def;
   Graph g(OpRegistry::Global());
@@ -1727,6 +2033,67 @@ TEST(DirectSessionTest, TestSessionInterOpThreadsInvalidOptions) {
   }
 }
 
+TEST(DirectSessionTest, TestSessionThreadPoolPartitions) {
+  Graph g(OpRegistry::Global());
+  Tensor t(DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&t, {1, 2, 3, 4});
+  Node* a = test::graph::Constant(&g, t);
+  Node* y = test::graph::Matmul(&g, a, a, false, false);
+  GraphDef def;
+  test::graph::ToGraphDef(&g, &def);
+
+  // Two partitions, each pinning its inter-op and intra-op threads to the
+  // same CPU.
+  auto make_options = [](const string& name, int cpu) {
+    SessionOptions options;
+    options.config.mutable_graph_options()
+        ->mutable_optimizer_options()
+        ->set_opt_level(OptimizerOptions_Level_L0);
+    auto* inter = options.config.add_session_inter_op_thread_pool();
+    inter->set_global_name(strings::StrCat(name, "_inter"));
+    inter->add_cpu_affinity(cpu);
+    auto* intra = options.config.mutable_experimental()
+                      ->mutable_intra_op_thread_pool();
+    intra->set_global_name(strings::StrCat(name, "_intra"));
+    intra->add_cpu_affinity(cpu);
+    return options;
+  };
+
+  std::vector<std::unique_ptr<Session>> sessions;
+  for (const auto& partition : {std::make_pair("partition_a", 0),
+                                std::make_pair("partition_b", 1)}) {
+    sessions.emplace_back(
+        NewSession(make_options(partition.first, partition.second)));
+    TF_ASSERT_OK(sessions.back()->Create(def));
+  }
+  for (auto& session : sessions) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {y->name() + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(
+        test::AsTensor<float>({7, 10, 15, 22}, {2, 2}), outputs[0]);
+  }
+
+  // Re-using a named intra-op pool with a different affinity is an error.
+  Session* bad_session = nullptr;
+  Status s = NewSession(make_options("partition_a", 1), &bad_session);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(str_util::StrContains(s.error_message(), "Intra-op")) << s;
+  EXPECT_TRUE(str_util::StrContains(s.error_message(), "cpu_affinity")) << s;
+  EXPECT_EQ(nullptr, bad_session);
+
+  // So is re-using a named inter-op pool with a different affinity.
+  SessionOptions options = make_options("partition_a", 1);
+  options.config.mutable_experimental()
+      ->mutable_intra_op_thread_pool()
+      ->set_global_name("partition_c_intra");
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_NE(nullptr, session);
+  s = session->Create(def);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(str_util::StrContains(s.error_message(), "cpu_affinity")) << s;
+}
+
 TEST(DirectSessionTest, TestDirectSessionRunClose) {
   // Construct a graph with a variable and a single assign.
   Graph g(OpRegistry::Global());
@@ -146,6 +146,7 @@ Status EagerContext::ClearCaches() {
   // well.
   mutex_lock ml(cache_mu_);
   TF_RETURN_IF_ERROR(executor_.WaitForAllPendingNodes());
+  kernel_cache_generation_.fetch_add(1, std::memory_order_release);
   gtl::STLDeleteValues(&kernel_cache_);
 
   return Status::OK();
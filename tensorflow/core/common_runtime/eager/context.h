@@ -155,6 +155,12 @@ class EagerContext {
 
   void AddKernelToCache(Fprint128 cache_key, KernelAndDevice* kernel);
 
+  // Returns a counter that is incremented every time ClearCaches() deletes
+  // the cached kernels.
+  uint64 KernelCacheGeneration() const {
+    return kernel_cache_generation_.load(std::memory_order_acquire);
+  }
+
   bool LogDevicePlacement() const { return log_device_placement_; }
   bool LogMemory() const { return log_memory_; }
 
@@ -284,6 +290,7 @@ class EagerContext {
   mutex cache_mu_;
   std::unordered_map<Fprint128, KernelAndDevice*, Fprint128Hasher> kernel_cache_
       GUARDED_BY(cache_mu_);
+  std::atomic<uint64> kernel_cache_generation_{0};
 
   // Whether we should compute RunMetadata.
   std::atomic<bool> should_store_step_stats_{false};
@@ -15,10 +15,34 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/eager/eager_executor.h"
 
+#include <algorithm>
+
+#include "tensorflow/core/util/env_var.h"
+
 namespace tensorflow {
 
 EagerNode::EagerNode(tensorflow::uint64 id) : id(id) {}
 
+namespace {
+
+int MaxConcurrencyFromEnv() {
+  int64 max_concurrency;
+  Status s = ReadInt64FromEnvVar("TF_EAGER_ASYNC_MAX_CONCURRENCY", 1,
+                                 &max_concurrency);
+  if (!s.ok()) {
+    LOG(ERROR) << s;
+    return 1;
+  }
+  return std::max<int64>(max_concurrency, 1);
+}
+
+}  // namespace
+
+EagerExecutor::EagerExecutor() : EagerExecutor(MaxConcurrencyFromEnv()) {}
+
+EagerExecutor::EagerExecutor(int max_concurrency)
+    : max_concurrency_(std::max(max_concurrency, 1)) {}
+
 EagerExecutor::~EagerExecutor() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   thread_done_ = true;
@@ -33,6 +57,11 @@ tensorflow::uint64 EagerExecutor::NextId() {
 void EagerExecutor::EnableAsync() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   if (thread_ == nullptr) {
+    if (max_concurrency_ > 1) {
+      thread_pool_.reset(new thread::ThreadPool(
+          tensorflow::Env::Default(), "eager_async_executor_pool",
+          max_concurrency_));
+    }
     thread_.reset(tensorflow::Env::Default()->StartThread(
         tensorflow::ThreadOptions(), "eager_async_executor",
         std::bind(&EagerExecutor::Run, this)));
@@ -40,26 +69,28 @@ void EagerExecutor::EnableAsync() {
 }
 
 void EagerExecutor::Add(EagerNode* node) {
+  NodeItem item;
+  item.node = node;
+  item.can_run_concurrently =
+      max_concurrency_ > 1 && node->CanRunConcurrently(&item.input_node_ids);
   tensorflow::mutex_lock l(node_queue_mutex_);
   DCHECK(thread_) << "EnableAsync should have been called before Add";
   if (!status_.ok()) {
     delete node;
     return;
   }
-  int64 qlen = node_queue_.size();
-  if (qlen > 0) {
-    if (node_queue_.back()->id >= node->id) {
+  if (!node_queue_.empty()) {
+    const uint64 last_id = node_queue_.rbegin()->first;
+    if (last_id >= node->id) {
       status_ = tensorflow::errors::InvalidArgument(
-          "Inserting EagerNode with non-increasing ids:",
-          node_queue_.back()->id, " vs ", node->id);
+          "Inserting EagerNode with non-increasing ids:", last_id, " vs ",
+          node->id);
       delete node;
       return;
     }
-    node_queue_.push(node);
-  } else {
-    node_queue_.push(node);
-    nodes_pending_.notify_all();
   }
+  node_queue_.emplace(node->id, std::move(item));
+  nodes_pending_.notify_all();
 }
 
 tensorflow::Status EagerExecutor::WaitFor(tensorflow::uint64 node_id) {
@@ -78,10 +109,9 @@ tensorflow::Status EagerExecutor::WaitImpl(bool wait_all,
   if (!status_.ok()) return status_;
   if (node_queue_.empty()) return tensorflow::Status::OK();
   if (wait_all) {
-    node_id = node_queue_.back()->id;
-  } else if (node_id < node_queue_.front()->id) {
-    // Note that we are relying on the ops being dispatched sequentially from
-    // the queue.
+    node_id = 0;
+  } else if (node_queue_.find(node_id) == node_queue_.end()) {
+    // Nodes are only removed from the queue once they are done.
     return tensorflow::Status::OK();
   }
   node_done_notifications_.insert(std::make_pair(node_id, &cond));
@@ -94,10 +124,11 @@ tensorflow::Status EagerExecutor::WaitImpl(bool wait_all,
 void EagerExecutor::ClearError() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   if (status_.ok()) return;
-  // If an error was set, node_done_notifications_ and node_queue_ should have
-  // been cleared, and no new entries should have been added since.
+  // If an error was set, node_done_notifications_ and the pending nodes in
+  // node_queue_ should have been cleared, and no new entries should have been
+  // added since. Nodes that were already running may still be in node_queue_.
   DCHECK(node_done_notifications_.empty());
-  DCHECK(node_queue_.empty());
+  DCHECK_EQ(node_queue_.size(), num_running_);
   status_ = tensorflow::Status::OK();
   nodes_pending_.notify_all();
 }
@@ -107,46 +138,107 @@ tensorflow::Status EagerExecutor::status() {
   return status_;
 }
 
+EagerNode* EagerExecutor::NextRunnableNode() {
+  for (auto& it : node_queue_) {
+    NodeItem& item = it.second;
+    if (!item.can_run_concurrently) {
+      // Only the oldest node may run alone, and nothing after it may start
+      // before it is done.
+      if (item.running || it.first != node_queue_.begin()->first) {
+        return nullptr;
+      }
+      item.running = true;
+      return item.node;
+    }
+    if (item.running) continue;
+    bool inputs_done = true;
+    for (uint64 input_node_id : item.input_node_ids) {
+      if (node_queue_.find(input_node_id) != node_queue_.end()) {
+        inputs_done = false;
+        break;
+      }
+    }
+    if (inputs_done) {
+      item.running = true;
+      return item.node;
+    }
+  }
+  return nullptr;
+}
+
 void EagerExecutor::Run() {
   while (true) {
-    std::unique_ptr<EagerNode> curr_node;
+    EagerNode* curr_node = nullptr;
     {
       tensorflow::mutex_lock l(node_queue_mutex_);
-      while (node_queue_.empty() || !status_.ok()) {
-        if (thread_done_) return;
+      while (true) {
+        if (status_.ok() && num_running_ < max_concurrency_) {
+          curr_node = NextRunnableNode();
+          if (curr_node != nullptr) break;
+        }
+        if (thread_done_ && num_running_ == 0 &&
+            (node_queue_.empty() || !status_.ok())) {
+          return;
+        }
         nodes_pending_.wait(l);
       }
-      curr_node.reset(node_queue_.front());
+      ++num_running_;
     }
-    tensorflow::Status status = curr_node->Run();
-    const bool ok = status.ok();
-    tensorflow::mutex_lock l(node_queue_mutex_);
-    node_queue_.pop();
-    if (!ok) {
-      status_ = status;
-      // TODO(agarwal): mark all affected handles as corrupted before clearing
-      // this queue.
-      // We remove any pending ops so that we don't try to execute them if
-      // ClearError is called.
-      for (int i = 0; i < node_queue_.size(); ++i) {
-        delete node_queue_.front();
-        node_queue_.pop();
+    if (thread_pool_ == nullptr) {
+      NodeDone(curr_node, curr_node->Run());
+    } else {
+      thread_pool_->Schedule(
+          [this, curr_node]() { NodeDone(curr_node, curr_node->Run()); });
+    }
+  }
+}
+
+void EagerExecutor::NodeDone(EagerNode* node, const Status& status) {
+  std::unique_ptr<EagerNode> done_node(node);
+  const bool ok = status.ok();
+  tensorflow::mutex_lock l(node_queue_mutex_);
+  node_queue_.erase(node->id);
+  --num_running_;
+  if (!ok) {
+    // Keep the first error if several concurrently running nodes fail.
+    if (status_.ok()) status_ = status;
+    // TODO(agarwal): mark all affected handles as corrupted before clearing
+    // this queue.
+    // We remove any pending ops so that we don't try to execute them if
+    // ClearError is called. Nodes that are still running remove themselves
+    // when they are done.
+    for (auto it = node_queue_.begin(); it != node_queue_.end();) {
+      if (it->second.running) {
+        ++it;
+      } else {
+        delete it->second.node;
+        it = node_queue_.erase(it);
       }
     }
-    if (!node_done_notifications_.empty()) {
-      tensorflow::uint64 node_id = curr_node->id;
+  }
+  if (!node_done_notifications_.empty()) {
+    if (!ok) {
       // Note that we notify all waiting threads in case an error has occurred.
       // These calling threads are responsible for checking status_ before
       // proceeding.
-      const auto range = ok ? node_done_notifications_.equal_range(node_id)
-                            : make_pair(node_done_notifications_.begin(),
-                                        node_done_notifications_.end());
-      for (auto it = range.first; it != range.second; ++it) {
-        it->second->notify_all();
+      for (const auto& it : node_done_notifications_) {
+        it.second->notify_all();
       }
-      node_done_notifications_.erase(range.first, range.second);
+      node_done_notifications_.clear();
+    } else {
+      NotifyWaiters(node->id);
+      if (node_queue_.empty()) NotifyWaiters(0);
     }
   }
+  nodes_pending_.notify_all();
+}
+
+void EagerExecutor::NotifyWaiters(uint64 node_id) {
+  const auto range = node_done_notifications_.equal_range(node_id);
+  for (auto it = range.first; it != range.second; ++it) {
+    it->second->notify_all();
+  }
+  node_done_notifications_.erase(range.first, range.second);
 }
 
 }  // namespace tensorflow
@@ -19,7 +19,6 @@ limitations under the License.
 #include <cstddef>
 #include <map>
 #include <memory>
-#include <queue>
 #include <string>
 #include <thread>
 #include <vector>
@@ -28,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
@@ -50,6 +50,15 @@ class EagerNode {
   // execution is done.
   virtual Status Run() = 0;
 
+  // Returns true if this node may run concurrently with other nodes, and
+  // appends to `input_node_ids` the ids of the nodes whose outputs it reads.
+  // Such a node starts once those nodes are done. Nodes that return false
+  // run alone: after all nodes added before them are done, and before any
+  // node added after them starts.
+  virtual bool CanRunConcurrently(std::vector<uint64>* input_node_ids) const {
+    return false;
+  }
+
   // An id unique to the TFE_Context under which this node is created. Allocated
   // monotonically.
   const uint64 id;
@@ -61,11 +70,18 @@ class EagerNode {
 // device of the input handle. Fix that.
 // TODO(agarwal): On error, mark all affected handles as corrupted.
 // TODO(agarwal): Implement support for control dependencies.
-// TODO(agarwal): Support out-of-order execution and dispatching multiple
-// EagerNode in parallel.
 // TODO(agarwal): Implement optimizations over EagerNode traces.
+//
+// By default nodes run one-by-one in the order they were added. If
+// `max_concurrency` is larger than 1, nodes that can run concurrently (see
+// EagerNode::CanRunConcurrently) are dispatched to a thread pool as soon as
+// the nodes producing their inputs are done, so independent nodes overlap.
 class EagerExecutor {
  public:
+  // Reads the maximum number of concurrently running nodes from the
+  // TF_EAGER_ASYNC_MAX_CONCURRENCY environment variable (default 1).
+  EagerExecutor();
+  explicit EagerExecutor(int max_concurrency);
   ~EagerExecutor();
 
   // This is called whenever async mode is enabled. Note that it may be called
@@ -95,21 +111,45 @@ class EagerExecutor {
   Status status();
 
  private:
+  struct NodeItem {
+    EagerNode* node;
+    bool can_run_concurrently;
+    std::vector<uint64> input_node_ids;
+    bool running = false;
+  };
+
   // Starts execution of pending EagerNodes. This function loops till
   // thread_done_ is set to true. If any errors are encontered, these are set
-  // inside `status_`. The loop blocks anytime there are no pending nodes, or if
-  // `status_` is not ok.
+  // inside `status_`. The loop blocks anytime there are no runnable nodes, or
+  // if `status_` is not ok.
   void Run();
 
+  // Returns the first pending node that may start now and marks it running,
+  // or nullptr if there is none.
+  EagerNode* NextRunnableNode() EXCLUSIVE_LOCKS_REQUIRED(node_queue_mutex_);
+
+  // Removes `node` from `node_queue_`, records `status` and notifies waiters.
+  // Deletes `node`.
+  void NodeDone(EagerNode* node, const Status& status);
+
+  // Notifies and removes the waiters for the node with id `node_id`.
+  void NotifyWaiters(uint64 node_id)
+      EXCLUSIVE_LOCKS_REQUIRED(node_queue_mutex_);
+
   Status WaitImpl(bool wait_all, uint64 node_id);
 
+  const int max_concurrency_;
+
   mutex node_queue_mutex_;
 
-  // Used to signal that some EagerNodes are pending execution.
+  // Used to signal that some EagerNodes may be ready for execution.
   condition_variable nodes_pending_ GUARDED_BY(node_queue_mutex_);
 
-  // Queue of pending EagerNodes.
-  std::queue<EagerNode*> node_queue_ GUARDED_BY(node_queue_mutex_);
+  // EagerNodes that are pending or running, by id.
+  std::map<uint64, NodeItem> node_queue_ GUARDED_BY(node_queue_mutex_);
+
+  // Number of nodes in `node_queue_` that are running.
+  int num_running_ GUARDED_BY(node_queue_mutex_) = 0;
 
   // `status_` is set based on any errors raised during execution of a
   // EagerNode.  It remains set until ClearError is called.
@@ -118,11 +158,17 @@ class EagerExecutor {
   // Map from id of a EagerNode to condition_variables (not owned by the map).
   // These condition_variables are notified and removed when that EagerNode is
   // done executing, or if an error is found in execution of any EagerNode.
+  // Entries with id 0 are notified once all EagerNodes are done.
   std::multimap<uint64, condition_variable*> node_done_notifications_
       GUARDED_BY(node_queue_mutex_);
 
-  // Thread object that calls the `Run` method. Currently we use only one thread
-  // for executing the EagerNodes one-by-one.
+  // Runs the nodes that can run concurrently if max_concurrency_ > 1. It is
+  // destroyed after `thread_`, which waits for the nodes it runs.
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
+
+  // Thread object that calls the `Run` method. It runs the EagerNodes itself
+  // one-by-one if max_concurrency_ is 1, and dispatches them to
+  // `thread_pool_` otherwise.
   std::unique_ptr<Thread> thread_ GUARDED_BY(node_queue_mutex_);
 
   // Indicates that `thread_` should stop as soon as it is done executing the
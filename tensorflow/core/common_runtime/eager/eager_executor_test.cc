@@ -0,0 +1,151 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/eager/eager_executor.h"
+
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// An EagerNode that runs `fn`, optionally concurrently after the nodes with
+// ids `input_node_ids`.
+class TestNode : public EagerNode {
+ public:
+  TestNode(uint64 id, bool can_run_concurrently,
+           std::vector<uint64> input_node_ids, std::function<Status()> fn)
+      : EagerNode(id),
+        can_run_concurrently_(can_run_concurrently),
+        input_node_ids_(std::move(input_node_ids)),
+        fn_(std::move(fn)) {}
+
+  bool CanRunConcurrently(std::vector<uint64>* input_node_ids) const override {
+    *input_node_ids = input_node_ids_;
+    return can_run_concurrently_;
+  }
+
+  Status Run() override { return fn_(); }
+
+ private:
+  const bool can_run_concurrently_;
+  const std::vector<uint64> input_node_ids_;
+  const std::function<Status()> fn_;
+};
+
+// Records the order in which nodes run.
+class RunLog {
+ public:
+  std::function<Status()> Record(int value) {
+    return [this, value]() {
+      mutex_lock l(mu_);
+      log_.push_back(value);
+      return Status::OK();
+    };
+  }
+
+  std::vector<int> log() {
+    mutex_lock l(mu_);
+    return log_;
+  }
+
+ private:
+  mutex mu_;
+  std::vector<int> log_ GUARDED_BY(mu_);
+};
+
+TEST(EagerExecutorTest, RunsNodesInOrderByDefault) {
+  EagerExecutor executor(1);
+  executor.EnableAsync();
+  RunLog log;
+  for (int i = 0; i < 10; ++i) {
+    executor.Add(new TestNode(executor.NextId(), true, {}, log.Record(i)));
+  }
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), log.log());
+}
+
+TEST(EagerExecutorTest, RunsIndependentNodesConcurrently) {
+  EagerExecutor executor(2);
+  executor.EnableAsync();
+  // The first node only finishes once the second one has started, so this
+  // deadlocks unless they run concurrently.
+  Notification second_started;
+  executor.Add(new TestNode(executor.NextId(), true, {}, [&second_started]() {
+    second_started.WaitForNotification();
+    return Status::OK();
+  }));
+  executor.Add(new TestNode(executor.NextId(), true, {}, [&second_started]() {
+    second_started.Notify();
+    return Status::OK();
+  }));
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+}
+
+TEST(EagerExecutorTest, RunsDependentNodesAfterTheirInputs) {
+  EagerExecutor executor(4);
+  executor.EnableAsync();
+  RunLog log;
+  Notification release_first;
+  const uint64 first = executor.NextId();
+  executor.Add(new TestNode(first, true, {}, [&]() {
+    release_first.WaitForNotification();
+    return log.Record(1)();
+  }));
+  const uint64 second = executor.NextId();
+  executor.Add(new TestNode(second, true, {first}, log.Record(2)));
+  // Independent of the nodes above, so it runs while the first one blocks.
+  const uint64 third = executor.NextId();
+  executor.Add(new TestNode(third, true, {}, log.Record(3)));
+  TF_EXPECT_OK(executor.WaitFor(third));
+  EXPECT_EQ(std::vector<int>({3}), log.log());
+
+  // Waits for everything added before it, and blocks everything after it.
+  executor.Add(new TestNode(executor.NextId(), false, {}, log.Record(4)));
+  executor.Add(new TestNode(executor.NextId(), true, {}, log.Record(5)));
+  release_first.Notify();
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  EXPECT_EQ(std::vector<int>({3, 1, 2, 4, 5}), log.log());
+}
+
+TEST(EagerExecutorTest, ErrorDropsPendingNodes) {
+  EagerExecutor executor(2);
+  executor.EnableAsync();
+  RunLog log;
+  const uint64 failing = executor.NextId();
+  executor.Add(new TestNode(failing, true, {},
+                            []() { return errors::Internal("failed"); }));
+  executor.Add(
+      new TestNode(executor.NextId(), true, {failing}, log.Record(1)));
+  Status s = executor.WaitForAllPendingNodes();
+  EXPECT_TRUE(errors::IsInternal(s)) << s;
+  EXPECT_TRUE(errors::IsInternal(executor.status()));
+  EXPECT_TRUE(log.log().empty());
+
+  executor.ClearError();
+  TF_EXPECT_OK(executor.status());
+  executor.Add(new TestNode(executor.NextId(), true, {}, log.Record(2)));
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  EXPECT_EQ(std::vector<int>({2}), log.log());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -36,6 +36,20 @@ void EagerOperation::ConsumeInput(tensorflow::TensorHandle* h) {
   attrs_.NumInputs(static_cast<int>(inputs_.size()));
 }
 
+tensorflow::KernelAndDevice* EagerOperation::CachedKernel() const {
+  if (cached_kernel_ == nullptr || cached_kernel_device_ != device_ ||
+      cached_kernel_generation_ != ctx_->KernelCacheGeneration()) {
+    return nullptr;
+  }
+  return cached_kernel_;
+}
+
+void EagerOperation::SetCachedKernel(tensorflow::KernelAndDevice* kernel) {
+  cached_kernel_ = kernel;
+  cached_kernel_device_ = device_;
+  cached_kernel_generation_ = ctx_->KernelCacheGeneration();
+}
+
 string EagerOperation::DebugString() const {
   string out;
   VLOG(1) << "EagerOperation::DebugString() over " << this;
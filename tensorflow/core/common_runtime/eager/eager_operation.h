@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/eager/attr_builder.h"
 #include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
 #include "tensorflow/core/common_runtime/eager/tensor_handle.h"
 
 namespace tensorflow {
@@ -41,7 +42,11 @@ class EagerOperation {
 
   tensorflow::EagerContext* EagerContext() { return ctx_; }
 
-  tensorflow::AttrBuilder* MutableAttrs() { return &attrs_; }
+  // Any change to the attributes invalidates the cached kernel.
+  tensorflow::AttrBuilder* MutableAttrs() {
+    cached_kernel_ = nullptr;
+    return &attrs_;
+  }
   const tensorflow::AttrBuilder& Attrs() const { return attrs_; }
 
   const tensorflow::gtl::InlinedVector<tensorflow::TensorHandle*, 4>& Inputs()
@@ -64,6 +69,14 @@ class EagerOperation {
 
   void SetUseXla(bool use_xla) { use_xla_ = use_xla; }
 
+  // Returns the kernel this operation last ran with, as recorded by
+  // SetCachedKernel(), or nullptr if the attributes or the device have
+  // changed since then or the context's kernel cache was cleared. This lets
+  // an operation that is executed repeatedly skip recomputing its kernel
+  // cache key.
+  tensorflow::KernelAndDevice* CachedKernel() const;
+  void SetCachedKernel(tensorflow::KernelAndDevice* kernel);
+
   string DebugString() const;
 
  private:
@@ -75,6 +88,11 @@ class EagerOperation {
   tensorflow::Device* device_;
   bool use_xla_ = false;
   const bool is_function_;
+
+  // Not owned; see CachedKernel().
+  tensorflow::KernelAndDevice* cached_kernel_ = nullptr;
+  tensorflow::Device* cached_kernel_device_ = nullptr;
+  uint64 cached_kernel_generation_ = 0;
 };
 }  // namespace tensorflow
 
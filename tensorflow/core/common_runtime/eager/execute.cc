@@ -502,13 +502,11 @@ Status ShouldCompileWithXLA(const EagerOperation* op, const Device* device,
 //    runtime. In this case, we don't select a device because running
 //    a function with explicitly requested device has different behavior than
 //    running without an explicitly requested device.
-Status EagerLocalExecute(EagerOperation* op,
-                         gtl::InlinedVector<TensorHandle*, 2>* retvals,
-                         int* num_retvals) {
+Status GetOrCreateKernelAndDevice(EagerOperation* op,
+                                  KernelAndDevice** out_kernel) {
   const string unspecified_device_name("<unspecified>");
   EagerContext* ctx = op->EagerContext();
-  auto status = ctx->GetStatus();
-  if (!status.ok()) return status;
+  Status status;
   Device* device = op->Device();
 
   const string& maybe_unspecified_device_name =
@@ -613,6 +611,29 @@ Status EagerLocalExecute(EagerOperation* op,
 
     ctx->AddKernelToCache(cache_key, kernel);
   }
+  // The kernel of a multi-device function also depends on the devices and
+  // shapes of the inputs, which can change between executions of `op`.
+  if (!is_multi_device_function) {
+    op->SetCachedKernel(kernel);
+  }
+  *out_kernel = kernel;
+  return Status::OK();
+}
+
+Status EagerLocalExecute(EagerOperation* op,
+                         gtl::InlinedVector<TensorHandle*, 2>* retvals,
+                         int* num_retvals) {
+  const string unspecified_device_name("<unspecified>");
+  EagerContext* ctx = op->EagerContext();
+  auto status = ctx->GetStatus();
+  if (!status.ok()) return status;
+
+  // Operations that are executed repeatedly reuse the kernel they last ran
+  // with, skipping the cache key computation and the kernel cache lookup.
+  KernelAndDevice* kernel = op->CachedKernel();
+  if (kernel == nullptr) {
+    TF_RETURN_IF_ERROR(GetOrCreateKernelAndDevice(op, &kernel));
+  }
   const DataTypeVector& output_dtypes = kernel->output_dtypes();
   const int output_dtypes_size = static_cast<int>(output_dtypes.size());
   if (output_dtypes_size > *num_retvals) {
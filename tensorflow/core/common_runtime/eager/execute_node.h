@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/eager/execute.h"
 #include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
 #include "tensorflow/core/common_runtime/eager/tensor_handle.h"
+#include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/step_stats.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
@@ -62,6 +63,33 @@ class ExecuteNode : public EagerNode {
     }
   }
 
+  // Stateless kernels without resource inputs only interact with other nodes
+  // through their input and output handles, so they can run as soon as the
+  // nodes producing their inputs are done. Everything else, including function
+  // calls and nodes that collect stats, runs alone.
+  bool CanRunConcurrently(std::vector<uint64>* input_node_ids) const override {
+    const OpKernel* kernel = kernel_->kernel();
+    if (kernel == nullptr || maybe_stats_ != nullptr) return false;
+    const OpDef* op_def = nullptr;
+    if (!OpRegistry::Global()
+             ->LookUpOpDef(kernel->type_string(), &op_def)
+             .ok() ||
+        op_def->is_stateful()) {
+      return false;
+    }
+    for (int i = 0; i < kernel->num_inputs(); ++i) {
+      if (kernel->input_type(i) == DT_RESOURCE) return false;
+    }
+    for (TensorHandle* handle : inputs_) {
+      // Handles produced by another context's nodes are waited for when this
+      // node runs.
+      if (handle->node_id() != 0 && handle->Context() == ctx_) {
+        input_node_ids->push_back(handle->node_id());
+      }
+    }
+    return true;
+  }
+
   tensorflow::Status Run() override {
     const Status status = EagerKernelExecute(
         ctx_, inputs_, kernel_, maybe_stats_.get(), maybe_step_stats_,
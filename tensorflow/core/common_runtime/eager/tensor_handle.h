@@ -127,6 +127,10 @@ class TensorHandle : public core::RefCounted {
 
   bool IsRemote();
 
+  // Id of the EagerNode that computes the value of this handle, or 0 if the
+  // handle was created ready.
+  uint64 node_id() const { return node_id_; }
+
   OutputGraphNode* getSymbolicTensor() const { return symbolic_tensor.get(); }
 
   string DebugString() const;
@@ -42,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_reference.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
@@ -352,10 +353,32 @@ class ExecutorImpl : public Executor {
     }
   };
 
+  // A precomputed linear schedule for graphs that need none of the dynamic
+  // machinery in ExecutorState (frames, deadness, asynchronous kernels).
+  //
+  // Output `j` of `nodes[i]` is copied to the input slots
+  // `dst_slots[dst_start[output_base[i] + j] .. dst_start[output_base[i] + j
+  // + 1])`, which are indices into a flat array of `total_inputs` tensors
+  // laid out in the same way as IterationState::input_tensors.
+  struct CompiledPlan {
+    std::vector<const NodeItem*> nodes;
+    std::vector<int32> output_base;  // Length = nodes.size().
+    std::vector<int32> dst_start;    // Length = total outputs + 1.
+    std::vector<int32> dst_slots;
+    int total_inputs = 0;
+  };
+
   static Status BuildControlFlowInfo(const Graph* graph,
                                      ControlFlowInfo* cf_info);
   void InitializePending(const Graph* graph, const ControlFlowInfo& cf_info);
 
+  // Sets compiled_plan_ if every node in graph_ can be executed by
+  // RunCompiledPlan(). Leaves it null otherwise.
+  void MaybeBuildCompiledPlan();
+
+  // Runs one step of compiled_plan_ in the calling thread.
+  void RunCompiledPlan(const Args& args, DoneCallback done);
+
   FrameInfo* EnsureFrameInfo(const string& fname) {
     auto slot = &frame_info_[fname];
     if (*slot == nullptr) {
@@ -372,6 +395,11 @@ class ExecutorImpl : public Executor {
   // A cached value of params_
   bool device_record_tensor_accesses_ = false;
 
+  // True iff the graph contains Switch, Merge, Enter, Exit or NextIteration
+  // nodes. Graphs without them only ever have the root frame and iteration,
+  // so ExecutorState can activate successors without the frame lock.
+  bool requires_control_flow_ = false;
+
   // Root nodes (with no in edges) that should form the initial ready queue
   std::vector<const Node*> root_nodes_;
 
@@ -380,6 +408,9 @@ class ExecutorImpl : public Executor {
   // the overhead of constructing it for each executor instance.
   gtl::FlatMap<string, FrameInfo*> frame_info_;
 
+  // Non-null iff params_.use_compiled_plan is set and the graph qualifies.
+  std::unique_ptr<const CompiledPlan> compiled_plan_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
 
@@ -637,6 +668,9 @@ Status ExecutorImpl::Initialize() {
       return s;
     }
     CHECK(item->kernel);
+    if (n->IsControlFlow()) {
+      requires_control_flow_ = true;
+    }
     item->kernel_is_async = (item->kernel->AsAsync() != nullptr);
     item->is_merge = IsMerge(n);
     item->is_enter = IsEnter(n);
@@ -676,7 +710,75 @@ Status ExecutorImpl::Initialize() {
   // all nodes.
   InitializePending(graph_.get(), cf_info);
 
-  return gview_.SetAllocAttrs(graph_.get(), params_.device);
+  TF_RETURN_IF_ERROR(gview_.SetAllocAttrs(graph_.get(), params_.device));
+
+  if (params_.use_compiled_plan) {
+    MaybeBuildCompiledPlan();
+  }
+  return Status::OK();
+}
+
+void ExecutorImpl::MaybeBuildCompiledPlan() {
+  if (params_.device->device_type() != DEVICE_CPU ||
+      device_record_tensor_accesses_) {
+    VLOG(1) << "Not compiling an execution plan for device "
+            << params_.device->name();
+    return;
+  }
+
+  std::vector<Node*> order;
+  GetReversePostOrder(*graph_, &order);
+  if (order.size() != graph_->num_nodes()) {
+    VLOG(1) << "Not compiling an execution plan for a cyclic graph";
+    return;
+  }
+
+  std::unique_ptr<CompiledPlan> plan(new CompiledPlan);
+  plan->nodes.reserve(order.size());
+  plan->output_base.reserve(order.size());
+  int32 num_outputs = 0;
+  for (const Node* n : order) {
+    const NodeItem* item = gview_.node(n->id());
+    if (n->IsControlFlow() || IsTransferNode(n) || n->IsCollective() ||
+        item->kernel_is_async) {
+      VLOG(1) << "Not compiling an execution plan because of node "
+              << n->name() << " (" << n->type_string() << ")";
+      return;
+    }
+    for (int i = 0; i < item->num_inputs; ++i) {
+      if (IsRefType(item->input_type(i))) return;
+    }
+    for (int i = 0; i < item->num_outputs; ++i) {
+      if (IsRefType(item->output_type(i))) return;
+    }
+    plan->nodes.push_back(item);
+    plan->output_base.push_back(num_outputs);
+    num_outputs += item->num_outputs;
+  }
+
+  // Without frames every node lives in the root frame, so the input slots
+  // computed in Initialize() are already a dense, flat layout.
+  plan->total_inputs = frame_info_[""]->total_inputs;
+  plan->dst_start.reserve(num_outputs + 1);
+  for (const NodeItem* item : plan->nodes) {
+    gtl::InlinedVector<std::vector<int32>, 4> dsts(item->num_outputs);
+    for (size_t i = 0; i < item->num_output_edges; ++i) {
+      const EdgeInfo& e = item->output_edge(i);
+      if (e.output_slot == Graph::kControlSlot) continue;
+      dsts[e.output_slot].push_back(gview_.node(e.dst_id)->input_start +
+                                    e.input_slot);
+    }
+    for (const std::vector<int32>& slots : dsts) {
+      plan->dst_start.push_back(plan->dst_slots.size());
+      plan->dst_slots.insert(plan->dst_slots.end(), slots.begin(),
+                             slots.end());
+    }
+  }
+  plan->dst_start.push_back(plan->dst_slots.size());
+
+  VLOG(1) << "Compiled an execution plan with " << plan->nodes.size()
+          << " nodes for device " << params_.device->name();
+  compiled_plan_ = std::move(plan);
 }
 
 // If a Node has been marked to use a ScopedAllocator x for output i, then
@@ -993,6 +1095,12 @@ class ExecutorState {
       counts_.adjust_for_activation(h, increment_dead, pending_result,
                                     dead_result);
     }
+    void adjust_for_activation_atomic(PendingCounts::Handle h,
+                                      bool increment_dead, int* pending_result,
+                                      int* dead_result) {
+      counts_.adjust_for_activation_atomic(h, increment_dead, pending_result,
+                                           dead_result);
+    }
 
     ~IterationState() { delete[] input_tensors; }
 
@@ -1171,6 +1279,14 @@ class ExecutorState {
                        EntryVector* outputs, TaggedNodeSeq* ready)
         EXCLUSIVE_LOCKS_REQUIRED(mu);
 
+    // Like ActivateNodes(), but updates the pending counts atomically instead
+    // of under `mu`, and does not track outstanding ops for the iteration.
+    // REQUIRES: The executor's graph has no control flow, so that this frame
+    // is the root frame and no node is a merge.
+    void ActivateNodesLockFree(const NodeItem* item, const bool is_dead,
+                               int64 iter, EntryVector* outputs,
+                               TaggedNodeSeq* ready) NO_THREAD_SAFETY_ANALYSIS;
+
     // Cleanup iterations of this frame starting from iteration iter.
     bool CleanupIterations(const GraphView* gview, int64 iter,
                            TaggedNodeSeq* ready) EXCLUSIVE_LOCKS_REQUIRED(mu);
@@ -1238,6 +1354,10 @@ class ExecutorState {
 
   const bool vlog_;  // true if VLOG_IS_ON(1). Used to check vlog cheaply.
 
+  // true if successors are activated with ActivateNodesLockFree(). Node state
+  // tracking for VLOG(1) needs the frame lock, so this is false when vlog_.
+  const bool lock_free_activation_;
+
   // true if LogMemory::IsEnabled(). Used to check memory enabled cheaply.
   const bool log_memory_;
 
@@ -1375,6 +1495,7 @@ class ExecutorState {
 
 ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
     : vlog_(VLOG_IS_ON(1)),
+      lock_free_activation_(!impl->requires_control_flow_ && !vlog_),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
       rendezvous_(args.rendezvous),
@@ -2115,7 +2236,14 @@ void ExecutorState::PropagateOutputs(const TaggedNode& tagged_node,
   FrameState* output_frame = input_frame;
   int64 output_iter = input_iter;
 
-  if (!item->is_enter_exit_or_next_iter) {
+  if (lock_free_activation_) {
+    // Fastest path for graphs without control flow: the root frame is never
+    // done before the step, so its outstanding ops need not be tracked.
+    DCHECK(!item->is_enter_exit_or_next_iter);
+    DCHECK_EQ(input_frame, root_frame_);
+    input_frame->ActivateNodesLockFree(item, is_dead, input_iter, outputs,
+                                       ready);
+  } else if (!item->is_enter_exit_or_next_iter) {
     // Fast path for nodes types that don't need special handling
     DCHECK_EQ(input_frame, output_frame);
     // Normal path for most nodes
@@ -2743,6 +2871,50 @@ void ExecutorState::FrameState::ActivateNodes(const NodeItem* item,
   }
 }
 
+void ExecutorState::FrameState::ActivateNodesLockFree(const NodeItem* item,
+                                                      const bool is_dead,
+                                                      int64 iter,
+                                                      EntryVector* outputs,
+                                                      TaggedNodeSeq* ready) {
+  const GraphView& gview = executor->gview_;
+  IterationState* iter_state = GetIteration(iter);
+  const size_t num_output_edges = item->num_output_edges;
+  const EdgeInfo* edges = item->output_edge_list();
+  Entry* input_tensors = iter_state->input_tensors;
+  for (size_t out_index = 0; out_index < num_output_edges; out_index++) {
+    const EdgeInfo& e = edges[out_index];
+    const NodeItem* dst_item = gview.node(e.dst_id);
+    const int src_slot = e.output_slot;
+
+    if (dst_item->is_sink) continue;
+    DCHECK(!dst_item->is_merge);
+
+    const bool is_control_edge = (src_slot == Graph::kControlSlot);
+    const bool increment_dead =
+        (is_dead || (!is_control_edge && !(*outputs)[src_slot].has_value));
+
+    // The input must be in place before the pending count is decremented:
+    // the acquire-release update below publishes it to whichever thread
+    // observes the count reaching zero and runs `dst_item`.
+    if (!is_control_edge) {
+      const int dst_loc = dst_item->input_start + e.input_slot;
+      if (e.is_last) {
+        input_tensors[dst_loc] = std::move((*outputs)[src_slot]);
+      } else {
+        input_tensors[dst_loc] = (*outputs)[src_slot];
+      }
+    }
+
+    int pending, dead;
+    iter_state->adjust_for_activation_atomic(dst_item->pending_id,
+                                             increment_dead, &pending, &dead);
+    if (pending == 0) {
+      const bool dst_dead = (dead > 0) && !dst_item->is_control_trigger;
+      ready->emplace_back(dst_item->node, this, iter, dst_dead);
+    }
+  }
+}
+
 void ExecutorState::FrameState::ActivateNexts(const GraphView* gview,
                                               int64 iter,
                                               TaggedNodeSeq* ready) {
@@ -2840,7 +3012,140 @@ bool ExecutorState::FrameState::CleanupIterations(const GraphView* gview,
   return IsFrameDone();
 }
 
+void ExecutorImpl::RunCompiledPlan(const Args& args, DoneCallback done) {
+  const CompiledPlan& plan = *compiled_plan_;
+  Device* device = params_.device;
+
+  // The inputs of every node, in the layout of IterationState::input_tensors.
+  std::vector<Tensor> input_tensors(plan.total_inputs);
+  std::vector<AllocatorAttributes> input_tensor_attrs(plan.total_inputs);
+
+  TensorValueVec inputs;
+  DeviceContextVec input_device_contexts;
+  AllocatorAttributeVec input_alloc_attrs;
+  checkpoint::TensorSliceReaderCacheWrapper slice_reader_cache;
+  Args::Runner runner = args.runner;
+
+  OpKernelContext::Params params;
+  params.step_id = args.step_id;
+  params.device = device;
+  params.rendezvous = args.rendezvous;
+  params.collective_executor = args.collective_executor;
+  params.session_state = args.session_state;
+  params.session_handle = args.session_handle;
+  params.tensor_store = args.tensor_store;
+  params.cancellation_manager = args.cancellation_manager;
+  params.call_frame = args.call_frame;
+  params.function_library = params_.function_library;
+  params.resource_manager = device->resource_manager();
+  params.step_container = args.step_container;
+  params.slice_reader_cache = &slice_reader_cache;
+  params.inputs = &inputs;
+  params.input_device_contexts = &input_device_contexts;
+  params.input_alloc_attrs = &input_alloc_attrs;
+  params.runner = &runner;
+  params.frame_iter = FrameAndIter(0, 0);
+
+  Status s;
+  for (size_t i = 0; i < plan.nodes.size() && s.ok(); ++i) {
+    const NodeItem& item = *plan.nodes[i];
+    const int num_inputs = item.num_inputs;
+    Tensor* first_input = input_tensors.data() + item.input_start;
+
+    inputs.clear();
+    inputs.resize(num_inputs);
+    input_device_contexts.clear();
+    input_device_contexts.resize(num_inputs);
+    input_alloc_attrs.clear();
+    input_alloc_attrs.resize(num_inputs);
+    for (int j = 0; j < num_inputs; ++j) {
+      inputs[j].tensor = first_input + j;
+      input_alloc_attrs[j] = input_tensor_attrs[item.input_start + j];
+    }
+
+    OpKernel* op_kernel = item.kernel;
+    params.op_kernel = op_kernel;
+    params.output_attr_array = item.output_attrs();
+    params.forward_from_array = item.forward_from();
+    OpKernelContext ctx(&params, item.num_outputs);
+    if (op_kernel->IsExpensive()) {
+      KernelTimer timer;
+      device->Compute(op_kernel, &ctx);
+      op_kernel->UpdateCostEstimate(timer.ElapsedCycles());
+    } else {
+      device->Compute(op_kernel, &ctx);
+    }
+
+    // Release the inputs, so that their buffers can be reused.
+    for (int j = 0; j < num_inputs; ++j) {
+      first_input[j] = Tensor();
+    }
+
+    s = ctx.status();
+    if (!s.ok()) {
+      s = AttachDef(s, op_kernel->def());
+      break;
+    }
+
+    const int32* dst_start = plan.dst_start.data() + plan.output_base[i];
+    for (int j = 0; j < item.num_outputs; ++j) {
+      const TensorValue val = ctx.release_output(j);
+      if (val.tensor == nullptr) {
+        s = errors::Internal("Missing ", j, "-th output from ",
+                             FormatNodeForError(*item.node));
+        break;
+      }
+      if (val->dtype() != item.output_type(j)) {
+        s = errors::Internal("Output ", j, " of type ",
+                             DataTypeString(val->dtype()),
+                             " does not match declared output type ",
+                             DataTypeString(item.output_type(j)),
+                             " for node ", FormatNodeForError(*item.node));
+        delete val.tensor;
+        break;
+      }
+      const AllocatorAttributes attr = ctx.output_alloc_attr(j);
+      const int32 begin = dst_start[j];
+      const int32 end = dst_start[j + 1];
+      for (int32 k = begin; k < end; ++k) {
+        const int32 slot = plan.dst_slots[k];
+        input_tensor_attrs[slot] = attr;
+        if (k + 1 == end) {
+          input_tensors[slot] = std::move(*val.tensor);
+        } else {
+          input_tensors[slot] = *val.tensor;
+        }
+      }
+      delete val.tensor;
+    }
+  }
+
+  if (!s.ok()) {
+    if (args.rendezvous) {
+      args.rendezvous->StartAbort(s);
+    }
+    if (args.collective_executor) {
+      args.collective_executor->StartAbort(s);
+    }
+    if (args.cancellation_manager) {
+      args.cancellation_manager->StartCancel();
+    }
+  } else if (args.sync_on_finish) {
+    s = device->Sync();
+  }
+  done(s);
+}
+
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
+  // Step statistics, memory logging and tracing are only implemented by
+  // ExecutorState, so fall back to it whenever any of them is requested.
+  if (compiled_plan_ != nullptr && args.stats_collector == nullptr &&
+      !LogMemory::IsEnabled() && tracing::GetTraceCollector() == nullptr &&
+      tracing::GetEventCollector(tracing::EventCategory::kCompute) ==
+          nullptr) {
+    RunCompiledPlan(args, std::move(done));
+    return;
+  }
   (new ExecutorState(args, this))->RunAsync(std::move(done));
 }
 
@@ -135,6 +135,12 @@ struct LocalExecutorParams {
   // when the executor is deleted.
   std::function<Status(const NodeDef&, OpKernel**)> create_kernel;
   std::function<void(OpKernel*)> delete_kernel;
+
+  // If true, and the graph is acyclic, has no control flow, send/recv or
+  // collective nodes, and only synchronous kernels on a CPU device, the
+  // executor flattens the graph into a linear plan at construction time and
+  // runs each step by iterating over that plan in the calling thread.
+  bool use_compiled_plan = false;
 };
 ::tensorflow::Status NewLocalExecutor(const LocalExecutorParams& params,
                                       std::unique_ptr<const Graph> graph,
@@ -0,0 +1,255 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/protobuf/function_graph_cache.pb.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns a fingerprint of `msg` that is stable across processes.
+uint64 StableFingerprint(const protobuf::MessageLite& msg) {
+  string serialized;
+  if (!SerializeToStringDeterministic(msg, &serialized)) return 0;
+  return Fingerprint64(serialized);
+}
+
+// Returns a description of the host that Grappler may rewrite the partitions
+// differently for: the features of its CPU (e.g. auto_mixed_precision_cpu
+// needs AVX-512 BF16) and the environment variables configuring the
+// optimizers. Keep in sync with MetaOptimizer::OptimizedGraphCachePath().
+string HostDescription() {
+  string description = "cpu_features=";
+  for (int feature = 0; feature <= port::AVX512_BF16; ++feature) {
+    const bool supported =
+        port::TestCPUFeature(static_cast<port::CPUFeature>(feature));
+    description.push_back(supported ? '1' : '0');
+  }
+  for (const char* prefix : {"TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_",
+                             "TF_AUTO_MIXED_PRECISION_CPU_GRAPH_REWRITE_"}) {
+    for (const char* variable :
+         {"LEVEL", "IGNORE_PERFORMANCE", "WHITELIST_ADD", "WHITELIST_REMOVE",
+          "GRAYLIST_ADD", "GRAYLIST_REMOVE", "BLACKLIST_ADD",
+          "BLACKLIST_REMOVE", "CLEARLIST_ADD", "CLEARLIST_REMOVE"}) {
+      const string name = strings::StrCat(prefix, variable);
+      const char* value = getenv(name.c_str());
+      if (value != nullptr) {
+        strings::StrAppend(&description, "\n", name, "=", value);
+      }
+    }
+  }
+  return description;
+}
+
+// Adds the functions of `library` to `lib_def`, replacing the functions with
+// the same name but another definition.
+Status AddCachedFunctions(const FunctionDefLibrary& library,
+                          FunctionLibraryDefinition* lib_def) {
+  for (const FunctionDef& fdef : library.function()) {
+    const string& name = fdef.signature().name();
+    const FunctionDef* existing = lib_def->Find(name);
+    if (existing == nullptr) {
+      TF_RETURN_IF_ERROR(lib_def->AddFunctionDef(fdef));
+    } else if (!FunctionDefsEqual(*existing, fdef)) {
+      TF_RETURN_IF_ERROR(lib_def->ReplaceFunction(name, fdef));
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+FunctionGraphCache::FunctionGraphCache(Env* env, const string& directory)
+    : env_(env), directory_(directory) {}
+
+/* static */
+FunctionGraphCache* FunctionGraphCache::Global() {
+  static FunctionGraphCache* cache = []() -> FunctionGraphCache* {
+    const char* directory = getenv("TF_FUNCTION_GRAPH_CACHE_DIR");
+    if (directory == nullptr || *directory == '\0') return nullptr;
+    Status s = Env::Default()->RecursivelyCreateDir(directory);
+    if (!s.ok()) {
+      LOG(WARNING) << "Not caching function graphs in " << directory << ": "
+                   << s;
+      return nullptr;
+    }
+    VLOG(1) << "Caching function graphs in " << directory;
+    return new FunctionGraphCache(Env::Default(), directory);
+  }();
+  return cache;
+}
+
+/* static */
+string FunctionGraphCache::MakeKey(
+    const string& function_name, AttrSlice attrs,
+    const FunctionLibraryRuntime::InstantiateOptions& options,
+    const FunctionLibraryDefinition& lib_def, const DeviceSet& device_set) {
+  std::vector<string> entries;
+  for (const auto& attr : attrs) {
+    entries.push_back(strings::StrCat("attr:", attr.first, "=",
+                                      StableFingerprint(attr.second)));
+  }
+  for (int i = 0; i < options.input_devices.size(); ++i) {
+    entries.push_back(
+        strings::StrCat("input_device:", i, "=", options.input_devices[i]));
+  }
+  for (int i = 0; i < options.output_devices.size(); ++i) {
+    entries.push_back(
+        strings::StrCat("output_device:", i, "=", options.output_devices[i]));
+  }
+  for (const auto& it : options.input_tensor_shapes) {
+    entries.push_back(strings::StrCat("input_shape:", it.first, "=",
+                                      it.second.DebugString()));
+  }
+  for (const auto& it : options.input_resource_dtypes_and_shapes) {
+    entries.push_back(strings::StrCat("input_resource:", it.first, "=",
+                                      DataTypeString(it.second.first), ":",
+                                      it.second.second.DebugString()));
+  }
+  for (const string& name : lib_def.ListFunctionNames()) {
+    entries.push_back(strings::StrCat(
+        "function:", name, "=", StableFingerprint(*lib_def.Find(name)), ":",
+        lib_def.FindGradient(name)));
+  }
+  for (const Device* device : device_set.devices()) {
+    // The physical device (e.g. the compute capability of a GPU) and its
+    // memory limit change the rewrites, but the incarnation is random.
+    DeviceAttributes attributes = device->attributes();
+    attributes.clear_incarnation();
+    entries.push_back(strings::StrCat("device:", device->name(), "=",
+                                      device->device_type(), ":",
+                                      StableFingerprint(attributes)));
+  }
+  std::sort(entries.begin(), entries.end());
+
+  return strings::StrCat(
+      "version=", TF_VERSION_STRING, ":", tf_git_version(), "\n",
+      "function=", function_name, "\n", "target=", options.target, "\n",
+      "executor_type=", options.executor_type, "\n",
+      "config=", StableFingerprint(options.config_proto), "\n",
+      "optimize_graph_fn=", options.optimize_graph_fn != nullptr, "\n",
+      "host=", HostDescription(), "\n",
+      str_util::Join(entries, "\n"));
+}
+
+string FunctionGraphCache::FilePath(const string& key) const {
+  return io::JoinPath(
+      directory_,
+      strings::Printf("%016llx.pb",
+                      static_cast<unsigned long long>(Fingerprint64(key))));
+}
+
+bool FunctionGraphCache::Lookup(
+    const string& key, FunctionLibraryDefinition* lib_def,
+    std::unordered_map<string, std::unique_ptr<Graph>>* subgraphs) {
+  const string path = FilePath(key);
+  if (!env_->FileExists(path).ok()) return false;
+  CachedFunctionGraphs entry;
+  Status s = ReadBinaryProto(env_, path, &entry);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring unreadable function graph cache entry " << path
+                 << ": " << s;
+    return false;
+  }
+  if (entry.key() != key) {
+    VLOG(1) << "Function graph cache entry " << path << " has another key";
+    return false;
+  }
+
+  // The partitions may call functions that were created by the optimizers,
+  // so they are converted against a copy of `lib_def` with the cached
+  // functions. `lib_def` is only updated once the whole entry is valid. The
+  // entry's key covers the library it was optimized against, so this only
+  // adds those functions.
+  FunctionLibraryDefinition cached_lib_def(*lib_def);
+  s = AddCachedFunctions(entry.library(), &cached_lib_def);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring function graph cache entry " << path << ": "
+                 << s;
+    return false;
+  }
+
+  std::unordered_map<string, std::unique_ptr<Graph>> graphs;
+  GraphConstructorOptions opts;
+  opts.allow_internal_ops = true;
+  opts.expect_device_spec = true;
+  for (const auto& it : entry.partition_graphs()) {
+    // Like the partitions of PartitionFunctionGraph(), each graph owns the
+    // functions it calls.
+    auto graph = absl::make_unique<Graph>(
+        cached_lib_def.ReachableDefinitions(it.second));
+    s = ConvertGraphDefToGraph(opts, it.second, graph.get());
+    if (!s.ok()) {
+      LOG(WARNING) << "Ignoring function graph cache entry " << path << ": "
+                   << s;
+      return false;
+    }
+    graphs.emplace(it.first, std::move(graph));
+  }
+
+  // This can't fail, since the same functions were added to the copy.
+  TF_CHECK_OK(AddCachedFunctions(entry.library(), lib_def));
+  *subgraphs = std::move(graphs);
+  VLOG(1) << "Loaded " << subgraphs->size() << " partition graphs from "
+          << path;
+  return true;
+}
+
+Status FunctionGraphCache::Insert(
+    const string& key, const FunctionLibraryDefinition& lib_def,
+    const std::unordered_map<string, std::unique_ptr<Graph>>& subgraphs) {
+  CachedFunctionGraphs entry;
+  entry.set_key(key);
+  for (const auto& it : subgraphs) {
+    it.second->ToGraphDef(&(*entry.mutable_partition_graphs())[it.first]);
+  }
+  *entry.mutable_library() = lib_def.ToProto();
+
+  // Write to a unique temporary file and rename it into place, so that
+  // concurrent readers never observe a partially written entry.
+  const string path = FilePath(key);
+  const string tmp_path = strings::StrCat(
+      path, ".tmp", strings::Printf("%016llx", static_cast<unsigned long long>(
+                                                    random::New64())));
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env_, tmp_path, entry));
+  Status s = env_->RenameFile(tmp_path, path);
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+    return s;
+  }
+  VLOG(1) << "Stored " << subgraphs.size() << " partition graphs in " << path;
+  return Status::OK();
+}
+
+}  // namespace tensorflow
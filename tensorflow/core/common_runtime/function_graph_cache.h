@@ -0,0 +1,79 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
+
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+
+// A persistent, on-disk cache of the partitioned graphs that
+// ProcessFunctionLibraryRuntime::InstantiateMultiDevice() produces by running
+// placement, the graph optimization passes and partitioning. Reusing them
+// across process restarts avoids redoing that work on every cold start.
+//
+// Each entry is a CachedFunctionGraphs proto stored in its own file, named by
+// the fingerprint of its key. Entries are written atomically (write to a
+// temporary file, then rename), so several processes may share a directory.
+// Stale entries are never deleted; the key includes the TensorFlow version,
+// so entries written by another build are simply not found.
+class FunctionGraphCache {
+ public:
+  FunctionGraphCache(Env* env, const string& directory);
+
+  // Returns the process-wide cache stored in the directory named by the
+  // TF_FUNCTION_GRAPH_CACHE_DIR environment variable, or nullptr if that
+  // variable is not set.
+  static FunctionGraphCache* Global();
+
+  // Returns the key for instantiating `function_name` with `attrs` and
+  // `options`, from the function library `lib_def`, over the devices in
+  // `device_set`.
+  static string MakeKey(
+      const string& function_name, AttrSlice attrs,
+      const FunctionLibraryRuntime::InstantiateOptions& options,
+      const FunctionLibraryDefinition& lib_def, const DeviceSet& device_set);
+
+  // Looks up the entry for `key`. On a hit, fills `*subgraphs` with the
+  // partition graphs, whose nodes are assigned to the device they were
+  // partitioned for, adds the cached functions to `*lib_def` and returns
+  // true. A missing, unreadable or mismatching entry is a miss.
+  bool Lookup(const string& key, FunctionLibraryDefinition* lib_def,
+              std::unordered_map<string, std::unique_ptr<Graph>>* subgraphs);
+
+  // Stores `subgraphs`, optimized against `lib_def`, under `key`.
+  Status Insert(
+      const string& key, const FunctionLibraryDefinition& lib_def,
+      const std::unordered_map<string, std::unique_ptr<Graph>>& subgraphs);
+
+ private:
+  string FilePath(const string& key) const;
+
+  Env* const env_;
+  const string directory_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FunctionGraphCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
@@ -59,6 +59,7 @@ namespace tensorflow {
 GraphExecutionState::GraphExecutionState(
     GraphDef* graph_def, const GraphExecutionStateOptions& options)
     : stateful_placements_(options.stateful_placements),
+      previous_placements_(options.previous_placements),
       device_set_(options.device_set),
       session_options_(options.session_options),
       session_handle_(options.session_handle),
@@ -203,6 +204,9 @@ Status GraphExecutionState::Extend(
   combined_options.session_options = session_options_;
   combined_options.session_handle = session_handle_;
   combined_options.stateful_placements = stateful_placements_;
+  if (session_options_->config.experimental().incremental_placement()) {
+    SavePlacements(&combined_options.previous_placements);
+  }
 
   // NOTE(mrry): `gdef` is no longer valid after the constructor
   // executes.
@@ -246,6 +250,35 @@ void GraphExecutionState::RestoreStatefulNodes(Graph* graph) {
   }
 }
 
+void GraphExecutionState::SavePlacements(
+    std::unordered_map<string, string>* placements) const {
+  if (graph_ == nullptr) return;
+  // Only save the nodes of the original graph: nodes that optimization
+  // passes added may be named like nodes of a later extension.
+  for (const NodeDef& node : original_graph_def_.node()) {
+    const Node* n = get_node_by_name(node.name());
+    if (n != nullptr && n->has_assigned_device_name()) {
+      (*placements)[node.name()] = n->assigned_device_name();
+    }
+  }
+}
+
+void GraphExecutionState::RestorePreviousPlacements(Graph* graph) {
+  if (previous_placements_.empty()) return;
+  int num_restored = 0;
+  for (Node* n : graph->op_nodes()) {
+    if (n->has_assigned_device_name()) continue;
+    auto iter = previous_placements_.find(n->name());
+    if (iter != previous_placements_.end()) {
+      n->set_assigned_device_name(iter->second);
+      ++num_restored;
+    }
+  }
+  VLOG(1) << "Restored the placement of " << num_restored << " of "
+          << graph->num_op_nodes() << " nodes";
+  previous_placements_.clear();
+}
+
 namespace {
 
 class TensorConnectionPruneRewrite : public subgraph::PruneRewrite {
@@ -560,6 +593,9 @@ Status GraphExecutionState::InitBaseGraph(const BuildGraphOptions& options) {
 
   // Save stateful placements before placing.
   RestoreStatefulNodes(new_graph.get());
+  // Restore the placement of the graph being extended, so that the placer
+  // only places the new nodes.
+  RestorePreviousPlacements(new_graph.get());
 
   GraphOptimizationPassOptions optimization_options;
   optimization_options.session_handle = session_handle_;
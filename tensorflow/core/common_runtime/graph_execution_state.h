@@ -46,6 +46,11 @@ struct GraphExecutionStateOptions {
   // A map from node name to device name, representing the unchangeable
   // placement of stateful nodes.
   std::unordered_map<string, string> stateful_placements;
+  // A map from node name to device name, representing the placement of
+  // the nodes of a previously placed graph that this graph extends. These
+  // nodes keep their device: the placer still builds the colocation groups
+  // of the whole graph, but only selects devices for the remaining nodes.
+  std::unordered_map<string, string> previous_placements;
 };
 
 // A ClientGraph is simply a sub-graph of the full graph as induced by
@@ -131,7 +136,10 @@ class GraphExecutionState {
   //
   // NOTE(mrry): This method respects the placement of stateful nodes in
   // in *this, but currently does not transfer any other placement
-  // or cost model information to the new graph.
+  // or cost model information to the new graph. If the session enables
+  // `ConfigProto.Experimental.incremental_placement`, the placement of
+  // all nodes in *this is transferred, and only the nodes of
+  // "extension_def" are placed.
   Status Extend(const GraphDef& extension_def,
                 std::unique_ptr<GraphExecutionState>* out) const;
 
@@ -182,6 +190,12 @@ class GraphExecutionState {
   void SaveStatefulNodes(Graph* graph);
   void RestoreStatefulNodes(Graph* graph);
 
+  // Map of the placements of the graph that this graph extends, if
+  // incremental placement is enabled. Cleared once restored.
+  std::unordered_map<string, string> previous_placements_;
+  void SavePlacements(std::unordered_map<string, string>* placements) const;
+  void RestorePreviousPlacements(Graph* graph);
+
   // Extract the subset of the graph that needs to be run, adding feed/fetch
   // ops as needed.
   Status PruneGraph(const BuildGraphOptions& options, Graph* graph,
@@ -0,0 +1,165 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/input_forwarding_order_pass.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns true if `n` may forward the buffer of its input `input_index` to
+// its output, i.e. if its kernel calls forward_input_or_allocate_output() for
+// that input.
+bool CanForwardInput(const Node& n, int input_index) {
+  static const std::unordered_set<string>* const kUnaryOps =
+      new std::unordered_set<string>({
+          "Abs", "Acos", "Acosh", "Asin", "Asinh", "Atan", "Atanh", "Ceil",
+          "Cos", "Cosh", "Digamma", "Elu", "Erf", "Erfc", "Exp", "Expm1",
+          "Floor", "Inv", "Invert", "LeakyRelu", "Lgamma", "Log", "Log1p",
+          "LogicalNot", "Neg", "Reciprocal", "Relu", "Relu6", "Rint", "Round",
+          "Rsqrt", "Selu", "Sigmoid", "Sign", "Sin", "Sinh", "Sqrt", "Square",
+          "Tan", "Tanh",
+      });
+  static const std::unordered_set<string>* const kBinaryOps =
+      new std::unordered_set<string>({
+          "Add", "AddV2", "Div", "DivNoNan", "EluGrad", "FloorDiv", "FloorMod",
+          "Maximum", "Minimum", "Mul", "Pow", "RealDiv", "ReciprocalGrad",
+          "Relu6Grad", "ReluGrad", "RsqrtGrad", "SeluGrad", "SigmoidGrad",
+          "SqrtGrad", "SquaredDifference", "Sub", "TanhGrad", "TruncateDiv",
+      });
+  const string& op = n.type_string();
+  if (kUnaryOps->count(op) > 0) return input_index == 0;
+  if (op == "BiasAdd") return input_index == 0;
+  if (kBinaryOps->count(op) > 0) return input_index <= 1;
+  return false;
+}
+
+// Returns the consumer of output `output_index` of `n` that should run after
+// all the other consumers, or nullptr if there is none. `order` maps node ids
+// to positions in a topological order of the graph.
+Node* FindForwardingConsumer(const Node& n, int output_index,
+                             const std::vector<int>& order,
+                             std::vector<Node*>* other_consumers) {
+  other_consumers->clear();
+  Node* last = nullptr;
+  int num_uses = 0;
+  for (const Edge* e : n.out_edges()) {
+    if (e->IsControlEdge() || e->src_output() != output_index) continue;
+    Node* consumer = e->dst();
+    if (!consumer->IsOp() || consumer->IsSend() || consumer->IsRetval() ||
+        consumer->assigned_device_name_index() !=
+            n.assigned_device_name_index()) {
+      return nullptr;
+    }
+    if (last == nullptr || order[consumer->id()] > order[last->id()]) {
+      if (last != nullptr) other_consumers->push_back(last);
+      last = consumer;
+      num_uses = 1;
+    } else if (consumer == last) {
+      ++num_uses;
+    } else {
+      other_consumers->push_back(consumer);
+    }
+  }
+  if (last == nullptr || num_uses != 1 || other_consumers->empty()) {
+    return nullptr;
+  }
+
+  // `last` consumes the tensor exactly once; check that it can reuse it.
+  for (const Edge* e : last->in_edges()) {
+    if (e->src() != &n || e->src_output() != output_index) continue;
+    if (!CanForwardInput(*last, e->dst_input()) ||
+        last->input_type(e->dst_input()) != n.output_type(output_index)) {
+      return nullptr;
+    }
+  }
+  return last;
+}
+
+// Returns true if there is an edge from `src` to `dst`.
+bool HasEdgeTo(const Node& src, const Node& dst) {
+  for (const Edge* e : src.out_edges()) {
+    if (e->dst() == &dst) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+Status InputForwardingOrderPass::Run(
+    const GraphOptimizationPassOptions& options) {
+  if (options.session_options == nullptr ||
+      !options.session_options->config.experimental()
+           .order_consumers_for_input_forwarding() ||
+      options.graph == nullptr || *options.graph == nullptr) {
+    return Status::OK();
+  }
+  Graph* g = options.graph->get();
+
+  for (const Node* n : g->op_nodes()) {
+    if (n->IsControlFlow()) {
+      VLOG(1) << "Not ordering consumers for input forwarding in a graph with "
+                 "control flow";
+      return Status::OK();
+    }
+  }
+
+  std::vector<Node*> rpo;
+  GetReversePostOrder(*g, &rpo);
+  std::vector<int> order(g->num_node_ids(), -1);
+  for (int i = 0; i < rpo.size(); ++i) {
+    order[rpo[i]->id()] = i;
+  }
+
+  // New control edges always go forward in `order`, so the graph stays
+  // acyclic and `order` remains a topological order while we add them.
+  int num_edges_added = 0;
+  std::vector<Node*> other_consumers;
+  for (Node* n : rpo) {
+    if (!n->IsOp()) continue;
+    for (int i = 0; i < n->num_outputs(); ++i) {
+      if (IsRefType(n->output_type(i))) continue;
+      Node* last = FindForwardingConsumer(*n, i, order, &other_consumers);
+      if (last == nullptr) continue;
+      for (Node* consumer : other_consumers) {
+        // Consumers that already feed `last`, or use the tensor more than
+        // once, need no (further) edge.
+        if (!HasEdgeTo(*consumer, *last)) {
+          g->AddControlEdge(consumer, last);
+          ++num_edges_added;
+        }
+      }
+    }
+  }
+  VLOG(1) << "Added " << num_edges_added
+          << " control edges for input forwarding";
+  return Status::OK();
+}
+
+// Runs after the other passes in this grouping, which may rewrite the graph.
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, 100,
+                      InputForwardingOrderPass);
+
+}  // namespace tensorflow
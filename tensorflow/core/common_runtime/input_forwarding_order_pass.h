@@ -0,0 +1,58 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_INPUT_FORWARDING_ORDER_PASS_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_INPUT_FORWARDING_ORDER_PASS_H_
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+
+namespace tensorflow {
+
+// Orders the consumers of a tensor so that the last one can reuse the
+// tensor's buffer for its output.
+//
+// Kernels such as the element-wise ops call
+// OpKernelContext::forward_input_or_allocate_output(), which only reuses an
+// input buffer if no other tensor refers to it when the kernel runs. When a
+// tensor has several consumers, that depends on the order in which the
+// executor happens to run them:
+//
+//        x                      x
+//       / \                    / \
+//      a   relu       =>      a   relu
+//                              \..^
+//
+// If `relu` runs before `a`, it must allocate its output. This pass adds a
+// control edge from `a` to `relu`, so that `relu` runs last and (unless `a`
+// keeps a reference to `x`, e.g. because its output aliases it) forwards the
+// buffer of `x`.
+//
+// To avoid introducing cycles, the forwarding consumer must be the last of
+// the consumers in a topological order of the graph. Only consumers on the
+// same device as the tensor are ordered, and graphs with control flow are not
+// changed, since a control edge from a dead node would make its destination
+// dead.
+//
+// The pass runs on the pruned client graph (POST_REWRITE_FOR_EXEC), so that
+// the new control edges never pull in nodes that the step does not need. It
+// is enabled by ConfigProto.Experimental.order_consumers_for_input_forwarding.
+class InputForwardingOrderPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_INPUT_FORWARDING_ORDER_PASS_H_
@@ -0,0 +1,132 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/input_forwarding_order_pass.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+using ::tensorflow::test::function::GDef;
+using ::tensorflow::test::function::NDef;
+
+// Runs the pass over `graph_def` and returns the control edges between op
+// nodes of the result, as (src, dst) name pairs.
+std::vector<std::pair<string, string>> RunPass(const GraphDef& graph_def,
+                                               bool enabled = true) {
+  std::unique_ptr<Graph> graph = absl::make_unique<Graph>(OpRegistry::Global());
+  GraphConstructorOptions opts;
+  TF_CHECK_OK(ConvertGraphDefToGraph(opts, graph_def, graph.get()));
+  SessionOptions session_options;
+  session_options.config.mutable_experimental()
+      ->set_order_consumers_for_input_forwarding(enabled);
+  GraphOptimizationPassOptions options;
+  options.session_options = &session_options;
+  options.graph = &graph;
+  InputForwardingOrderPass pass;
+  TF_CHECK_OK(pass.Run(options));
+
+  std::vector<std::pair<string, string>> control_edges;
+  for (const Edge* e : graph->edges()) {
+    if (e->IsControlEdge() && e->src()->IsOp() && e->dst()->IsOp()) {
+      control_edges.emplace_back(e->src()->name(), e->dst()->name());
+    }
+  }
+  return control_edges;
+}
+
+TEST(InputForwardingOrderPassTest, OrdersConsumersOfSharedTensor) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a", "Neg", {"x"}, {{"T", DT_FLOAT}}),
+      NDef("b", "Relu", {"x"}, {{"T", DT_FLOAT}}),
+  });
+  // Either consumer can forward `x`; the pass picks whichever comes last in
+  // its topological order.
+  auto control_edges = RunPass(graph_def);
+  ASSERT_EQ(1, control_edges.size());
+  EXPECT_TRUE(control_edges[0] == std::make_pair(string("a"), string("b")) ||
+              control_edges[0] == std::make_pair(string("b"), string("a")));
+}
+
+TEST(InputForwardingOrderPassTest, OrdersAfterAllOtherConsumers) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a", "Shape", {"x"}, {{"T", DT_FLOAT}}),
+      NDef("b", "Shape", {"x"}, {{"T", DT_FLOAT}}),
+      NDef("y", "Square", {"x"}, {{"T", DT_FLOAT}}),
+      // `c` comes after `y`, so it is the last consumer of `x`.
+      NDef("c", "Add", {"x", "y"}, {{"T", DT_FLOAT}}),
+  });
+  auto control_edges = RunPass(graph_def);
+  std::sort(control_edges.begin(), control_edges.end());
+  EXPECT_EQ((std::vector<std::pair<string, string>>{{"a", "c"}, {"b", "c"}}),
+            control_edges);
+}
+
+TEST(InputForwardingOrderPassTest, IgnoresConsumersThatCannotForward) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a", "Shape", {"x"}, {{"T", DT_FLOAT}}),
+      NDef("b", "Identity", {"x"}, {{"T", DT_FLOAT}}),
+  });
+  EXPECT_TRUE(RunPass(graph_def).empty());
+}
+
+TEST(InputForwardingOrderPassTest, IgnoresConsumersUsingTensorTwice) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a", "Neg", {"x"}, {{"T", DT_FLOAT}}),
+      // `b` is the last consumer, but reads `x` twice, so cannot forward it.
+      NDef("b", "Mul", {"x", "x", "^a"}, {{"T", DT_FLOAT}}),
+  });
+  EXPECT_EQ((std::vector<std::pair<string, string>>{{"a", "b"}}),
+            RunPass(graph_def));
+}
+
+TEST(InputForwardingOrderPassTest, SkipsGraphsWithControlFlow) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("p", "Placeholder", {}, {{"dtype", DT_BOOL}}),
+      NDef("s", "Switch", {"x", "p"}, {{"T", DT_FLOAT}}),
+      NDef("a", "Neg", {"s:1"}, {{"T", DT_FLOAT}}),
+      NDef("b", "Relu", {"s:1"}, {{"T", DT_FLOAT}}),
+  });
+  EXPECT_TRUE(RunPass(graph_def).empty());
+}
+
+TEST(InputForwardingOrderPassTest, DisabledByDefault) {
+  GraphDef graph_def = GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a", "Neg", {"x"}, {{"T", DT_FLOAT}}),
+      NDef("b", "Relu", {"x"}, {{"T", DT_FLOAT}}),
+  });
+  EXPECT_TRUE(RunPass(graph_def, /*enabled=*/false).empty());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -20,7 +20,9 @@ limitations under the License.
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/common_runtime/process_state.h"
 #include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/cpu_feature_guard.h"
 #include "tensorflow/core/platform/cpu_info.h"
@@ -68,6 +70,8 @@ bool LocalDevice::use_global_threadpool_ = true;
 mutex LocalDevice::global_tp_mu_;
 gtl::InlinedVector<LocalDevice::EigenThreadPoolInfo*, 4>
     LocalDevice::global_tp_info_;
+std::map<string, LocalDevice::EigenThreadPoolInfo*>
+    LocalDevice::global_named_tp_info_;
 
 struct LocalDevice::EigenThreadPoolInfo {
   // Wrapper so we can provide the CPUAllocator to Eigen for use
@@ -86,9 +90,17 @@ struct LocalDevice::EigenThreadPoolInfo {
 
   explicit EigenThreadPoolInfo(const SessionOptions& options, int numa_node,
                                Allocator* allocator) {
+    const ThreadPoolOptionProto& pool_options =
+        options.config.experimental().intra_op_thread_pool();
     // Use session setting if specified.
-    int32 intra_op_parallelism_threads =
-        options.config.intra_op_parallelism_threads();
+    int32 intra_op_parallelism_threads = pool_options.num_threads();
+    if (intra_op_parallelism_threads == 0) {
+      intra_op_parallelism_threads = pool_options.cpu_affinity_size();
+    }
+    if (intra_op_parallelism_threads == 0) {
+      intra_op_parallelism_threads =
+          options.config.intra_op_parallelism_threads();
+    }
     // If no session setting, use environment setting.
     if (intra_op_parallelism_threads == 0) {
       static int env_num_threads = NumIntraOpThreadsFromEnvironment();
@@ -106,9 +118,15 @@ struct LocalDevice::EigenThreadPoolInfo {
     }
     ThreadOptions thread_opts;
     thread_opts.numa_node = numa_node;
+    thread_opts.cpu_affinity.assign(pool_options.cpu_affinity().begin(),
+                                    pool_options.cpu_affinity().end());
+    cpu_affinity_ = thread_opts.cpu_affinity;
     eigen_worker_threads_.num_threads = intra_op_parallelism_threads;
     eigen_worker_threads_.workers = new thread::ThreadPool(
-        options.env, thread_opts, strings::StrCat("numa_", numa_node, "_Eigen"),
+        options.env, thread_opts,
+        pool_options.global_name().empty()
+            ? strings::StrCat("numa_", numa_node, "_Eigen")
+            : strings::StrCat(pool_options.global_name(), "_Eigen"),
         intra_op_parallelism_threads,
         !options.config.experimental().disable_thread_spinning(),
         /*allocator=*/nullptr);
@@ -136,6 +154,7 @@ struct LocalDevice::EigenThreadPoolInfo {
   }
 
   DeviceBase::CpuWorkerThreads eigen_worker_threads_;
+  std::vector<int> cpu_affinity_;
   std::unique_ptr<Eigen::ThreadPoolInterface> eigen_threadpool_wrapper_;
   std::unique_ptr<Eigen::ThreadPoolDevice> eigen_device_;
   std::unique_ptr<EigenAllocator> eigen_allocator_;
@@ -153,7 +172,24 @@ LocalDevice::LocalDevice(const SessionOptions& options,
     set_use_global_threadpool(false);
   }
 
-  if (use_global_threadpool_) {
+  const ThreadPoolOptionProto& pool_options =
+      options.config.experimental().intra_op_thread_pool();
+  if (!pool_options.global_name().empty()) {
+    // A named partition is shared by every session naming it, independent of
+    // use_global_threadpool_ and NUMA placement.
+    mutex_lock l(global_tp_mu_);
+    // DirectSession already rejected mismatching options in
+    // CreateNamedThreadPool().
+    Status s = GetOrCreateNamedThreadPool(options, &tp_info);
+    if (!s.ok()) {
+      LOG(WARNING) << s.error_message() << "; using the existing pool";
+    }
+  } else if (pool_options.cpu_affinity_size() > 0) {
+    // Pinned pools are never shared with sessions that did not ask for them.
+    owned_tp_info_.reset(new LocalDevice::EigenThreadPoolInfo(
+        options, port::kNUMANoAffinity, nullptr));
+    tp_info = owned_tp_info_.get();
+  } else if (use_global_threadpool_) {
     mutex_lock l(global_tp_mu_);
     if (options.config.experimental().use_numa_affinity()) {
       int numa_node = attributes.locality().numa_node();
@@ -190,4 +226,49 @@ LocalDevice::LocalDevice(const SessionOptions& options,
 
 LocalDevice::~LocalDevice() {}
 
+/* static */
+Status LocalDevice::CreateNamedThreadPool(const SessionOptions& options) {
+  const ThreadPoolOptionProto& pool_options =
+      options.config.experimental().intra_op_thread_pool();
+  if (pool_options.global_name().empty()) return Status::OK();
+  mutex_lock l(global_tp_mu_);
+  EigenThreadPoolInfo* tp_info;
+  return GetOrCreateNamedThreadPool(options, &tp_info);
+}
+
+/* static */
+Status LocalDevice::GetOrCreateNamedThreadPool(const SessionOptions& options,
+                                               EigenThreadPoolInfo** tp_info) {
+  const ThreadPoolOptionProto& pool_options =
+      options.config.experimental().intra_op_thread_pool();
+  const string& name = pool_options.global_name();
+  EigenThreadPoolInfo*& named = global_named_tp_info_[name];
+  if (named == nullptr) {
+    named = new LocalDevice::EigenThreadPoolInfo(
+        options, port::kNUMANoAffinity, nullptr);
+    *tp_info = named;
+    return Status::OK();
+  }
+  *tp_info = named;
+  if (pool_options.num_threads() != 0 &&
+      pool_options.num_threads() != named->eigen_worker_threads_.num_threads) {
+    return errors::InvalidArgument(
+        "Intra-op thread pool ", name,
+        " configured previously with num_threads=",
+        named->eigen_worker_threads_.num_threads,
+        "; cannot re-configure with num_threads=", pool_options.num_threads());
+  }
+  const std::vector<int> cpu_affinity(pool_options.cpu_affinity().begin(),
+                                      pool_options.cpu_affinity().end());
+  if (cpu_affinity != named->cpu_affinity_) {
+    return errors::InvalidArgument(
+        "Intra-op thread pool ", name,
+        " configured previously with cpu_affinity=[",
+        str_util::Join(named->cpu_affinity_, ","),
+        "]; cannot re-configure with cpu_affinity=[",
+        str_util::Join(cpu_affinity, ","), "]");
+  }
+  return Status::OK();
+}
+
 }  // namespace tensorflow
@@ -16,8 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_LOCAL_DEVICE_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_LOCAL_DEVICE_H_
 
+#include <map>
+
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
@@ -37,6 +40,13 @@ class LocalDevice : public Device {
               const DeviceAttributes& attributes);
   ~LocalDevice() override;
 
+  // If `options` name an intra-op thread pool (see
+  // ConfigProto.Experimental.intra_op_thread_pool), creates it unless it
+  // already exists. Since the pool is shared by every session naming it,
+  // returns InvalidArgument if it exists with another num_threads or
+  // cpu_affinity.
+  static Status CreateNamedThreadPool(const SessionOptions& options);
+
  private:
   static bool use_global_threadpool_;
 
@@ -54,6 +64,18 @@ class LocalDevice : public Device {
   static gtl::InlinedVector<EigenThreadPoolInfo*, 4> global_tp_info_
       GUARDED_BY(global_tp_mu_);
 
+  // ThreadPoolDevices whose session names an intra-op thread pool (see
+  // ConfigProto.Experimental.intra_op_thread_pool) share the pool registered
+  // under that name instead.
+  static std::map<string, EigenThreadPoolInfo*> global_named_tp_info_
+      GUARDED_BY(global_tp_mu_);
+
+  // Sets `*tp_info` to the pool named by `options`, creating it if needed.
+  // If the pool exists with other options, `*tp_info` is still set.
+  static Status GetOrCreateNamedThreadPool(const SessionOptions& options,
+                                           EigenThreadPoolInfo** tp_info)
+      EXCLUSIVE_LOCKS_REQUIRED(global_tp_mu_);
+
   friend class test::Benchmark;
 
   TF_DISALLOW_COPY_AND_ASSIGN(LocalDevice);
@@ -16,6 +16,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <atomic>
+#include <cstring>
+
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/logging.h"
@@ -226,6 +229,22 @@ class PendingCounts {
     }
   }
 
+  // The same as adjust_for_activation(), but performs the update as a
+  // single atomic read-modify-write, so that it may run concurrently with
+  // other calls to adjust_for_activation_atomic() on the same handle.
+  // Must not be mixed with the non-atomic mutators while other threads may
+  // be updating the same PendingCounts.
+  void adjust_for_activation_atomic(Handle h, bool increment_dead,
+                                    int* pending_result, int* dead_result) {
+    if (h.is_large_) {
+      adjust_for_activation_atomic_shared<LargeCounts, uint64>(
+          Large(h), increment_dead, pending_result, dead_result);
+    } else {
+      adjust_for_activation_atomic_shared<PackedCounts, uint8>(
+          Packed(h), increment_dead, pending_result, dead_result);
+    }
+  }
+
   class Handle {
    public:
     Handle() : byte_offset_(0), is_large_(0) {}
@@ -251,6 +270,35 @@ class PendingCounts {
     *pending_result = c->pending;
   }
 
+  // The counts are read and written as a single Word, so that the dead count
+  // and pending count are updated together without holding a lock.
+  template <typename T, typename Word>
+  inline void adjust_for_activation_atomic_shared(T* c, bool increment_dead,
+                                                  int* pending_result,
+                                                  int* dead_result) {
+    static_assert(sizeof(T) == sizeof(Word), "Counts must fit in one Word");
+    static_assert(sizeof(std::atomic<Word>) == sizeof(Word),
+                  "std::atomic<Word> must have the same size as Word");
+    DCHECK_EQ(reinterpret_cast<uintptr_t>(c) % alignof(std::atomic<Word>), 0);
+    std::atomic<Word>* word = reinterpret_cast<std::atomic<Word>*>(c);
+    Word old_word = word->load(std::memory_order_relaxed);
+    Word new_word;
+    T counts;
+    do {
+      memcpy(&counts, &old_word, sizeof(T));
+      DCHECK_GE(counts.pending, 1);
+      if (increment_dead && PENDING_NOTREADY == NodeStateForStruct(&counts)) {
+        counts.dead_count++;
+      }
+      counts.pending -= 1;
+      memcpy(&new_word, &counts, sizeof(T));
+    } while (!word->compare_exchange_weak(old_word, new_word,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_relaxed));
+    *dead_result = counts.dead_count;
+    *pending_result = counts.pending;
+  }
+
   // We keep track of the pending count and dead input count for each
   // graph node.  The representation used here is designed to be cache
   // efficient for graphs with large numbers of nodes, where most
@@ -278,6 +326,8 @@ class PendingCounts {
     uint32 dead_count : 31;
     uint8 has_started : 1;
   };
+  static_assert(sizeof(LargeCounts) == sizeof(uint64),
+                "LargeCounts must be updatable as a single 64-bit word");
 
   template <typename T>
   NodeState NodeStateForStruct(T* c) const {
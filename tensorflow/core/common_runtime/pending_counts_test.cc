@@ -13,10 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 
 #include "tensorflow/core/common_runtime/pending_counts.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -166,4 +169,41 @@ TEST(PendingCounts, AdjustForActivation) {
   }
 }
 
+TEST(PendingCounts, AdjustForActivationAtomic) {
+  PendingCounts::Layout layout;
+  PendingCounts::Handle handles[2];
+  const int kInitialCounts[2] = {4, 16};
+  handles[0] = layout.CreateHandle(kInitialCounts[0], 0);
+  handles[1] = layout.CreateHandle(kInitialCounts[1], 0);
+  PendingCounts c(layout);
+  for (int id = 0; id < 2; id++) {
+    c.set_initial_count(handles[id], kInitialCounts[id]);
+  }
+
+  // Decrement both counts concurrently from several threads. Exactly one
+  // activation of each handle must observe a pending count of zero.
+  const int kThreads = 2;
+  std::atomic<int> num_ready[2] = {{0}, {0}};
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kThreads);
+    for (int t = 0; t < kThreads; ++t) {
+      pool.Schedule([&c, &handles, &kInitialCounts, &num_ready]() {
+        for (int id = 0; id < 2; id++) {
+          for (int i = 0; i < kInitialCounts[id] / kThreads; ++i) {
+            int pending, dead;
+            c.adjust_for_activation_atomic(handles[id], i % 2 == 0, &pending,
+                                           &dead);
+            if (pending == 0) num_ready[id]++;
+          }
+        }
+      });
+    }
+  }
+  for (int id = 0; id < 2; id++) {
+    EXPECT_EQ(c.pending(handles[id]), 0);
+    EXPECT_EQ(num_ready[id], 1);
+    EXPECT_EQ(c.dead_count(handles[id]), kInitialCounts[id] / 2);
+  }
+}
+
 }  // namespace tensorflow
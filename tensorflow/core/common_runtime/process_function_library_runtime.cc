@@ -21,6 +21,7 @@ limitations under the License.
 #include "absl/strings/str_join.h"
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
 #include "tensorflow/core/common_runtime/partitioning_utils.h"
 #include "tensorflow/core/common_runtime/placer.h"
@@ -605,110 +606,137 @@ Status ProcessFunctionLibraryRuntime::InstantiateMultiDevice(
           function_name, function_key, ret_node_names.size(),
           lib_def->ReachableDefinitions(*fdef), std::move(ret_types));
 
-  GraphOptimizationPassOptions optimization_options;
-  // TODO(iga): Thread other relevant options from SessionOptions.
-  SessionOptions session_options;
-  session_options.env = env_;
-  session_options.config = options.config_proto;
-  optimization_options.session_options = &session_options;
-  optimization_options.graph = &graph;
-  optimization_options.flib_def = &data->lib_def_;
-  optimization_options.device_set = &device_set;
-
-  DumpGraph("Before running PRE_PLACEMENT passes", graph.get());
-  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
-      OptimizationPassRegistry::PRE_PLACEMENT, optimization_options));
-
-  DumpGraph("Before calling Placer", graph.get());
-  // Make the FunctionLibraryRuntime's device the default device if
-  // nothing else is hard coded. This allows the same function definition
-  // to be specialized to different devices depending on the
-  // PartitionedCallOp's device.
-  Device* default_device = nullptr;
-  if (!options.target.empty()) {
-    FunctionLibraryRuntime* flr = GetFLR(options.target);
-    if (flr == nullptr) {
-      return errors::InvalidArgument(
-          "Cannot instantiate multi-device function with target device ",
-          options.target);
-    }
-    default_device = flr->device();
+  // Placement, optimization and partitioning are skipped if their result was
+  // persisted by an earlier process (see FunctionGraphCache). The key covers
+  // the library before optimization, so it is computed first.
+  FunctionGraphCache* graph_cache = options.graph_collector == nullptr
+                                        ? FunctionGraphCache::Global()
+                                        : nullptr;
+  string graph_cache_key;
+  if (graph_cache != nullptr) {
+    graph_cache_key = FunctionGraphCache::MakeKey(
+        function_name, attrs, options, data->lib_def_, device_set);
   }
+  std::unordered_map<string, std::unique_ptr<Graph>> subgraphs;
+  if (graph_cache != nullptr &&
+      graph_cache->Lookup(graph_cache_key, &data->lib_def_, &subgraphs)) {
+    VLOG(1) << "Loaded optimized partitions of \"" << function_name
+            << "\" from the function graph cache";
+  } else {
+    GraphOptimizationPassOptions optimization_options;
+    // TODO(iga): Thread other relevant options from SessionOptions.
+    SessionOptions session_options;
+    session_options.env = env_;
+    session_options.config = options.config_proto;
+    optimization_options.session_options = &session_options;
+    optimization_options.graph = &graph;
+    optimization_options.flib_def = &data->lib_def_;
+    optimization_options.device_set = &device_set;
+
+    DumpGraph("Before running PRE_PLACEMENT passes", graph.get());
+    TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
+        OptimizationPassRegistry::PRE_PLACEMENT, optimization_options));
+
+    DumpGraph("Before calling Placer", graph.get());
+    // Make the FunctionLibraryRuntime's device the default device if
+    // nothing else is hard coded. This allows the same function definition
+    // to be specialized to different devices depending on the
+    // PartitionedCallOp's device.
+    Device* default_device = nullptr;
+    if (!options.target.empty()) {
+      FunctionLibraryRuntime* flr = GetFLR(options.target);
+      if (flr == nullptr) {
+        return errors::InvalidArgument(
+            "Cannot instantiate multi-device function with target device ",
+            options.target);
+      }
+      default_device = flr->device();
+    }
 
-  // TODO(b/124993244): Smartly merge options in nested defuns, and raise
-  // exceptions/warnings in case where nested function call options are ignored.
-  Placer placer(graph.get(), function_name, optimization_options.flib_def,
-                &device_set, default_device,
-                options.config_proto.allow_soft_placement(),
-                options.config_proto.log_device_placement());
-  TF_RETURN_IF_ERROR(placer.Run());
-
-  DumpGraph("Before running POST_PLACEMENT passes", graph.get());
-  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
-      OptimizationPassRegistry::POST_PLACEMENT, optimization_options));
-
-  Device* cpu_device;
-  TF_RETURN_IF_ERROR(device_mgr_->LookupDevice("CPU:0", &cpu_device));
-
-  if (options.optimize_graph_fn) {
-    DumpGraph("Before running graph optimization fn", graph.get());
-    Status status = options.optimize_graph_fn(
-        std::move(ret_node_names), std::move(control_ret_node_names),
-        &data->lib_def_, device_set, cpu_device, &graph);
-    if (!status.ok()) {
-      LOG(WARNING) << "Ignoring multi-device function optimization failure: "
-                   << status.ToString();
+    // TODO(b/124993244): Smartly merge options in nested defuns, and raise
+    // exceptions/warnings in case where nested function call options are
+    // ignored.
+    Placer placer(graph.get(), function_name, optimization_options.flib_def,
+                  &device_set, default_device,
+                  options.config_proto.allow_soft_placement(),
+                  options.config_proto.log_device_placement());
+    TF_RETURN_IF_ERROR(placer.Run());
+
+    DumpGraph("Before running POST_PLACEMENT passes", graph.get());
+    TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
+        OptimizationPassRegistry::POST_PLACEMENT, optimization_options));
+
+    Device* cpu_device;
+    TF_RETURN_IF_ERROR(device_mgr_->LookupDevice("CPU:0", &cpu_device));
+
+    if (options.optimize_graph_fn) {
+      DumpGraph("Before running graph optimization fn", graph.get());
+      Status status = options.optimize_graph_fn(
+          std::move(ret_node_names), std::move(control_ret_node_names),
+          &data->lib_def_, device_set, cpu_device, &graph);
+      if (!status.ok()) {
+        LOG(WARNING) << "Ignoring multi-device function optimization failure: "
+                     << status.ToString();
+      }
+      DumpGraph("After optimization", graph.get());
     }
-    DumpGraph("After optimization", graph.get());
-  }
 
-  DumpGraph("Before running POST_REWRITE_FOR_EXEC passes", graph.get());
-  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
-      OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, optimization_options));
+    DumpGraph("Before running POST_REWRITE_FOR_EXEC passes", graph.get());
+    TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
+        OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, optimization_options));
 
-  if (options.graph_collector != nullptr) {
-    GraphDef def;
-    graph->ToGraphDef(&def);
-    *def.mutable_library() = lib_def->ReachableDefinitions(def).ToProto();
-    options.graph_collector->CollectOptimizedGraph(def);
-  }
+    if (options.graph_collector != nullptr) {
+      GraphDef def;
+      graph->ToGraphDef(&def);
+      *def.mutable_library() = lib_def->ReachableDefinitions(def).ToProto();
+      options.graph_collector->CollectOptimizedGraph(def);
+    }
 
-  std::unordered_map<string, std::unique_ptr<Graph>> subgraphs;
-  TF_RETURN_IF_ERROR(
-      PartitionFunctionGraph(device_set, std::move(graph), &subgraphs));
+    TF_RETURN_IF_ERROR(
+        PartitionFunctionGraph(device_set, std::move(graph), &subgraphs));
 
-  for (const auto& pair : subgraphs) {
-    DumpGraph(strings::StrCat("Before running POST_PARTITIONING passes (",
-                              pair.first, ")"),
-              pair.second.get());
-  }
-  optimization_options.graph = nullptr;
-  optimization_options.device_set = nullptr;
-  optimization_options.partition_graphs = &subgraphs;
-  // Normally POST_PARTITIONING passes are run by distributed workers.
-  // Distributed workers are currently not supported in this code path, so we
-  // run the passes here.
-  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
-      OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
-  for (const auto& pair : subgraphs) {
-    const auto* optimized_subgraph = pair.second.get();
-    DumpGraph(
-        strings::StrCat("After all optimization passes (", pair.first, ")"),
-        optimized_subgraph);
-    if (VLOG_IS_ON(1)) {
-      DumpGraphDefToFile(
-          strings::StrCat("pflr_after_all_optimization_passes_",
-                          reinterpret_cast<uintptr_t>(optimized_subgraph)),
-          optimized_subgraph->ToGraphDefDebug());
+    for (const auto& pair : subgraphs) {
+      DumpGraph(strings::StrCat("Before running POST_PARTITIONING passes (",
+                                pair.first, ")"),
+                pair.second.get());
     }
-  }
-
-  if (options.graph_collector != nullptr) {
+    optimization_options.graph = nullptr;
+    optimization_options.device_set = nullptr;
+    optimization_options.partition_graphs = &subgraphs;
+    // Normally POST_PARTITIONING passes are run by distributed workers.
+    // Distributed workers are currently not supported in this code path, so we
+    // run the passes here.
+    TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
+        OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
     for (const auto& pair : subgraphs) {
-      GraphDef def;
-      pair.second->ToGraphDef(&def);
-      *def.mutable_library() = lib_def->ReachableDefinitions(def).ToProto();
-      options.graph_collector->CollectPartitionedGraph(def);
+      const auto* optimized_subgraph = pair.second.get();
+      DumpGraph(
+          strings::StrCat("After all optimization passes (", pair.first, ")"),
+          optimized_subgraph);
+      if (VLOG_IS_ON(1)) {
+        DumpGraphDefToFile(
+            strings::StrCat("pflr_after_all_optimization_passes_",
+                            reinterpret_cast<uintptr_t>(optimized_subgraph)),
+            optimized_subgraph->ToGraphDefDebug());
+      }
+    }
+
+    if (options.graph_collector != nullptr) {
+      for (const auto& pair : subgraphs) {
+        GraphDef def;
+        pair.second->ToGraphDef(&def);
+        *def.mutable_library() = lib_def->ReachableDefinitions(def).ToProto();
+        options.graph_collector->CollectPartitionedGraph(def);
+      }
+    }
+
+    if (graph_cache != nullptr) {
+      Status s =
+          graph_cache->Insert(graph_cache_key, data->lib_def_, subgraphs);
+      if (!s.ok()) {
+        LOG(WARNING) << "Failed to cache optimized partitions of \""
+                     << function_name << "\": " << s;
+      }
     }
   }
 
@@ -17,6 +17,8 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
 #include "tensorflow/core/common_runtime/function_testlib.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/framework/function.h"
@@ -25,9 +27,11 @@ limitations under the License.
 #include "tensorflow/core/framework/resource_var.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/type_index.h"
+#include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/session_options.h"
@@ -898,5 +902,103 @@ TEST_F(ProcessFunctionLibraryRuntimeTest, MultiDevice_StateHandle) {
   }
 }
 
+TEST_F(ProcessFunctionLibraryRuntimeTest, FunctionGraphCache) {
+  Init({test::function::XTimesTwo()});
+  const string cpu0 = "/job:a/replica:0/task:0/device:CPU:0";
+  DeviceSet device_set;
+  device_set.AddDevice(device0_);
+  device_set.AddDevice(device1_);
+
+  FunctionLibraryRuntime::InstantiateOptions inst_opts =
+      MakeOptions("CPU:0", {"CPU:0"}, {"CPU:0"});
+  const string key = FunctionGraphCache::MakeKey(
+      "XTimesTwo", test::function::Attrs({{"T", DT_FLOAT}}), inst_opts,
+      *lib_def_, device_set);
+  EXPECT_EQ(key, FunctionGraphCache::MakeKey(
+                     "XTimesTwo", test::function::Attrs({{"T", DT_FLOAT}}),
+                     inst_opts, *lib_def_, device_set));
+  EXPECT_NE(key, FunctionGraphCache::MakeKey(
+                     "XTimesTwo", test::function::Attrs({{"T", DT_INT32}}),
+                     inst_opts, *lib_def_, device_set));
+  EXPECT_NE(key, FunctionGraphCache::MakeKey(
+                     "XTimesTwo", test::function::Attrs({{"T", DT_FLOAT}}),
+                     MakeOptions("CPU:0", {"CPU:1"}, {"CPU:0"}), *lib_def_,
+                     device_set));
+  // So are the environment variables that configure the optimizers.
+  setenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_WHITELIST_ADD", "Identity", 1);
+  const string env_key = FunctionGraphCache::MakeKey(
+      "XTimesTwo", test::function::Attrs({{"T", DT_FLOAT}}), inst_opts,
+      *lib_def_, device_set);
+  unsetenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_WHITELIST_ADD");
+  EXPECT_NE(key, env_key);
+
+  std::unordered_map<string, std::unique_ptr<Graph>> subgraphs;
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  GraphConstructorOptions opts;
+  opts.expect_device_spec = true;
+  opts.allow_internal_ops = true;
+  TF_ASSERT_OK(ConvertGraphDefToGraph(
+      opts,
+      test::function::GDef(
+          {test::function::NDef("x", "_Arg", {},
+                                {{"T", DT_FLOAT}, {"index", 0}}, cpu0),
+           test::function::NDef("y", "Identity", {"x"}, {{"T", DT_FLOAT}},
+                                cpu0),
+           test::function::NDef("z", "_Retval", {"y"},
+                                {{"T", DT_FLOAT}, {"index", 0}}, cpu0)}),
+      graph.get()));
+  subgraphs.emplace(cpu0, std::move(graph));
+
+  const string directory = io::JoinPath(testing::TmpDir(), "function_graphs");
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(directory));
+  FunctionGraphCache cache(Env::Default(), directory);
+  FunctionLibraryDefinition lib_def(OpRegistry::Global(), {});
+  std::unordered_map<string, std::unique_ptr<Graph>> loaded;
+  EXPECT_FALSE(cache.Lookup(key, &lib_def, &loaded));
+
+  TF_ASSERT_OK(cache.Insert(key, *lib_def_, subgraphs));
+  ASSERT_TRUE(cache.Lookup(key, &lib_def, &loaded));
+  ASSERT_EQ(1, loaded.size());
+  const Graph* loaded_graph = loaded[cpu0].get();
+  ASSERT_NE(nullptr, loaded_graph);
+  EXPECT_EQ(subgraphs[cpu0]->num_op_nodes(), loaded_graph->num_op_nodes());
+  for (const Node* node : loaded_graph->op_nodes()) {
+    EXPECT_EQ(cpu0, node->requested_device());
+  }
+  EXPECT_NE(nullptr, lib_def.Find("XTimesTwo"));
+
+  // A key that was never inserted misses.
+  loaded.clear();
+  EXPECT_FALSE(cache.Lookup(strings::StrCat(key, "x"), &lib_def, &loaded));
+  EXPECT_TRUE(loaded.empty());
+
+  // An entry whose partitions can't be converted misses, and doesn't add its
+  // functions to the library.
+  std::unique_ptr<Graph> call_graph(new Graph(*lib_def_));
+  TF_ASSERT_OK(ConvertGraphDefToGraph(
+      opts,
+      test::function::GDef(
+          {test::function::NDef("x", "_Arg", {},
+                                {{"T", DT_FLOAT}, {"index", 0}}, cpu0),
+           test::function::NDef("y", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}},
+                                cpu0),
+           test::function::NDef("z", "_Retval", {"y"},
+                                {{"T", DT_FLOAT}, {"index", 0}}, cpu0)}),
+      call_graph.get()));
+  subgraphs.clear();
+  subgraphs.emplace(cpu0, std::move(call_graph));
+  const string other_key = strings::StrCat(key, "y");
+  // The library of the entry lacks XTimesTwo.
+  FunctionDefLibrary other_library;
+  *other_library.add_function() = test::function::XTimesFour();
+  TF_ASSERT_OK(cache.Insert(
+      other_key, FunctionLibraryDefinition(OpRegistry::Global(), other_library),
+      subgraphs));
+  FunctionLibraryDefinition other_lib_def(OpRegistry::Global(), {});
+  EXPECT_FALSE(cache.Lookup(other_key, &other_lib_def, &loaded));
+  EXPECT_TRUE(loaded.empty());
+  EXPECT_EQ(nullptr, other_lib_def.Find("XTimesFour"));
+}
+
 }  // anonymous namespace
 }  // namespace tensorflow
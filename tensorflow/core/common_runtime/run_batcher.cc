@@ -0,0 +1,239 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/run_batcher.h"
+
+#include <chrono>  // NOLINT(build/c++11)
+
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Sets `*key` to a string that is equal for runs that can be batched with
+// each other, and returns true, or returns false if the run cannot be
+// batched.
+bool BatchingKey(const RunBatcher::NamedTensorList& inputs,
+                 const std::vector<string>& output_names,
+                 const string& run_key, string* key) {
+  if (inputs.empty()) return false;
+  const int64 batch_size =
+      inputs[0].second.dims() > 0 ? inputs[0].second.dim_size(0) : -1;
+  key->clear();
+  for (const auto& it : inputs) {
+    const Tensor& t = it.second;
+    if (t.dims() == 0 || t.dim_size(0) != batch_size ||
+        t.dtype() == DT_RESOURCE || t.dtype() == DT_VARIANT) {
+      return false;
+    }
+    strings::StrAppend(key, "feed:", it.first, ":", DataTypeString(t.dtype()));
+    for (int d = 1; d < t.dims(); ++d) {
+      strings::StrAppend(key, ",", t.dim_size(d));
+    }
+    strings::StrAppend(key, "\n");
+  }
+  for (const string& name : output_names) {
+    strings::StrAppend(key, "fetch:", name, "\n");
+  }
+  strings::StrAppend(key, "run:", run_key);
+  return true;
+}
+
+}  // namespace
+
+struct RunBatcher::Request {
+  const NamedTensorList* inputs;
+  const std::vector<string>* output_names;
+  std::vector<Tensor>* outputs;  // May be nullptr.
+  Status status;
+  Notification done;
+};
+
+struct RunBatcher::Batch {
+  std::vector<Request*> requests;
+  // Set, and `closed_cv` notified, once the batch stops accepting requests.
+  bool closed = false;
+  condition_variable closed_cv;
+};
+
+RunBatcher::RunBatcher(Env* env, int64 timeout_micros, int max_batch_size)
+    : env_(env),
+      timeout_micros_(timeout_micros),
+      max_batch_size_(max_batch_size) {
+  DCHECK_GT(max_batch_size_, 0);
+}
+
+Status RunBatcher::Run(const NamedTensorList& inputs,
+                       const std::vector<string>& output_names,
+                       const string& run_key, std::vector<Tensor>* outputs,
+                       const RunFn& run_fn) {
+  string key;
+  if (!BatchingKey(inputs, output_names, run_key, &key)) {
+    return run_fn(inputs, outputs);
+  }
+
+  // The first call with a batching key runs on its own, to check whether
+  // its fetches can be split into the results of batched calls.
+  bool is_known = false;
+  bool is_batchable = false;
+  {
+    mutex_lock l(mu_);
+    auto it = splittable_keys_.find(key);
+    if (it != splittable_keys_.end()) {
+      is_known = true;
+      is_batchable = it->second;
+    }
+  }
+  if (!is_batchable) {
+    Status s = run_fn(inputs, outputs);
+    if (!is_known && s.ok() && outputs != nullptr) {
+      const int64 rows = inputs[0].second.dim_size(0);
+      bool splittable = true;
+      for (const Tensor& output : *outputs) {
+        if (output.dims() == 0 || output.dim_size(0) != rows) {
+          splittable = false;
+          break;
+        }
+      }
+      if (!splittable) {
+        VLOG(1) << "Not batching the steps with batching key " << key
+                << ", since their fetches cannot be split";
+      }
+      mutex_lock l(mu_);
+      splittable_keys_.emplace(key, splittable);
+    }
+    return s;
+  }
+
+  Request request;
+  request.inputs = &inputs;
+  request.output_names = &output_names;
+  request.outputs = outputs;
+
+  std::shared_ptr<Batch> batch;
+  bool is_first = false;
+  {
+    mutex_lock l(mu_);
+    std::shared_ptr<Batch>& open_batch = open_batches_[key];
+    if (open_batch == nullptr) {
+      open_batch = std::make_shared<Batch>();
+      is_first = true;
+    }
+    batch = open_batch;
+    batch->requests.push_back(&request);
+    if (batch->requests.size() >= max_batch_size_) {
+      batch->closed = true;
+      batch->closed_cv.notify_all();
+      open_batches_.erase(key);
+    }
+    if (is_first) {
+      const uint64 deadline = env_->NowMicros() + timeout_micros_;
+      while (!batch->closed) {
+        const uint64 now = env_->NowMicros();
+        if (now >= deadline) {
+          batch->closed = true;
+          open_batches_.erase(key);
+          break;
+        }
+        batch->closed_cv.wait_for(l, std::chrono::microseconds(deadline - now));
+      }
+    }
+  }
+
+  if (!is_first) {
+    request.done.WaitForNotification();
+    return request.status;
+  }
+  // The batch is closed, so its requests no longer change.
+  bool unsplittable = false;
+  const Status s = RunBatch(*batch, run_fn, &unsplittable);
+  if (unsplittable) {
+    mutex_lock l(mu_);
+    splittable_keys_[key] = false;
+  }
+  for (Request* r : batch->requests) {
+    if (r == &request) continue;
+    r->status = s;
+    r->done.Notify();
+  }
+  return s;
+}
+
+Status RunBatcher::RunBatch(const Batch& batch, const RunFn& run_fn,
+                            bool* unsplittable) {
+  const std::vector<Request*>& requests = batch.requests;
+  if (requests.size() == 1) {
+    return run_fn(*requests[0]->inputs, requests[0]->outputs);
+  }
+  VLOG(2) << "Running a batch of " << requests.size() << " steps";
+
+  std::vector<int64> sizes;
+  sizes.reserve(requests.size());
+  int64 total_size = 0;
+  for (const Request* r : requests) {
+    sizes.push_back(r->inputs->front().second.dim_size(0));
+    total_size += sizes.back();
+  }
+
+  const NamedTensorList& first_inputs = *requests[0]->inputs;
+  NamedTensorList inputs(first_inputs.size());
+  std::vector<Tensor> parts(requests.size());
+  for (int i = 0; i < first_inputs.size(); ++i) {
+    for (int j = 0; j < requests.size(); ++j) {
+      parts[j] = (*requests[j]->inputs)[i].second;
+    }
+    inputs[i].first = first_inputs[i].first;
+    TF_RETURN_IF_ERROR(tensor::Concat(parts, &inputs[i].second));
+  }
+
+  std::vector<Tensor> outputs;
+  TF_RETURN_IF_ERROR(run_fn(inputs, &outputs));
+
+  const std::vector<string>& output_names = *requests[0]->output_names;
+  for (int i = 0; i < outputs.size(); ++i) {
+    const Tensor& output = outputs[i];
+    if (output.dims() == 0 || output.dim_size(0) != total_size) {
+      *unsplittable = true;
+      return errors::FailedPrecondition(
+          "Fetch ", output_names[i], " of shape ",
+          output.shape().DebugString(), " cannot be split into the results of ",
+          requests.size(), " batched Run() calls, which fed ", total_size,
+          " rows in total. Disable run batching for this graph.");
+    }
+  }
+  for (Request* r : requests) {
+    if (r->outputs == nullptr) continue;
+    r->outputs->clear();
+    r->outputs->reserve(outputs.size());
+  }
+  for (int i = 0; i < outputs.size(); ++i) {
+    const Tensor& output = outputs[i];
+    std::vector<Tensor> split;
+    TF_RETURN_IF_ERROR(tensor::Split(output, sizes, &split));
+    for (int j = 0; j < requests.size(); ++j) {
+      if (requests[j]->outputs == nullptr) continue;
+      requests[j]->outputs->push_back(std::move(split[j]));
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,103 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_RUN_BATCHER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_RUN_BATCHER_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Coalesces concurrent runs of the same step into one.
+//
+// Run() calls with the same feed names, fetch names and run key, whose feeds
+// have the same types and the same shapes apart from dimension 0, form a
+// batch. The first call of a batch waits until `max_batch_size` calls have
+// joined it or `timeout_micros` have passed. It then concatenates the feeds
+// of all calls along dimension 0, runs the step once for all of them, and
+// splits each fetched tensor along dimension 0 into the results of each call.
+//
+// This is only correct for steps that compute each row of their fetches from
+// the same row of their feeds, e.g. inference on a batch of examples, and
+// that don't modify any state. The feeds and fetches must be in host memory.
+// The first call with a batching key runs on its own: the later calls are
+// only batched if each of its fetches had as many rows as its feeds (e.g.
+// not a scalar loss). A step is never run more than once for a call, so if a
+// fetch of a batched step still cannot be split, all calls of the batch fail
+// and the later calls with the same batching key are not batched.
+class RunBatcher {
+ public:
+  typedef std::vector<std::pair<string, Tensor>> NamedTensorList;
+
+  // Runs the step for `inputs`, storing the fetched tensors in `*outputs`.
+  typedef std::function<Status(const NamedTensorList& inputs,
+                               std::vector<Tensor>* outputs)>
+      RunFn;
+
+  RunBatcher(Env* env, int64 timeout_micros, int max_batch_size);
+
+  // Runs the step that fetches `output_names` with `inputs`, possibly batched
+  // with concurrent calls. `run_key` identifies the other arguments of the
+  // step (e.g. its RunOptions): only calls with equal keys are batched. The
+  // batch is run by the `run_fn` of its first call, and a failure of that run
+  // is returned by all calls in the batch.
+  //
+  // Calls whose feeds cannot be batched, e.g. because they are scalars or
+  // because their dimension 0 sizes differ, run `run_fn` immediately, as do
+  // the calls with a batching key whose fetches are not known to be
+  // splittable.
+  Status Run(const NamedTensorList& inputs,
+             const std::vector<string>& output_names, const string& run_key,
+             std::vector<Tensor>* outputs, const RunFn& run_fn);
+
+ private:
+  struct Request;
+  struct Batch;
+
+  // Runs the requests of `batch` as a single step with `run_fn`. Sets
+  // `*unsplittable` to true and returns an error if a fetched tensor cannot
+  // be split into the outputs of the requests.
+  Status RunBatch(const Batch& batch, const RunFn& run_fn, bool* unsplittable);
+
+  Env* const env_;
+  const int64 timeout_micros_;
+  const int max_batch_size_;
+
+  mutex mu_;
+  // The batches that are still accepting requests, by batching key.
+  std::unordered_map<string, std::shared_ptr<Batch>> open_batches_
+      GUARDED_BY(mu_);
+  // Whether the fetches of the steps with a batching key can be split, for
+  // the keys whose first call has run.
+  std::unordered_map<string, bool> splittable_keys_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RunBatcher);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_RUN_BATCHER_H_
@@ -0,0 +1,242 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/run_batcher.h"
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// A step that fetches its feed "x" and counts how often it runs.
+class IdentityStep {
+ public:
+  RunBatcher::RunFn run_fn() {
+    return [this](const RunBatcher::NamedTensorList& inputs,
+                  std::vector<Tensor>* outputs) {
+      ++num_runs_;
+      outputs->clear();
+      outputs->push_back(inputs[0].second);
+      return Status::OK();
+    };
+  }
+
+  int num_runs() const { return num_runs_; }
+
+ private:
+  std::atomic<int> num_runs_{0};
+};
+
+// Returns a [rows, 2] tensor filled with `value`.
+Tensor Rows(int rows, float value) {
+  Tensor t(DT_FLOAT, TensorShape({rows, 2}));
+  t.flat<float>().setConstant(value);
+  return t;
+}
+
+TEST(RunBatcherTest, BatchesConcurrentCalls) {
+  constexpr int kNumCalls = 4;
+  // The batch fills up long before the timeout.
+  RunBatcher batcher(Env::Default(), 60 * 1000 * 1000, kNumCalls);
+  IdentityStep step;
+  // The first call runs on its own, and shows that the fetches can be split.
+  std::vector<Tensor> first_outputs;
+  TF_ASSERT_OK(batcher.Run({{"x", Rows(1, 0)}}, {"x"}, {}, &first_outputs,
+                           step.run_fn()));
+  EXPECT_EQ(1, step.num_runs());
+
+  std::vector<Status> statuses(kNumCalls);
+  std::vector<std::vector<Tensor>> outputs(kNumCalls);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumCalls);
+    for (int i = 0; i < kNumCalls; ++i) {
+      pool.Schedule([&, i]() {
+        statuses[i] = batcher.Run({{"x", Rows(i + 1, i)}}, {"x"}, {},
+                                  &outputs[i], step.run_fn());
+      });
+    }
+  }
+  EXPECT_EQ(2, step.num_runs());
+  for (int i = 0; i < kNumCalls; ++i) {
+    TF_EXPECT_OK(statuses[i]);
+    ASSERT_EQ(1, outputs[i].size());
+    test::ExpectTensorEqual<float>(Rows(i + 1, i), outputs[i][0]);
+  }
+}
+
+TEST(RunBatcherTest, RunsSingleCallAfterTimeout) {
+  RunBatcher batcher(Env::Default(), 1000, 32);
+  IdentityStep step;
+  std::vector<Tensor> outputs;
+  TF_EXPECT_OK(
+      batcher.Run({{"x", Rows(1, 0)}}, {"x"}, {}, &outputs, step.run_fn()));
+  TF_EXPECT_OK(
+      batcher.Run({{"x", Rows(3, 1)}}, {"x"}, {}, &outputs, step.run_fn()));
+  EXPECT_EQ(2, step.num_runs());
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(Rows(3, 1), outputs[0]);
+}
+
+TEST(RunBatcherTest, RunsUnbatchableCallsImmediately) {
+  // If the call waited for the timeout, the test would time out.
+  RunBatcher batcher(Env::Default(), 60 * 60 * 1000 * 1000LL, 32);
+  IdentityStep step;
+  std::vector<Tensor> outputs;
+  TF_EXPECT_OK(batcher.Run({{"x", test::AsScalar<float>(1)}}, {"x"}, {},
+                           &outputs, step.run_fn()));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(1), outputs[0]);
+
+  // Feeds with different numbers of rows.
+  TF_EXPECT_OK(batcher.Run({{"x", Rows(1, 1)}, {"y", Rows(2, 1)}}, {"x"}, {},
+                           &outputs, step.run_fn()));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(Rows(1, 1), outputs[0]);
+  EXPECT_EQ(2, step.num_runs());
+}
+
+TEST(RunBatcherTest, RunsCallsAloneIfFetchCannotBeSplit) {
+  constexpr int kNumCalls = 2;
+  // If a call waited for the timeout, the test would time out.
+  RunBatcher batcher(Env::Default(), 60 * 60 * 1000 * 1000LL, kNumCalls);
+  std::atomic<int> num_runs{0};
+  // Fetches the sum of the feed, which is a scalar.
+  auto run_fn = [&num_runs](const RunBatcher::NamedTensorList& inputs,
+                            std::vector<Tensor>* outputs) {
+    ++num_runs;
+    const auto x = inputs[0].second.flat<float>();
+    float sum = 0;
+    for (int i = 0; i < x.size(); ++i) sum += x(i);
+    outputs->assign({test::AsScalar<float>(sum)});
+    return Status::OK();
+  };
+  std::vector<Tensor> first_outputs;
+  TF_ASSERT_OK(
+      batcher.Run({{"x", Rows(1, 5)}}, {"sum"}, {}, &first_outputs, run_fn));
+  ASSERT_EQ(1, first_outputs.size());
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(10), first_outputs[0]);
+
+  // Since the first fetch was a scalar, the later calls are not batched.
+  std::vector<Status> statuses(kNumCalls);
+  std::vector<std::vector<Tensor>> outputs(kNumCalls);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumCalls);
+    for (int i = 0; i < kNumCalls; ++i) {
+      pool.Schedule([&, i]() {
+        statuses[i] = batcher.Run({{"x", Rows(1, i + 1)}}, {"sum"}, {},
+                                  &outputs[i], run_fn);
+      });
+    }
+  }
+  // Each call ran exactly once.
+  EXPECT_EQ(1 + kNumCalls, num_runs);
+  for (int i = 0; i < kNumCalls; ++i) {
+    TF_EXPECT_OK(statuses[i]);
+    ASSERT_EQ(1, outputs[i].size());
+    test::ExpectTensorEqual<float>(test::AsScalar<float>(2 * (i + 1)),
+                                   outputs[i][0]);
+  }
+}
+
+TEST(RunBatcherTest, FailsBatchIfFetchCannotBeSplit) {
+  constexpr int kNumCalls = 2;
+  RunBatcher batcher(Env::Default(), 60 * 60 * 1000 * 1000LL, kNumCalls);
+  std::atomic<int> num_runs{0};
+  // Fetches the first row of the feed, which only splits for a single call.
+  auto run_fn = [&num_runs](const RunBatcher::NamedTensorList& inputs,
+                            std::vector<Tensor>* outputs) {
+    ++num_runs;
+    outputs->assign({inputs[0].second.Slice(0, 1)});
+    return Status::OK();
+  };
+  std::vector<Tensor> first_outputs;
+  TF_ASSERT_OK(
+      batcher.Run({{"x", Rows(1, 0)}}, {"x"}, {}, &first_outputs, run_fn));
+
+  std::vector<Status> statuses(kNumCalls);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumCalls);
+    for (int i = 0; i < kNumCalls; ++i) {
+      pool.Schedule([&, i]() {
+        std::vector<Tensor> unused;
+        statuses[i] =
+            batcher.Run({{"x", Rows(1, i)}}, {"x"}, {}, &unused, run_fn);
+      });
+    }
+  }
+  // The batched step is not run again for each call.
+  EXPECT_EQ(2, num_runs);
+  for (int i = 0; i < kNumCalls; ++i) {
+    EXPECT_TRUE(errors::IsFailedPrecondition(statuses[i])) << statuses[i];
+  }
+
+  // Similar calls are no longer batched.
+  std::vector<Tensor> last_outputs;
+  TF_EXPECT_OK(
+      batcher.Run({{"x", Rows(1, 5)}}, {"x"}, {}, &last_outputs, run_fn));
+  EXPECT_EQ(3, num_runs);
+  ASSERT_EQ(1, last_outputs.size());
+  test::ExpectTensorEqual<float>(Rows(1, 5), last_outputs[0]);
+}
+
+TEST(RunBatcherTest, BatchesOnlyCallsWithTheSameRunKey) {
+  // If the calls waited for each other, the test would time out.
+  RunBatcher batcher(Env::Default(), 60 * 60 * 1000 * 1000LL, 2);
+  IdentityStep step;
+  for (const string& run_key : {"options", "other options"}) {
+    std::vector<Tensor> unused;
+    TF_ASSERT_OK(batcher.Run({{"x", Rows(1, 0)}}, {"x"}, run_key, &unused,
+                             step.run_fn()));
+  }
+
+  std::vector<Status> statuses(2);
+  std::vector<std::vector<Tensor>> outputs(2);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 4);
+    for (int i = 0; i < 2; ++i) {
+      pool.Schedule([&, i]() {
+        statuses[i] = batcher.Run({{"x", Rows(1, i)}}, {"x"},
+                                  i == 0 ? "options" : "other options",
+                                  &outputs[i], step.run_fn());
+      });
+    }
+    // The calls only return if they are batched with a third one with the
+    // same key.
+    for (int i = 0; i < 2; ++i) {
+      pool.Schedule([&, i]() {
+        std::vector<Tensor> unused;
+        TF_EXPECT_OK(batcher.Run({{"x", Rows(1, i)}}, {"x"},
+                                 i == 0 ? "options" : "other options", &unused,
+                                 step.run_fn()));
+      });
+    }
+  }
+  EXPECT_EQ(4, step.num_runs());
+  for (int i = 0; i < 2; ++i) {
+    TF_EXPECT_OK(statuses[i]);
+    ASSERT_EQ(1, outputs[i].size());
+    test::ExpectTensorEqual<float>(Rows(1, i), outputs[i][0]);
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/common_runtime/shape_refiner.h"
 
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <unordered_set>
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
@@ -31,6 +33,9 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/public/session.h"
 
 namespace tensorflow {
@@ -282,11 +287,23 @@ Status ShapeRefiner::AddNode(const Node* node) {
     }
   }
 
+  const string cache_key = ShapeInferenceCacheKey(node, c.get());
+
   std::unique_ptr<ExtendedInferenceContext> ec(
       new ExtendedInferenceContext(std::move(c), node));
 
-  // Run the shape inference function, and return if there was an error.
-  TF_RETURN_IF_ERROR(RunShapeFn(node, op_reg_data, ec.get()));
+  bool found_cached_shapes = false;
+  if (!cache_key.empty()) {
+    TF_RETURN_IF_ERROR(SetCachedOutputShapes(cache_key, ec->get_context(),
+                                             &found_cached_shapes));
+  }
+  if (!found_cached_shapes) {
+    // Run the shape inference function, and return if there was an error.
+    TF_RETURN_IF_ERROR(RunShapeFn(node, op_reg_data, ec.get()));
+    if (!cache_key.empty()) {
+      CacheOutputShapes(cache_key, ec->get_context());
+    }
+  }
 
   // Store the resulting context object in the map.
   node_to_context_[node].swap(ec);
@@ -756,6 +773,108 @@ Status ShapeRefiner::RunShapeFn(const Node* node,
   return Status::OK();
 }
 
+string ShapeRefiner::ShapeInferenceCacheKey(const Node* node,
+                                            InferenceContext* c) const {
+  if (disable_shape_inference_cache_) return "";
+  // Nodes without inputs are cheap to infer, and may have large attributes
+  // (e.g. the value of a Const) that would be expensive to fingerprint.
+  if (c->num_inputs() == 0) return "";
+  // The shapes of function calls depend on the function body.
+  if (function_library_ && IsFunctionCall(*function_library_, *node)) {
+    return "";
+  }
+
+  string key = strings::StrCat(node->type_string(), ";", graph_def_version_);
+  // The inputs come first, since nodes with unknown input shapes are not
+  // cached, and are cheaper to check than the attributes.
+  for (int i = 0; i < c->num_inputs(); ++i) {
+    if (!c->FullyDefined(c->input(i))) return "";
+    strings::StrAppend(&key, ";", c->DebugString(c->input(i)));
+    const auto* handle_data = c->input_handle_shapes_and_types(i);
+    if (handle_data == nullptr) continue;
+    strings::StrAppend(&key, "{");
+    for (const ShapeAndType& shape_and_type : *handle_data) {
+      if (!c->FullyDefined(shape_and_type.shape)) return "";
+      strings::StrAppend(&key, DataTypeString(shape_and_type.dtype),
+                         c->DebugString(shape_and_type.shape), ",");
+    }
+    strings::StrAppend(&key, "}");
+  }
+
+  std::vector<std::pair<string, const AttrValue*>> attrs;
+  for (const auto& attr : node->attrs()) {
+    // Colocation constraints do not affect shapes, and differ between
+    // otherwise identical nodes.
+    if (attr.first == kColocationAttrName) continue;
+    attrs.emplace_back(attr.first, &attr.second);
+  }
+  std::sort(attrs.begin(), attrs.end());
+  for (const auto& attr : attrs) {
+    // Fingerprinted, so that large attributes don't make every lookup compare
+    // and hash long keys.
+    string serialized;
+    if (!SerializeToStringDeterministic(*attr.second, &serialized)) return "";
+    const Fprint128 fp = Fingerprint128(serialized);
+    strings::StrAppend(&key, ";", attr.first, "=", fp.low64, ".", fp.high64);
+  }
+  return key;
+}
+
+void ShapeRefiner::CacheOutputShapes(const string& key, InferenceContext* c) {
+  // The outputs may depend on the values of the requested input tensors,
+  // which are not part of the key.
+  for (int i = 0; i < c->num_inputs(); ++i) {
+    if (c->requested_input_tensor(i) ||
+        c->requested_input_tensor_as_partial_shape(i)) {
+      return;
+    }
+  }
+  // Unknown dimensions may be shared between the outputs and the inputs, or
+  // between outputs, which a TensorShapeProto can not represent.
+  std::vector<CachedOutputShape> outputs(c->num_outputs());
+  for (int i = 0; i < c->num_outputs(); ++i) {
+    if (!c->FullyDefined(c->output(i))) return;
+    c->ShapeHandleToProto(c->output(i), &outputs[i].shape);
+    const auto* handle_data = c->output_handle_shapes_and_types(i);
+    if (handle_data == nullptr) continue;
+    outputs[i].has_handle_data = true;
+    for (const ShapeAndType& shape_and_type : *handle_data) {
+      if (!c->FullyDefined(shape_and_type.shape)) return;
+      TensorShapeProto proto;
+      c->ShapeHandleToProto(shape_and_type.shape, &proto);
+      outputs[i].handle_shapes_and_types.emplace_back(std::move(proto),
+                                                      shape_and_type.dtype);
+    }
+  }
+  shape_inference_cache_.emplace(key, std::move(outputs));
+}
+
+Status ShapeRefiner::SetCachedOutputShapes(const string& key,
+                                           InferenceContext* c,
+                                           bool* found) const {
+  *found = false;
+  auto it = shape_inference_cache_.find(key);
+  if (it == shape_inference_cache_.end()) return Status::OK();
+  const std::vector<CachedOutputShape>& outputs = it->second;
+  if (outputs.size() != c->num_outputs()) return Status::OK();
+
+  for (int i = 0; i < outputs.size(); ++i) {
+    ShapeHandle shape;
+    TF_RETURN_IF_ERROR(c->MakeShapeFromShapeProto(outputs[i].shape, &shape));
+    c->set_output(i, shape);
+    if (!outputs[i].has_handle_data) continue;
+    std::vector<ShapeAndType> handle_data;
+    for (const auto& shape_and_type : outputs[i].handle_shapes_and_types) {
+      TF_RETURN_IF_ERROR(
+          c->MakeShapeFromShapeProto(shape_and_type.first, &shape));
+      handle_data.emplace_back(shape, shape_and_type.second);
+    }
+    c->set_output_handle_shapes_and_types(i, handle_data);
+  }
+  *found = true;
+  return Status::OK();
+}
+
 bool ShapeRefiner::SameDefinedShape(InferenceContext* c, ShapeHandle s0,
                                     ShapeHandle s1) {
   if (s0.SameHandle(s1)) {
@@ -15,10 +15,12 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SHAPE_REFINER_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_SHAPE_REFINER_H_
 
+#include <unordered_map>
 #include <vector>
 
 #include "tensorflow/core/common_runtime/graph_runner.h"
 #include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -154,6 +156,14 @@ class ShapeRefiner {
     disable_constant_propagation_ = disable;
   }
 
+  // By default, when nodes with the same op and attributes have the same
+  // fully defined input shapes, the shape function only runs for the first
+  // one, and the others reuse its output shapes. Call this to always run the
+  // shape function.
+  void set_disable_shape_inference_cache(bool disable) {
+    disable_shape_inference_cache_ = disable;
+  }
+
   // Set function library to enable function shape inference.
   // Without function library, function inference always yields unknown shapes.
   // With this enabled, shape inference can take more time since it descends
@@ -260,6 +270,24 @@ class ShapeRefiner {
   Status RunShapeFn(const Node* node, const OpRegistrationData* op_reg_data,
                     ExtendedInferenceContext* ec);
 
+  // Returns the key under which the output shapes of 'node' with the input
+  // shapes in 'c' are cached, or an empty string if they may not be cached,
+  // e.g. because some input shape is not fully defined.
+  string ShapeInferenceCacheKey(const Node* node,
+                                shape_inference::InferenceContext* c) const;
+
+  // Stores the output shapes in 'c' under 'key', unless the shape function
+  // depended on more than the input shapes or left an output shape not fully
+  // defined.
+  void CacheOutputShapes(const string& key,
+                         shape_inference::InferenceContext* c);
+
+  // Sets the outputs of 'c' to the shapes cached under 'key', if there are
+  // any, and sets '*found' accordingly.
+  Status SetCachedOutputShapes(const string& key,
+                               shape_inference::InferenceContext* c,
+                               bool* found) const;
+
   int32 graph_def_version_;
   const OpRegistryInterface* const ops_registry_;
 
@@ -284,6 +312,18 @@ class ShapeRefiner {
 
   bool require_shape_inference_fns_ = true;
   bool disable_constant_propagation_ = false;
+  bool disable_shape_inference_cache_ = false;
+
+  // The fully defined shape of an output, and of the data its resource or
+  // variant handle refers to, as reused across nodes with the same op,
+  // attributes and input shapes.
+  struct CachedOutputShape {
+    TensorShapeProto shape;
+    bool has_handle_data = false;
+    std::vector<std::pair<TensorShapeProto, DataType>> handle_shapes_and_types;
+  };
+  std::unordered_map<string, std::vector<CachedOutputShape>>
+      shape_inference_cache_;
 
   // Function library is optional, but has to be set to enable function
   // shape inference.
@@ -219,6 +219,100 @@ TEST_F(ShapeRefinerTest, MissingShapeInferenceFns) {
   TF_EXPECT_OK(m.AddNode(b));
 }
 
+namespace {
+
+int num_counted_shape_fn_calls = 0;
+
+// An op whose shape function counts how often it runs.
+REGISTER_OP("TestOpWithCountedShapeFn")
+    .Input("a: float")
+    .Output("o: float")
+    .Attr("scale: int")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      ++num_counted_shape_fn_calls;
+      c->set_output(0, c->input(0));
+      return Status::OK();
+    });
+
+// Adds a TestOpWithCountedShapeFn node with input 'a' to 'graph'.
+Node* CountedShapeFnNode(Graph* graph, Node* a, int scale) {
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(graph->NewName("counted"), "TestOpWithCountedShapeFn")
+                  .Input(a)
+                  .Attr("scale", scale)
+                  .Finalize(graph, &node));
+  return node;
+}
+
+}  // namespace
+
+TEST_F(ShapeRefinerTest, ReusesShapesOfIdenticalNodes) {
+  Scope root = Scope::NewRootScope();
+  auto a = ops::Const(root, {{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}});
+  auto b = ops::Const(root, {{6.0f, 5.0f, 4.0f}, {3.0f, 2.0f, 1.0f}});
+  auto c = ops::Const(root, {1.0f, 2.0f, 3.0f, 4.0f});
+  Graph* graph = root.graph();
+  Node* a1 = CountedShapeFnNode(graph, a.node(), 1);
+  Node* b1 = CountedShapeFnNode(graph, b.node(), 1);
+  Node* c1 = CountedShapeFnNode(graph, c.node(), 1);
+  Node* a2 = CountedShapeFnNode(graph, a.node(), 2);
+
+  ShapeRefiner m(TF_GRAPH_DEF_VERSION, OpRegistry::Global());
+  TF_ASSERT_OK(m.AddNode(a.node()));
+  TF_ASSERT_OK(m.AddNode(b.node()));
+  TF_ASSERT_OK(m.AddNode(c.node()));
+  num_counted_shape_fn_calls = 0;
+  TF_ASSERT_OK(m.AddNode(a1));
+  EXPECT_EQ(1, num_counted_shape_fn_calls);
+  // Same attributes and input shapes.
+  TF_ASSERT_OK(m.AddNode(b1));
+  EXPECT_EQ(1, num_counted_shape_fn_calls);
+  // Other input shape.
+  TF_ASSERT_OK(m.AddNode(c1));
+  EXPECT_EQ(2, num_counted_shape_fn_calls);
+  // Other attributes.
+  TF_ASSERT_OK(m.AddNode(a2));
+  EXPECT_EQ(3, num_counted_shape_fn_calls);
+
+  auto output_shape = [&m](Node* node) {
+    shape_inference::InferenceContext* ctx = m.GetContext(node);
+    return ctx->DebugString(ctx->output(0));
+  };
+  EXPECT_EQ("[2,3]", output_shape(a1));
+  EXPECT_EQ("[2,3]", output_shape(b1));
+  EXPECT_EQ("[4]", output_shape(c1));
+  EXPECT_EQ("[2,3]", output_shape(a2));
+
+  ShapeRefiner m2(TF_GRAPH_DEF_VERSION, OpRegistry::Global());
+  m2.set_disable_shape_inference_cache(true);
+  TF_ASSERT_OK(m2.AddNode(a.node()));
+  TF_ASSERT_OK(m2.AddNode(b.node()));
+  num_counted_shape_fn_calls = 0;
+  TF_ASSERT_OK(m2.AddNode(a1));
+  TF_ASSERT_OK(m2.AddNode(b1));
+  EXPECT_EQ(2, num_counted_shape_fn_calls);
+}
+
+TEST_F(ShapeRefinerTest, DoesNotReuseShapesOfPartiallyKnownInputs) {
+  Scope root = Scope::NewRootScope();
+  auto a = ops::Placeholder(root, DT_FLOAT,
+                            ops::Placeholder::Shape(PartialTensorShape({-1})));
+  Graph* graph = root.graph();
+  Node* a1 = CountedShapeFnNode(graph, a.node(), 1);
+  Node* a2 = CountedShapeFnNode(graph, a.node(), 1);
+
+  ShapeRefiner m(TF_GRAPH_DEF_VERSION, OpRegistry::Global());
+  TF_ASSERT_OK(m.AddNode(a.node()));
+  num_counted_shape_fn_calls = 0;
+  TF_ASSERT_OK(m.AddNode(a1));
+  TF_ASSERT_OK(m.AddNode(a2));
+  EXPECT_EQ(2, num_counted_shape_fn_calls);
+  // The outputs still share the unknown dimension of the input.
+  shape_inference::InferenceContext* ctx = m.GetContext(a2);
+  EXPECT_TRUE(SameHandle(ctx->Dim(ctx->output(0), 0),
+                         ctx->Dim(m.GetContext(a.node())->output(0), 0)));
+}
+
 TEST_F(ShapeRefinerTest, PropagateConstants) {
   // Reduction dimension is a variable, so we don't know its value.
   // So the output shape value is unknown (though its rank is known).
@@ -15,8 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/framework/rendezvous.h"
 
-#include <deque>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -27,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
@@ -150,20 +152,26 @@ class LocalRendezvousImpl : public Rendezvous {
  public:
   explicit LocalRendezvousImpl() {}
 
+  // `new` only aligns the shards to cache lines since C++17.
+  static void* operator new(size_t size) {
+    return port::AlignedMalloc(size, kCacheLineSize);
+  }
+  static void operator delete(void* ptr) { port::AlignedFree(ptr); }
+
   Status Send(const ParsedKey& key, const Args& send_args, const Tensor& val,
               const bool is_dead) override {
     uint64 key_hash = KeyHash(key.FullKey());
     VLOG(2) << "Send " << this << " " << key_hash << " " << key.FullKey();
 
-    mu_.lock();
-    if (!status_.ok()) {
+    Shard* shard = &shards_[ShardIndex(key_hash)];
+    shard->mu.lock();
+    if (TF_PREDICT_FALSE(aborted_.load(std::memory_order_acquire))) {
       // Rendezvous has been aborted.
-      Status s = status_;
-      mu_.unlock();
-      return s;
+      shard->mu.unlock();
+      return status();
     }
 
-    ItemQueue* queue = &table_[key_hash];
+    ItemQueue* queue = shard->Queue(key_hash);
     if (queue->empty() || queue->front()->IsSendValue()) {
       // There is no waiter for this message. Append the message
       // into the queue. The waiter will pick it up when arrives.
@@ -176,14 +184,13 @@ class LocalRendezvousImpl : public Rendezvous {
         item->send_args.device_context->Ref();
       }
       queue->push_back(item);
-      mu_.unlock();
+      shard->mu.unlock();
       return Status::OK();
     }
 
     // There is an earliest waiter to consume this message.
-    Item* item = queue->front();
-    queue->pop_front();
-    mu_.unlock();
+    Item* item = queue->pop_front();
+    shard->mu.unlock();
 
     // Notify the waiter by invoking its done closure, outside the
     // lock.
@@ -198,16 +205,16 @@ class LocalRendezvousImpl : public Rendezvous {
     uint64 key_hash = KeyHash(key.FullKey());
     VLOG(2) << "Recv " << this << " " << key_hash << " " << key.FullKey();
 
-    mu_.lock();
-    if (!status_.ok()) {
+    Shard* shard = &shards_[ShardIndex(key_hash)];
+    shard->mu.lock();
+    if (TF_PREDICT_FALSE(aborted_.load(std::memory_order_acquire))) {
       // Rendezvous has been aborted.
-      Status s = status_;
-      mu_.unlock();
-      done(s, Args(), recv_args, Tensor(), false);
+      shard->mu.unlock();
+      done(status(), Args(), recv_args, Tensor(), false);
       return;
     }
 
-    ItemQueue* queue = &table_[key_hash];
+    ItemQueue* queue = shard->Queue(key_hash);
     if (queue->empty() || !queue->front()->IsSendValue()) {
       // There is no message to pick up.
       // Only recv-related fields need to be filled.
@@ -218,15 +225,14 @@ class LocalRendezvousImpl : public Rendezvous {
         item->recv_args.device_context->Ref();
       }
       queue->push_back(item);
-      mu_.unlock();
+      shard->mu.unlock();
       return;
     }
 
     // A message has already arrived and is queued in the table under
     // this key.  Consumes the message and invokes the done closure.
-    Item* item = queue->front();
-    queue->pop_front();
-    mu_.unlock();
+    Item* item = queue->pop_front();
+    shard->mu.unlock();
 
     // Invokes the done() by invoking its done closure, outside scope
     // of the table lock.
@@ -237,18 +243,30 @@ class LocalRendezvousImpl : public Rendezvous {
 
   void StartAbort(const Status& status) override {
     CHECK(!status.ok());
-    Table table;
     {
-      mutex_lock l(mu_);
+      mutex_lock l(status_mu_);
       status_.Update(status);
-      table_.swap(table);
     }
-    for (auto& p : table) {
-      for (Item* item : p.second) {
-        if (!item->IsSendValue()) {
-          item->waiter(status, Args(), Args(), Tensor(), false);
+    // Any Send or RecvAsync that takes a shard lock after this point fails,
+    // so every item it might have enqueued is in the tables swapped out below.
+    aborted_.store(true, std::memory_order_release);
+    for (Shard& shard : shards_) {
+      std::unique_ptr<Table> table;
+      {
+        mutex_lock l(shard.mu);
+        shard.table.swap(table);
+      }
+      if (table == nullptr) continue;
+      for (auto& p : *table) {
+        Item* item = p.second.front();
+        while (item != nullptr) {
+          Item* next = item->next;
+          if (!item->IsSendValue()) {
+            item->waiter(status, Args(), Args(), Tensor(), false);
+          }
+          delete item;
+          item = next;
         }
-        delete item;
       }
     }
   }
@@ -262,6 +280,8 @@ class LocalRendezvousImpl : public Rendezvous {
     bool is_dead = false;
     Args send_args;
     Args recv_args;
+    // Next item queued under the same key.
+    Item* next = nullptr;
 
     ~Item() {
       if (send_args.device_context) {
@@ -286,17 +306,82 @@ class LocalRendezvousImpl : public Rendezvous {
   // or
   //   [!item.IsSendValue()]* meaning each item is a waiter.
   //
-  // TODO(zhifengc): consider a better queue impl than std::deque.
-  typedef std::deque<Item*> ItemQueue;
+  // Items are chained through Item::next, so that the common case of one
+  // send and one recv per key costs no allocation beyond the item itself.
+  class ItemQueue {
+   public:
+    bool empty() const { return head_ == nullptr; }
+    Item* front() const { return head_; }
+
+    void push_back(Item* item) {
+      item->next = nullptr;
+      if (tail_ == nullptr) {
+        head_ = item;
+      } else {
+        tail_->next = item;
+      }
+      tail_ = item;
+    }
+
+    Item* pop_front() {
+      Item* item = head_;
+      head_ = item->next;
+      if (head_ == nullptr) tail_ = nullptr;
+      return item;
+    }
+
+   private:
+    Item* head_ = nullptr;
+    Item* tail_ = nullptr;
+  };
   typedef gtl::FlatMap<uint64, ItemQueue> Table;
 
-  // TODO(zhifengc): shard table_.
-  mutex mu_;
-  Table table_ GUARDED_BY(mu_);
-  Status status_ GUARDED_BY(mu_);
+  // The table is striped over kNumShards independently locked shards, so
+  // that Send/Recv pairs on unrelated keys (e.g. the many cross-device edges
+  // of a partitioned graph) do not serialize on a single mutex.
+  static constexpr int kNumShards = 16;
+  static_assert((kNumShards & (kNumShards - 1)) == 0,
+                "kNumShards must be a power of 2");
+  // Each shard is on its own cache lines, so that threads locking different
+  // shards don't contend on the same line.
+  static constexpr int kCacheLineSize = 64;
+  struct alignas(kCacheLineSize) Shard {
+    mutex mu;
+    // Created on first use: a rendezvous is created for every step, and most
+    // of them only use a few of the shards, if any.
+    std::unique_ptr<Table> table GUARDED_BY(mu);
+
+    ItemQueue* Queue(uint64 key_hash) EXCLUSIVE_LOCKS_REQUIRED(mu) {
+      if (table == nullptr) table.reset(new Table);
+      return &(*table)[key_hash];
+    }
+  };
+
+  // Uses the upper half of the hash, since the low bits pick the FlatMap
+  // bucket within the shard.
+  static int ShardIndex(uint64 key_hash) {
+    return static_cast<int>((key_hash >> 32) & (kNumShards - 1));
+  }
+
+  Status status() {
+    mutex_lock l(status_mu_);
+    return status_;
+  }
+
+  Shard shards_[kNumShards];
+
+  // Set once StartAbort() has recorded a non-OK status_.
+  std::atomic<bool> aborted_{false};
+  mutex status_mu_;
+  Status status_ GUARDED_BY(status_mu_);
 
   ~LocalRendezvousImpl() override {
-    if (!table_.empty()) {
+    bool empty = true;
+    for (Shard& shard : shards_) {
+      mutex_lock l(shard.mu);
+      empty &= shard.table == nullptr || shard.table->empty();
+    }
+    if (!empty) {
       StartAbort(errors::Cancelled("LocalRendezvousImpl deleted"));
     }
   }
@@ -262,6 +262,36 @@ TEST_F(LocalRendezvousTest, RecvSleepAbort) {
   EXPECT_TRUE(errors::IsAborted(status));
 }
 
+// Pending receivers on many keys, spread over the table's shards, are all
+// notified on abort.
+TEST_F(LocalRendezvousTest, AbortManyPendingRecvs) {
+  static const int N = 100;
+  BlockingState state;
+  state.counter = N;
+  for (int i = 0; i < N; ++i) {
+    rendez_->RecvAsync(
+        MakeKey(strings::StrCat(i)), Rendezvous::Args(),
+        [&state](const Status& status, const Rendezvous::Args& sender_args,
+                 const Rendezvous::Args& recver_args, const Tensor& val,
+                 const bool val_dead) {
+          EXPECT_TRUE(errors::IsAborted(status));
+          bool done = false;
+          {
+            mutex_lock l(state.lock);
+            done = --state.counter == 0;
+          }
+          if (done) state.done.Notify();
+        });
+  }
+  // Messages queued before the abort are dropped with it.
+  TF_ASSERT_OK(
+      rendez_->Send(MakeKey("unreceived"), Rendezvous::Args(), V("x"), false));
+  rendez_->StartAbort(errors::Aborted(""));
+  state.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsAborted(
+      rendez_->Send(MakeKey("0"), Rendezvous::Args(), V("x"), false)));
+}
+
 TEST_F(LocalRendezvousTest, AbortThenRecvOrSend) {
   rendez_->StartAbort(errors::Aborted(""));
   Tensor val(DT_STRING);
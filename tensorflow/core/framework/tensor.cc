@@ -119,6 +119,54 @@ class Buffer : public BufferBase {
   TF_DISALLOW_COPY_AND_ASSIGN(Buffer);
 };
 
+// A ref-counted buffer for small tensors of simple types, holding the payload
+// in the same allocation as the buffer object. Creating one costs a single
+// AlignedMalloc instead of an Allocator call plus a separate `new Buffer<T>`,
+// which keeps the allocator (and its locks and statistics) off the path of
+// the many tiny shape and index tensors that shape-manipulation graphs create.
+class InlineBuffer : public TensorBuffer {
+ public:
+  // Payloads up to this many bytes are stored inline, e.g. a shape vector of
+  // up to 8 int64 dimensions.
+  static constexpr size_t kMaxBytes = 64;
+
+  // Returns true iff a tensor of "type" with "num_elements" elements, that
+  // would otherwise be allocated by "a", may use an InlineBuffer instead.
+  static bool CanUse(Allocator* a, DataType type, int64 num_elements);
+
+  static InlineBuffer* New(size_t num_bytes) {
+    DCHECK_LE(num_bytes, kMaxBytes);
+    void* ptr = port::AlignedMalloc(sizeof(InlineBuffer), EIGEN_MAX_ALIGN_BYTES);
+    return new (ptr) InlineBuffer(num_bytes);
+  }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("InlineBuffer");
+    proto->set_ptr(reinterpret_cast<uintptr_t>(data()));
+  }
+
+  // `core::RefCounted::Unref()` deletes the buffer with `delete this`, so
+  // route that to the AlignedMalloc() in New().
+  static void operator delete(void* ptr) { port::AlignedFree(ptr); }
+  static void operator delete(void*, void*) {}
+
+ private:
+  explicit InlineBuffer(size_t num_bytes)
+      : TensorBuffer(payload_), size_(num_bytes) {}
+  ~InlineBuffer() override {}
+
+#if EIGEN_MAX_ALIGN_BYTES > 0
+  alignas(EIGEN_MAX_ALIGN_BYTES)
+#endif
+      char payload_[kMaxBytes];
+  const size_t size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(InlineBuffer);
+};
+
 void LogUnexpectedSize(int64 actual, int64 expected) {
   LOG(ERROR) << "Input size was " << actual << " and expected " << expected;
 }
@@ -734,7 +782,9 @@ Tensor::Tensor(Allocator* a, DataType type, const TensorShape& shape)
     : shape_(shape), buf_(nullptr) {
   set_dtype(type);
   CHECK_NOTNULL(a);
-  if (shape_.num_elements() > 0 || a->ShouldAllocateEmptyTensors()) {
+  if (InlineBuffer::CanUse(a, type, shape_.num_elements())) {
+    buf_ = InlineBuffer::New(shape_.num_elements() * DataTypeSize(type));
+  } else if (shape_.num_elements() > 0 || a->ShouldAllocateEmptyTensors()) {
     CASES(type, buf_ = new Buffer<T>(a, shape.num_elements()));
   }
   if (buf_ != nullptr && buf_->data() != nullptr && LogMemory::IsEnabled()) {
@@ -748,7 +798,10 @@ Tensor::Tensor(Allocator* a, DataType type, const TensorShape& shape,
     : shape_(shape), buf_(nullptr) {
   set_dtype(type);
   CHECK_NOTNULL(a);
-  if (shape_.num_elements() > 0 || a->ShouldAllocateEmptyTensors()) {
+  if (allocation_attr.freed_by_func == nullptr &&
+      InlineBuffer::CanUse(a, type, shape_.num_elements())) {
+    buf_ = InlineBuffer::New(shape_.num_elements() * DataTypeSize(type));
+  } else if (shape_.num_elements() > 0 || a->ShouldAllocateEmptyTensors()) {
     CASES(type, buf_ = new Buffer<T>(a, shape.num_elements(), allocation_attr));
   }
   if (!allocation_attr.allocation_will_be_logged && buf_ != nullptr &&
@@ -775,6 +828,19 @@ static Allocator* get_default_cpu_allocator() {
 Tensor::Tensor(DataType type, const TensorShape& shape)
     : Tensor(get_default_cpu_allocator(), type, shape) {}
 
+// Only tensors that would come from the process-wide default CPU allocator are
+// stored inline: any other allocator (a device's, a tracking or scoped
+// allocator, ...) may account for or place its memory in ways the caller
+// relies on.
+bool InlineBuffer::CanUse(Allocator* a, DataType type, int64 num_elements) {
+  // Divide rather than multiply, which could overflow for huge shapes.
+  return num_elements > 0 && DataTypeCanUseMemcpy(type) &&
+         DataTypeSize(type) > 0 &&
+         num_elements <= static_cast<int64>(kMaxBytes) / DataTypeSize(type) &&
+         a == get_default_cpu_allocator() && !CPUAllocatorStatsEnabled() &&
+         !LogMemory::IsEnabled();
+}
+
 void Tensor::HostScalarTensorBufferBase::FillAllocationDescription(
     AllocationDescription* proto) const {
   proto->set_requested_bytes(size());
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/framework/tensor.h"
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_description.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
@@ -830,6 +832,47 @@ TEST(Tensor_Scalar, Basics) {
   }
 }
 
+string AllocatorNameOf(const Tensor& t) {
+  TensorDescription desc;
+  t.FillDescription(&desc);
+  return desc.allocation_description().allocator_name();
+}
+
+TEST(Tensor_Inline, SmallTensorsUseInlineBuffer) {
+  Tensor shape(DT_INT64, TensorShape({4}));
+  EXPECT_EQ("InlineBuffer", AllocatorNameOf(shape));
+  EXPECT_TRUE(shape.IsAligned());
+  test::FillValues<int64>(&shape, {2, 3, 5, 7});
+
+  // Copies and reshapes share the inline buffer.
+  Tensor copy = shape;
+  EXPECT_TRUE(copy.SharesBufferWith(shape));
+  Tensor reshaped;
+  ASSERT_TRUE(reshaped.CopyFrom(shape, TensorShape({2, 2})));
+  EXPECT_TRUE(reshaped.SharesBufferWith(shape));
+  test::ExpectTensorEqual<int64>(
+      test::AsTensor<int64>({2, 3, 5, 7}, TensorShape({2, 2})), reshaped);
+
+  // Allocator-based construction with the default CPU allocator also uses an
+  // inline buffer.
+  Tensor with_allocator(cpu_allocator(), DT_FLOAT, TensorShape({16}));
+  EXPECT_EQ("InlineBuffer", AllocatorNameOf(with_allocator));
+  EXPECT_EQ(64, with_allocator.TotalBytes());
+}
+
+TEST(Tensor_Inline, LargeOrComplexTensorsUseAllocator) {
+  Tensor large(DT_FLOAT, TensorShape({17}));
+  EXPECT_NE("InlineBuffer", AllocatorNameOf(large));
+  Tensor strings(DT_STRING, TensorShape({2}));
+  EXPECT_NE("InlineBuffer", AllocatorNameOf(strings));
+  Tensor empty(DT_FLOAT, TensorShape({0}));
+  EXPECT_NE("InlineBuffer", AllocatorNameOf(empty));
+
+  // The byte size of this shape overflows int64, and it can't be allocated.
+  Tensor huge(DT_INT32, TensorShape({int64{1} << 62}));
+  EXPECT_FALSE(huge.IsInitialized());
+}
+
 TEST(Tensor_HostScalar, Basics) {
   {
     Tensor t(true);
@@ -1517,5 +1560,16 @@ void BM_CreateAndDestroyHostScalarOptimized(int iters) {
 }
 BENCHMARK(BM_CreateAndDestroyHostScalarOptimized);
 
+// Benchmark creating and destroying a small shape vector, as done by shape
+// manipulation ops.
+void BM_CreateAndDestroySmallVector(int iters) {
+  TensorShape shape({4});
+  while (--iters) {
+    Tensor a(DT_INT32, shape);
+    a.flat<int32>()(0) = 37;
+  }
+}
+BENCHMARK(BM_CreateAndDestroySmallVector);
+
 }  // namespace
 }  // namespace tensorflow
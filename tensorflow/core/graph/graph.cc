@@ -404,22 +404,28 @@ const VersionDef& Graph::versions() const { return *versions_; }
 void Graph::set_versions(const VersionDef& versions) { *versions_ = versions; }
 
 Node* Graph::AddNode(const NodeDef& node_def, Status* status) {
-  const OpDef* op_def;
-  status->Update(ops_.LookUpOpDef(node_def.op(), &op_def));
+  std::shared_ptr<NodeProperties> props;
+  status->Update(MakeNodeProperties(node_def, &props));
   if (!status->ok()) return nullptr;
+  return AddNode(std::move(props));
+}
+
+Status Graph::MakeNodeProperties(const NodeDef& node_def,
+                                 std::shared_ptr<NodeProperties>* props) const {
+  const OpDef* op_def;
+  TF_RETURN_IF_ERROR(ops_.LookUpOpDef(node_def.op(), &op_def));
 
   DataTypeVector inputs;
   DataTypeVector outputs;
-  status->Update(InOutTypesForNode(node_def, *op_def, &inputs, &outputs));
-  if (!status->ok()) {
-    *status = AttachDef(*status, node_def);
-    return nullptr;
-  }
+  Status s = InOutTypesForNode(node_def, *op_def, &inputs, &outputs);
+  if (!s.ok()) return AttachDef(s, node_def);
 
-  Node* node = AllocateNode(
-      std::make_shared<NodeProperties>(op_def, node_def, inputs, outputs),
-      nullptr);
-  return node;
+  *props = std::make_shared<NodeProperties>(op_def, node_def, inputs, outputs);
+  return Status::OK();
+}
+
+Node* Graph::AddNode(std::shared_ptr<NodeProperties> props) {
+  return AllocateNode(std::move(props), nullptr);
 }
 
 Node* Graph::CopyNode(const Node* node) {
@@ -478,6 +478,17 @@ class Graph {
   // Returns nullptr and sets *status on error.
   Node* AddNode(const NodeDef& node_def, Status* status);
 
+  // Infers the Op and input/output types for a node defined by `node_def`,
+  // as AddNode() does, without adding it to this graph. Since this does not
+  // modify the graph, several threads may call it concurrently, e.g. to
+  // prepare the nodes of a large graph in parallel.
+  Status MakeNodeProperties(const NodeDef& node_def,
+                            std::shared_ptr<NodeProperties>* props) const;
+
+  // Adds a new node with properties returned by MakeNodeProperties(), and
+  // returns it. *this owns the returned instance.
+  Node* AddNode(std::shared_ptr<NodeProperties> props);
+
   // Copies *node, which may belong to another graph, to a new node,
   // which is returned.  Does not copy any edges.  *this owns the
   // returned instance.
@@ -37,13 +37,16 @@ limitations under the License.
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/scanner.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -53,6 +56,22 @@ namespace {
 // can skip expensive duplicates check in 'AddControlEdge'.
 static constexpr const bool kDoNotCheckDuplicates = true;
 
+// Graphs with at least this many nodes infer the Op and input/output types of
+// their nodes in parallel, before adding them to the Graph in order.
+static constexpr const int kMinNodesForParallelConstruction = 1024;
+
+// Returns the process-wide pool that infers node properties in parallel, or
+// nullptr if there is only one CPU to run on.
+thread::ThreadPool* GraphConstructionThreadPool() {
+  static thread::ThreadPool* const pool = []() -> thread::ThreadPool* {
+    const int num_threads = port::NumSchedulableCPUs();
+    if (num_threads <= 1) return nullptr;
+    return new thread::ThreadPool(Env::Default(), "graph_constructor",
+                                  num_threads);
+  }();
+  return pool;
+}
+
 inline bool IsMerge(const NodeDef& node_def) {
   return node_def.op() == "Merge" || node_def.op() == "RefMerge";
 }
@@ -204,7 +223,8 @@ class GraphConstructor {
            absl::flat_hash_set<int>* unvisited);
   Status IsNodeFullyMapped(const NodeDef& node_def, bool* is_node_mapped);
   Status ValidateColocationConstraints(const NodeDef& node_def);
-  Status MakeNode(const NodeDef& node_def, Node** node);
+  void MakeNodePropertiesInParallel();
+  Status MakeNode(const NodeDef& node_def, int index, Node** node);
   Status MakeEdge(Node* src, int output_index, Node* dst, int input_index);
   Status ValidateShape(Node* node);
   Status ModifyNodeDefForImport(NodeDef* node_def);
@@ -343,6 +363,11 @@ class GraphConstructor {
     int dst_index;
   };
   std::vector<EdgeInfo> back_edges_;
+
+  // Mapping between index within node_defs_ and the properties of the node
+  // to create for it, if MakeNodePropertiesInParallel() computed them. Moved
+  // into the node when it is created.
+  std::vector<std::shared_ptr<NodeProperties>> node_props_;
 };
 
 void GraphConstructor::UpdatePendingCountAndReady(int processed) {
@@ -595,11 +620,41 @@ Status GraphConstructor::ValidateColocationConstraints(
   return Status::OK();
 }
 
-Status GraphConstructor::MakeNode(const NodeDef& node_def, Node** node) {
+void GraphConstructor::MakeNodePropertiesInParallel() {
+  // When importing, the NodeDefs are rewritten one at a time as they are
+  // converted, so their properties are only known then.
+  if (opts_.importing) return;
+  if (node_defs_.size() < kMinNodesForParallelConstruction) return;
+  thread::ThreadPool* pool = GraphConstructionThreadPool();
+  if (pool == nullptr) return;
+
+  // Looking up the OpDef, inferring the input/output types and copying the
+  // NodeDef dominate the cost of converting large graphs, and do not depend
+  // on the other nodes. Nodes whose properties fail to compute are left
+  // without them, so that MakeNode() reports the error in the usual order.
+  node_props_.resize(node_defs_.size());
+  const int64 kCostPerNode = 10000;
+  Shard(pool->NumThreads(), pool, node_defs_.size(), kCostPerNode,
+        [this](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            std::shared_ptr<NodeProperties> props;
+            if (g_->MakeNodeProperties(*node_defs_[i], &props).ok()) {
+              node_props_[i] = std::move(props);
+            }
+          }
+        });
+}
+
+Status GraphConstructor::MakeNode(const NodeDef& node_def, int index,
+                                  Node** node) {
   // Add the node to the graph.
-  Status status;
-  *node = g_->AddNode(node_def, &status);
-  if (!status.ok()) return status;
+  if (index < node_props_.size() && node_props_[index] != nullptr) {
+    *node = g_->AddNode(std::move(node_props_[index]));
+  } else {
+    Status status;
+    *node = g_->AddNode(node_def, &status);
+    if (!status.ok()) return status;
+  }
   if (opts_.expect_device_spec) {
     (*node)->set_assigned_device_name(node_def.device());
   }
@@ -983,6 +1038,8 @@ Status GraphConstructor::Convert() {
     TF_RETURN_IF_ERROR(g_->AddFunctionLibrary(*library_));
   }
 
+  MakeNodePropertiesInParallel();
+
   std::vector<InputInfo> inputs;
   int processed = 0;
 
@@ -1094,7 +1151,7 @@ Status GraphConstructor::Convert() {
       }
       TF_RETURN_IF_ERROR(ModifyNodeDefForImport(&imported_node_def));
     }
-    TF_RETURN_IF_ERROR(MakeNode(*node_def, &node));
+    TF_RETURN_IF_ERROR(MakeNode(*node_def, o, &node));
     // Use original_node_def so name StringPiece remains valid
     gdef_nodes_[original_node_def.name()].node = node;
 
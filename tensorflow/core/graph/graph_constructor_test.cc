@@ -885,6 +885,43 @@ TEST_F(GraphConstructorTest, SimpleModelWithControlEdges) {
   EXPECT_TRUE(HasControlEdge("t1", "t2"));
 }
 
+// Returns a GraphDef in which each of `num_muls` TestMul nodes consumes the
+// previous one, listed in reverse topological order. Large enough graphs
+// infer the properties of their nodes in parallel.
+string ChainOfMuls(int num_muls) {
+  string gdef_ascii;
+  for (int i = num_muls - 1; i >= 0; --i) {
+    const string input = i == 0 ? "input:0" : strings::StrCat("t", i - 1);
+    strings::StrAppend(&gdef_ascii, "node { name: 't", i,
+                       "' op: 'TestMul' input: [ '", input, "', 'input:1' ] }");
+  }
+  strings::StrAppend(&gdef_ascii, "node { name: 'input' op: 'TestInput' }");
+  return gdef_ascii;
+}
+
+TEST_F(GraphConstructorTest, LargeModel) {
+  const int kNumMuls = 2000;
+  ExpectOK(ChainOfMuls(kNumMuls));
+  EXPECT_EQ(kNumMuls + 3, graph_.num_nodes());  // Includes _SOURCE, _SINK.
+  EXPECT_TRUE(HasEdge("input", 0, "t0", 0));
+  EXPECT_TRUE(HasEdge("input", 1, "t0", 1));
+  EXPECT_TRUE(HasEdge("t0", 0, "t1", 0));
+  EXPECT_TRUE(HasEdge("input", 1, "t1", 1));
+  EXPECT_TRUE(HasEdge("t1998", 0, "t1999", 0));
+  // Nodes are still created in topological order.
+  EXPECT_LT(FindNode("input")->id(), FindNode("t0")->id());
+  EXPECT_LT(FindNode("t0")->id(), FindNode("t1")->id());
+  EXPECT_LT(FindNode("t1998")->id(), FindNode("t1999")->id());
+}
+
+TEST_F(GraphConstructorTest, LargeModel_TypeMismatch) {
+  ExpectError(strings::StrCat(ChainOfMuls(2000),
+                              "node { name: 'int' op: 'TestInt' input: [ "
+                              "'t1999' ] }"),
+              {"Input 0 of node int was passed float from t1999:0 "
+               "incompatible with expected int32."});
+}
+
 TEST_F(GraphConstructorTest, Error_ControlEdgeBeforeRealInput) {
   ExpectError(
       "node { name: 'W1' op: 'TestParams' }"
@@ -35,7 +35,9 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -2067,6 +2069,45 @@ Status GraphProperties::UpdateEnqueue(
 
 Status GraphProperties::InferStatically(bool assume_valid_feeds,
                                         bool aggressive_shape_inference) {
+  GraphPropertiesCache* cache = GraphPropertiesCache::Current();
+  if (cache == nullptr) {
+    return InferStaticallyUncached(assume_valid_feeds,
+                                   aggressive_shape_inference);
+  }
+
+  // The inferred properties only depend on the graph, the fed tensors (unless
+  // the feeds are assumed to be valid) and the inference options.
+  string key;
+  if (!SerializeToStringDeterministic(item_.graph, &key)) {
+    return InferStaticallyUncached(assume_valid_feeds,
+                                   aggressive_shape_inference);
+  }
+  if (!assume_valid_feeds) {
+    for (const auto& feed : item_.feed) {
+      strings::StrAppend(&key, ";", feed.first);
+    }
+  }
+  strings::StrAppend(&key, ";", assume_valid_feeds, ";",
+                     aggressive_shape_inference);
+  const Fprint128 fingerprint = Fingerprint128(key);
+
+  const GraphPropertiesCache::Entry* entry = cache->Lookup(fingerprint);
+  if (entry != nullptr) {
+    VLOG(2) << "Reusing the graph properties inferred for grappler item "
+            << item_.id;
+    input_properties_ = entry->input_properties;
+    output_properties_ = entry->output_properties;
+    return Status::OK();
+  }
+
+  TF_RETURN_IF_ERROR(
+      InferStaticallyUncached(assume_valid_feeds, aggressive_shape_inference));
+  cache->Insert(fingerprint, input_properties_, output_properties_);
+  return Status::OK();
+}
+
+Status GraphProperties::InferStaticallyUncached(
+    bool assume_valid_feeds, bool aggressive_shape_inference) {
   FunctionLibraryDefinition function_library(OpRegistry::Global(),
                                              item_.graph.library());
   std::unordered_map<string, std::unordered_set<int>> fed_ports;
@@ -2374,5 +2415,44 @@ void GraphProperties::ClearOutputProperties(const string& node_name) {
   output_properties_.erase(node_name);
 }
 
+namespace {
+thread_local GraphPropertiesCache* current_graph_properties_cache = nullptr;
+}  // namespace
+
+GraphPropertiesCache::GraphPropertiesCache(int capacity)
+    : capacity_(capacity), enclosing_cache_(current_graph_properties_cache) {
+  current_graph_properties_cache = this;
+}
+
+GraphPropertiesCache::~GraphPropertiesCache() {
+  DCHECK_EQ(current_graph_properties_cache, this);
+  current_graph_properties_cache = enclosing_cache_;
+}
+
+GraphPropertiesCache* GraphPropertiesCache::Current() {
+  return current_graph_properties_cache;
+}
+
+const GraphPropertiesCache::Entry* GraphPropertiesCache::Lookup(
+    const Fprint128& key) {
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->key == key) {
+      entries_.splice(entries_.begin(), entries_, it);
+      ++num_hits_;
+      return &entries_.front();
+    }
+  }
+  ++num_misses_;
+  return nullptr;
+}
+
+void GraphPropertiesCache::Insert(const Fprint128& key,
+                                  const PropertiesMap& input_properties,
+                                  const PropertiesMap& output_properties) {
+  if (capacity_ <= 0) return;
+  entries_.push_front({key, input_properties, output_properties});
+  if (entries_.size() > static_cast<size_t>(capacity_)) entries_.pop_back();
+}
+
 }  // end namespace grappler
 }  // end namespace tensorflow
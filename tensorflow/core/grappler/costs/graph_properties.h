@@ -16,12 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 #define TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 
+#include <list>
 #include <unordered_map>
 #include <vector>
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
 
@@ -169,6 +172,10 @@ class GraphProperties {
           resource_handles,
       int num_loops) const;
 
+  // Runs the static shape inference, without looking up the cache.
+  Status InferStaticallyUncached(bool assume_valid_feeds,
+                                 bool aggressive_shape_inference);
+
   // Data members
   const GrapplerItem& item_;
   std::unordered_map<string, std::vector<OpInfo::TensorProperties>>
@@ -178,6 +185,53 @@ class GraphProperties {
   const std::vector<OpInfo::TensorProperties> missing_properties_;
 };
 
+// Caches the results of GraphProperties::InferStatically() on the thread that
+// created it, for as long as it is alive. A GraphProperties created for a
+// graph that was already analyzed (with the same feeds and options) copies the
+// properties inferred for it, instead of running the shape inference again.
+//
+// The meta optimizer creates a cache for each graph it optimizes, so that the
+// optimizers share the shape inference until one of them rewrites the graph.
+// Caches can be nested, in which case the innermost one is used.
+class GraphPropertiesCache {
+ public:
+  // Keeps the properties of the `capacity` most recently analyzed graphs.
+  explicit GraphPropertiesCache(int capacity = 4);
+  ~GraphPropertiesCache();
+
+  // Returns the innermost cache of the current thread, or nullptr.
+  static GraphPropertiesCache* Current();
+
+  int64 num_hits() const { return num_hits_; }
+  int64 num_misses() const { return num_misses_; }
+
+ private:
+  friend class GraphProperties;
+
+  using PropertiesMap =
+      std::unordered_map<string, std::vector<OpInfo::TensorProperties>>;
+
+  struct Entry {
+    Fprint128 key;
+    PropertiesMap input_properties;
+    PropertiesMap output_properties;
+  };
+
+  // Returns the entry with the given key, or nullptr if there is none.
+  const Entry* Lookup(const Fprint128& key);
+  void Insert(const Fprint128& key, const PropertiesMap& input_properties,
+              const PropertiesMap& output_properties);
+
+  const int capacity_;
+  GraphPropertiesCache* const enclosing_cache_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  int64 num_hits_ = 0;
+  int64 num_misses_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GraphPropertiesCache);
+};
+
 }  // end namespace grappler
 }  // end namespace tensorflow
 
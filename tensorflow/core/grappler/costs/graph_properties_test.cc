@@ -199,6 +199,61 @@ TEST_F(GraphPropertiesTest, ClearProperties) {
   }
 }
 
+TEST_F(GraphPropertiesTest, CachedStaticProperties) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false,
+                                          cluster_->GetDeviceNames());
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  GraphProperties expected(item);
+  TF_CHECK_OK(expected.InferStatically(true));
+
+  GraphPropertiesCache cache;
+  EXPECT_EQ(&cache, GraphPropertiesCache::Current());
+  {
+    GraphProperties properties(item);
+    TF_CHECK_OK(properties.InferStatically(true));
+  }
+  EXPECT_EQ(0, cache.num_hits());
+  EXPECT_EQ(1, cache.num_misses());
+
+  // The properties of the unchanged graph come from the cache.
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(true));
+  EXPECT_EQ(1, cache.num_hits());
+  for (const auto& node : item.graph.node()) {
+    const auto& expected_inputs = expected.GetInputProperties(node.name());
+    const auto& inputs = properties.GetInputProperties(node.name());
+    ASSERT_EQ(expected_inputs.size(), inputs.size());
+    for (int i = 0; i < inputs.size(); ++i) {
+      EXPECT_EQ(expected_inputs[i].DebugString(), inputs[i].DebugString());
+    }
+    const auto& expected_outputs = expected.GetOutputProperties(node.name());
+    const auto& outputs = properties.GetOutputProperties(node.name());
+    ASSERT_EQ(expected_outputs.size(), outputs.size());
+    for (int i = 0; i < outputs.size(); ++i) {
+      EXPECT_EQ(expected_outputs[i].DebugString(), outputs[i].DebugString());
+    }
+  }
+
+  // Different options or a rewritten graph require a new shape inference.
+  GraphProperties other_options(item);
+  TF_CHECK_OK(other_options.InferStatically(false));
+  EXPECT_EQ(2, cache.num_misses());
+
+  GrapplerItem rewritten = item;
+  NodeDef* identity = rewritten.graph.add_node();
+  identity->set_name("identity");
+  identity->set_op("Identity");
+  identity->add_input(item.fetch[0]);
+  (*identity->mutable_attr())["T"].set_type(DT_FLOAT);
+  GraphProperties rewritten_properties(rewritten);
+  TF_CHECK_OK(rewritten_properties.InferStatically(true));
+  EXPECT_EQ(3, cache.num_misses());
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_TRUE(rewritten_properties.HasOutputProperties("identity"));
+}
+
 TEST_F(GraphPropertiesTest, DynamicProperties) {
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false,
                                           cluster_->GetDeviceNames());
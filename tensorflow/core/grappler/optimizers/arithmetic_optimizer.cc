@@ -26,6 +26,7 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
@@ -3310,10 +3311,151 @@ class RemoveStackStridedSliceSameAxis : public ArithmeticOptimizerStage {
   }
 };
 
+// Summarizes the function library of a graph for DedupComputations: which
+// functions can be called without side effects, and which functions have the
+// same definition. Calls to functions with the same definition, bound to the
+// same inputs, compute the same values, even if the functions are not inlined.
+class FunctionCallAnalysis {
+ public:
+  explicit FunctionCallAnalysis(const FunctionDefLibrary& library)
+      : library_(OpRegistry::Global(), library) {
+    absl::flat_hash_set<string> has_gradient;
+    for (const GradientDef& gradient : library.gradient()) {
+      has_gradient.insert(gradient.function_name());
+    }
+    absl::flat_hash_map<uint64, std::vector<std::pair<string, FunctionDef>>>
+        unique_functions;
+    for (const FunctionDef& function : library.function()) {
+      const string& name = function.signature().name();
+      if (IsFunctionFreeOfSideEffect(name, /*depth=*/0)) {
+        side_effect_free_functions_.insert(name);
+      }
+      // Merging the calls to functions with different gradients could change
+      // the gradient computed for the graph.
+      if (has_gradient.count(name) > 0) continue;
+      FunctionDef anonymous_function = function;
+      anonymous_function.mutable_signature()->clear_name();
+      auto& candidates =
+          unique_functions[FunctionDefHash(anonymous_function)];
+      string canonical_name = name;
+      for (const auto& candidate : candidates) {
+        if (FunctionDefsEqual(candidate.second, anonymous_function)) {
+          canonical_name = candidate.first;
+          break;
+        }
+      }
+      if (canonical_name == name) {
+        candidates.emplace_back(name, std::move(anonymous_function));
+      } else {
+        VLOG(3) << "Function " << name << " has the same definition as "
+                << canonical_name;
+        canonical_names_.emplace(name, std::move(canonical_name));
+      }
+    }
+  }
+
+  // Ops and functions of the graph.
+  const OpRegistryInterface& op_registry() const { return library_; }
+
+  // Returns false if `node` calls a function (directly, or through a function
+  // attribute) that may have side effects, or that is not in the library.
+  bool CallsAreFreeOfSideEffect(const NodeDef& node) const {
+    if (library_.Find(node.op()) != nullptr &&
+        side_effect_free_functions_.count(node.op()) == 0) {
+      return false;
+    }
+    for (const auto& attr : node.attr()) {
+      if (attr.second.has_func() &&
+          side_effect_free_functions_.count(attr.second.func().name()) == 0) {
+        return false;
+      }
+      for (const NameAttrList& func : attr.second.list().func()) {
+        if (side_effect_free_functions_.count(func.name()) == 0) return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns the name of the first function of the library with the same
+  // definition as `name` (up to the function name), or `name` itself.
+  const string& CanonicalName(const string& name) const {
+    auto it = canonical_names_.find(name);
+    return it == canonical_names_.end() ? name : it->second;
+  }
+
+  static bool RefersToFunctions(const AttrValue& value) {
+    return value.has_func() || value.list().func_size() > 0;
+  }
+
+  // Returns `value` with the names of the functions it refers to replaced by
+  // their canonical names.
+  AttrValue CanonicalAttrValue(const AttrValue& value) const {
+    AttrValue canonical_value = value;
+    if (canonical_value.has_func()) {
+      NameAttrList* func = canonical_value.mutable_func();
+      func->set_name(CanonicalName(func->name()));
+    }
+    for (NameAttrList& func :
+         *canonical_value.mutable_list()->mutable_func()) {
+      func.set_name(CanonicalName(func.name()));
+    }
+    return canonical_value;
+  }
+
+ private:
+  // Functions can't be recursive, so this is only reached on invalid graphs.
+  static constexpr int kMaxCallDepth = 32;
+
+  bool IsFunctionFreeOfSideEffect(const string& name, int depth) {
+    auto it = side_effect_free_.find(name);
+    if (it != side_effect_free_.end()) return it->second;
+    const FunctionDef* function = library_.Find(name);
+    bool free_of_side_effect = function != nullptr && depth < kMaxCallDepth &&
+                               !function->signature().is_stateful();
+    if (free_of_side_effect) {
+      for (const NodeDef& node : function->node_def()) {
+        if (!IsNodeFreeOfSideEffect(node, depth + 1)) {
+          free_of_side_effect = false;
+          break;
+        }
+      }
+    }
+    side_effect_free_[name] = free_of_side_effect;
+    return free_of_side_effect;
+  }
+
+  bool IsNodeFreeOfSideEffect(const NodeDef& node, int depth) {
+    if (!IsFreeOfSideEffect(node, &library_)) return false;
+    if (library_.Find(node.op()) != nullptr &&
+        !IsFunctionFreeOfSideEffect(node.op(), depth)) {
+      return false;
+    }
+    for (const auto& attr : node.attr()) {
+      if (attr.second.has_func() &&
+          !IsFunctionFreeOfSideEffect(attr.second.func().name(), depth)) {
+        return false;
+      }
+      for (const NameAttrList& func : attr.second.list().func()) {
+        if (!IsFunctionFreeOfSideEffect(func.name(), depth)) return false;
+      }
+    }
+    return true;
+  }
+
+  FunctionLibraryDefinition library_;
+  absl::flat_hash_map<string, string> canonical_names_;
+  absl::flat_hash_set<string> side_effect_free_functions_;
+  // Memoized results of IsFunctionFreeOfSideEffect.
+  absl::flat_hash_map<string, bool> side_effect_free_;
+};
+
 }  // namespace
 
 class UniqueNodes {
  public:
+  explicit UniqueNodes(const FunctionCallAnalysis* functions)
+      : functions_(functions) {}
+
   NodeDef* FindOrAddRepresentative(NodeDef* node) {
     uint64 sig = ComputeSignature(*node);
     std::vector<NodeDef*>& candidates = rep_[sig];
@@ -3330,6 +3472,26 @@ class UniqueNodes {
   uint64 ComputeSignature(const NodeDef& node);
   bool SameNode(const NodeDef& node1, const NodeDef& node2) const;
 
+  // Attribute values that refer to functions with the same definition are
+  // considered equal.
+  uint64 AttrValueHash(const AttrValue& value) const {
+    if (!FunctionCallAnalysis::RefersToFunctions(value)) {
+      return FastAttrValueHash(value);
+    }
+    return FastAttrValueHash(functions_->CanonicalAttrValue(value));
+  }
+  bool AreAttrValuesEqual(const AttrValue& value1,
+                          const AttrValue& value2) const {
+    if (!FunctionCallAnalysis::RefersToFunctions(value1) ||
+        !FunctionCallAnalysis::RefersToFunctions(value2)) {
+      return FastAreAttrValuesEqual(value1, value2);
+    }
+    return FastAreAttrValuesEqual(functions_->CanonicalAttrValue(value1),
+                                  functions_->CanonicalAttrValue(value2));
+  }
+
+  // Not owned.
+  const FunctionCallAnalysis* functions_;
   absl::flat_hash_map<uint64, std::vector<NodeDef*>> rep_;
   absl::flat_hash_map<const NodeDef*, uint64> memoized_signatures_;
 };
@@ -3338,7 +3500,8 @@ uint64 UniqueNodes::ComputeSignature(const NodeDef& node) {
   auto it = memoized_signatures_.find(&node);
   if (it != memoized_signatures_.end()) return it->second;
 
-  uint64 h = Hash64(node.op());
+  // Calls to functions with the same definition have the same signature.
+  uint64 h = Hash64(functions_->CanonicalName(node.op()));
   h = Hash64Combine(Hash64(node.device()), h);
 
   for (const auto& input : node.input()) {
@@ -3349,14 +3512,15 @@ uint64 UniqueNodes::ComputeSignature(const NodeDef& node) {
   }
   for (const auto& attr : node.attr()) {
     h = Hash64CombineUnordered(Hash64(attr.first), h);
-    h = Hash64CombineUnordered(FastAttrValueHash(attr.second), h);
+    h = Hash64CombineUnordered(AttrValueHash(attr.second), h);
   }
   memoized_signatures_.emplace(&node, h);
   return h;
 }
 
 bool UniqueNodes::SameNode(const NodeDef& node1, const NodeDef& node2) const {
-  if (node1.op() != node2.op()) {
+  if (functions_->CanonicalName(node1.op()) !=
+      functions_->CanonicalName(node2.op())) {
     return false;
   }
   if (node1.device() != node2.device()) {
@@ -3405,13 +3569,14 @@ bool UniqueNodes::SameNode(const NodeDef& node1, const NodeDef& node2) const {
   for (const auto& attr1 : node1.attr()) {
     auto it = node2.attr().find(attr1.first);
     if (it == node2.attr().end()) return false;
-    if (!FastAreAttrValuesEqual(attr1.second, it->second)) return false;
+    if (!AreAttrValuesEqual(attr1.second, it->second)) return false;
   }
 
   return true;
 }
 
-bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
+bool ArithmeticOptimizer::CanDedup(
+    const NodeDef& node, const OpRegistryInterface& op_registry) const {
   if (nodes_to_preserve_.find(node.name()) != nodes_to_preserve_.end()) {
     return false;
   }
@@ -3425,7 +3590,7 @@ bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
   if (IsAssert(node) || IsPrint(node)) {
     return true;
   }
-  return IsFreeOfSideEffect(node);
+  return IsFreeOfSideEffect(node, &op_registry);
 }
 
 void ArithmeticOptimizer::DedupComputations() {
@@ -3453,9 +3618,11 @@ void ArithmeticOptimizer::DedupComputations() {
     }
   }
 
+  const FunctionCallAnalysis functions(optimized_graph_->library());
+
   bool stop = true;
   std::set<int> duplicates;
-  UniqueNodes nodes;
+  UniqueNodes nodes(&functions);
   do {
     stop = true;
     for (int i = 0; i < optimized_graph_->node_size(); ++i) {
@@ -3463,7 +3630,8 @@ void ArithmeticOptimizer::DedupComputations() {
         continue;
       }
       NodeDef* node = optimized_graph_->mutable_node(i);
-      if (!CanDedup(*node) ||
+      if (!CanDedup(*node, functions.op_registry()) ||
+          !functions.CallsAreFreeOfSideEffect(*node) ||
           feeds_inplace_op.find(node) != feeds_inplace_op.end()) {
         continue;
       }
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_ARITHMETIC_OPTIMIZER_H_
 
 #include <unordered_set>
+#include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
 #include "tensorflow/core/grappler/utils.h"
@@ -93,8 +94,10 @@ class ArithmeticOptimizer : public GraphOptimizer {
     }
   };
 
-  // Returns true if it is safe to dedup node from the graph.
-  bool CanDedup(const NodeDef& node) const;
+  // Returns true if it is safe to dedup node from the graph. `op_registry`
+  // also knows about the functions of the graph library.
+  bool CanDedup(const NodeDef& node,
+                const OpRegistryInterface& op_registry) const;
 
   // Dedup redundant nodes in the graph.
   void DedupComputations();
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/array_ops.h"
 #include "tensorflow/cc/ops/math_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/grappler_item.h"
@@ -213,6 +214,48 @@ TEST_F(ArithmeticOptimizerTest, OpDedupCommutative) {
   test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
 }
 
+TEST_F(ArithmeticOptimizerTest, FunctionCallDedup) {
+  using test::function::NDef;
+
+  // XTimesTwoCopy has the same definition as XTimesTwo.
+  FunctionDef x_times_two_copy = test::function::XTimesTwo();
+  x_times_two_copy.mutable_signature()->set_name("XTimesTwoCopy");
+  FunctionDef random_uniform = test::function::RandomUniform();
+  random_uniform.mutable_signature()->set_name("MyRandomUniform");
+
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("y1", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("y2", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("y3", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("z1", "Identity", {"y1"}, {{"T", DT_FLOAT}}),
+       NDef("z2", "Identity", {"y2"}, {{"T", DT_FLOAT}}),
+       NDef("z3", "Identity", {"y3"}, {{"T", DT_FLOAT}}),
+       // Calls to a function with side effects are not deduped.
+       NDef("r1", "MyRandomUniform", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("r2", "MyRandomUniform", {"x"}, {{"T", DT_FLOAT}})},
+      {test::function::XTimesTwo(), x_times_two_copy, random_uniform});
+  item.fetch = {"z1", "z2", "z3", "r1", "r2"};
+
+  ArithmeticOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  NodeMap node_map(&output);
+
+  EXPECT_NE(node_map.GetNode("y1"), nullptr);
+  EXPECT_EQ(node_map.GetNode("y2"), nullptr);
+  EXPECT_EQ(node_map.GetNode("y3"), nullptr);
+  for (const string& fetch : {"z1", "z2", "z3"}) {
+    const NodeDef* z = node_map.GetNode(fetch);
+    ASSERT_NE(z, nullptr);
+    ASSERT_EQ(z->input_size(), 1);
+    EXPECT_EQ(z->input(0), "y1");
+  }
+  EXPECT_NE(node_map.GetNode("r1"), nullptr);
+  EXPECT_NE(node_map.GetNode("r2"), nullptr);
+}
+
 TEST_F(ArithmeticOptimizerTest, ReplaceMulWithSquare) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output c = ops::Const(s.WithOpName("c"), {1.0f, 2.0f}, {1, 2});
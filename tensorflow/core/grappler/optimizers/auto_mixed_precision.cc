@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/env_var.h"
 
@@ -48,6 +49,7 @@ const std::pair<int, int> kMinGPUArch = {7, 0};
 
 const char kSuffix[] = "AutoMixedPrecision";
 const char kCastToFp16[] = "CastToFp16";
+const char kCastToBf16[] = "CastToBf16";
 const char kCastToFp32[] = "CastToFp32";
 
 // Instances of this class represent unique type attribute identifiers within a
@@ -833,9 +835,12 @@ DataTypeSet AllowedDataTypes(const OpDef& op_def, const TypeAttrId& t_attr_id) {
   return AllowedDataTypes(*attr_def);
 }
 
+// Builds a cast between float32 and `f16_type` (DT_HALF or DT_BFLOAT16).
 NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_fp16,
-                      const string& device) {
-  const char* cast_string = to_fp16 ? kCastToFp16 : kCastToFp32;
+                      DataType f16_type, const string& device) {
+  const char* cast_string =
+      !to_fp16 ? kCastToFp32
+               : (f16_type == DT_BFLOAT16 ? kCastToBf16 : kCastToFp16);
   string name = strings::StrCat(src.node->name(), "-", src.port_id, "-",
                                 cast_string, "-", kSuffix);
   NodeDef node;
@@ -843,8 +848,8 @@ NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_fp16,
   node.set_op("Cast");
   node.set_device(device);
   node.add_input(strings::StrCat(src.node->name(), ":", src.port_id));
-  (*node.mutable_attr())["SrcT"].set_type(to_fp16 ? DT_FLOAT : DT_HALF);
-  (*node.mutable_attr())["DstT"].set_type(to_fp16 ? DT_HALF : DT_FLOAT);
+  (*node.mutable_attr())["SrcT"].set_type(to_fp16 ? DT_FLOAT : f16_type);
+  (*node.mutable_attr())["DstT"].set_type(to_fp16 ? f16_type : DT_FLOAT);
   (*node.mutable_attr())["Truncate"].set_b(false);
   return node;
 }
@@ -902,12 +907,17 @@ class AutoMixedPrecisionImpl {
  public:
   AutoMixedPrecisionImpl(Cluster* cluster,
                          const std::unordered_set<string>& nodes_to_preserve,
-                         GraphDef* graph, string id)
+                         GraphDef* graph, string id,
+                         AutoMixedPrecisionMode mode, bool ignore_performance)
       : virtual_placer_(cluster->GetDevices()),
         nodes_to_preserve_(nodes_to_preserve),
         graph_(graph),
         id_(id),
-        graph_view_(graph) {}
+        graph_view_(graph),
+        mode_(mode),
+        ignore_performance_(ignore_performance),
+        target_dtype_(mode == AutoMixedPrecisionMode::CPU ? DT_BFLOAT16
+                                                          : DT_HALF) {}
 
   Status Optimize();
 
@@ -922,7 +932,7 @@ class AutoMixedPrecisionImpl {
   Status PrintDebugLogs(bool preop, size_t timestamp);
   void LogSkippedNode(const NodeDef& node) const;
   bool MustPreserve(const NodeDef& node) const;
-  bool IsOnGPU(const NodeDef& node) const;
+  bool IsOnDevice(const NodeDef& node, const string& device_type) const;
   bool IsOnSuitableGPUArch(const NodeDef& node) const;
   bool ShouldProcess(const NodeDef& node) const;
   bool NodeHasFP16KernelForTypeAttr(const NodeDef& node, TypeAttrId taid) const;
@@ -966,6 +976,10 @@ class AutoMixedPrecisionImpl {
   gtl::FlatSet<string> fp16_graylist_;
   gtl::FlatSet<string> fp16_clearlist_;
   absl::flat_hash_set<const NodeDef*> should_process_nodes_;
+  AutoMixedPrecisionMode mode_;
+  bool ignore_performance_;
+  // The reduced precision type that the nodes are converted to.
+  DataType target_dtype_;
 };
 
 bool AutoMixedPrecisionImpl::NodeHasFP16KernelForTypeAttr(
@@ -975,7 +989,7 @@ bool AutoMixedPrecisionImpl::NodeHasFP16KernelForTypeAttr(
     string device_name = virtual_placer_.get_canonical_device_name(node);
     node_copy.set_device(device_name);
   }
-  if (!SetDataType(&node_copy, taid, DataType::DT_HALF)) {
+  if (!SetDataType(&node_copy, taid, target_dtype_)) {
     return false;
   }
   return IsKernelRegisteredForNode(node_copy).ok();
@@ -1012,19 +1026,19 @@ Status AutoMixedPrecisionImpl::PrintDebugLogs(bool preop, size_t timestamp) {
                          strings::StrCat("paintbuckets", suffix, ".txt"));
     f.open(fname.c_str(), std::fstream::out);
     f << "WhiteList:\n";
-    for (auto x : AutoMixedPrecisionLists::WhiteList()) {
+    for (auto x : fp16_whitelist_) {
       f << x << "\n";
     }
     f << "\nBlackList:\n";
-    for (auto x : AutoMixedPrecisionLists::BlackList()) {
+    for (auto x : fp16_blacklist_) {
       f << x << "\n";
     }
     f << "\nGrayList:\n";
-    for (auto x : AutoMixedPrecisionLists::GrayList()) {
+    for (auto x : fp16_graylist_) {
       f << x << "\n";
     }
     f << "\nClearList:\n";
-    for (auto x : AutoMixedPrecisionLists::ClearList()) {
+    for (auto x : fp16_clearlist_) {
       f << x << "\n";
     }
     f.close();
@@ -1038,14 +1052,18 @@ void AutoMixedPrecisionImpl::LogSkippedNode(const NodeDef& node) const {
           << " because it "
           << (MustPreserve(node)
                   ? "must be preserved"
-                  : "is not on the GPU, or the GPU arch is not suitable");
+                  : (mode_ == AutoMixedPrecisionMode::CPU
+                         ? "is not on the CPU"
+                         : "is not on the GPU, or the GPU arch is not "
+                           "suitable"));
 }
 
 bool AutoMixedPrecisionImpl::MustPreserve(const NodeDef& node) const {
   return nodes_to_preserve_.count(node.name());
 }
 
-bool AutoMixedPrecisionImpl::IsOnGPU(const NodeDef& node) const {
+bool AutoMixedPrecisionImpl::IsOnDevice(const NodeDef& node,
+                                        const string& device_type) const {
   string device_name;
   if (node.device().empty()) {
     device_name = virtual_placer_.get_canonical_device_name(node);
@@ -1056,7 +1074,7 @@ bool AutoMixedPrecisionImpl::IsOnGPU(const NodeDef& node) const {
   string not_used;
   if (DeviceNameUtils::SplitDeviceName(device_name, &not_used, &device) &&
       absl::StrContains(absl::AsciiStrToLower(device),
-                        absl::AsciiStrToLower(DEVICE_GPU))) {
+                        absl::AsciiStrToLower(device_type))) {
     return true;
   }
   return false;
@@ -1099,7 +1117,7 @@ bool AutoMixedPrecisionImpl::SupportsFloat16(
       OpRegistry::Global()->LookUpOpDef(node_type.node->op(), &op_def);
   if (!status.ok()) return false;
   return AllowedDataTypes(*op_def, node_type.type_attr)
-             .Contains(DataType::DT_HALF) &&
+             .Contains(target_dtype_) &&
          NodeHasFP16KernelForTypeAttr(*node_type.node, node_type.type_attr);
 }
 
@@ -1148,10 +1166,17 @@ Status AutoMixedPrecisionImpl::Optimize() {
   optimization_level = absl::AsciiStrToUpper(optimization_level);
   force_all_fp16_ = optimization_level == "UNSAFE_FORCE_ALL";
 
-  fp16_whitelist_ = AutoMixedPrecisionLists::WhiteList();
-  fp16_blacklist_ = AutoMixedPrecisionLists::BlackList();
-  fp16_graylist_ = AutoMixedPrecisionLists::GrayList();
-  fp16_clearlist_ = AutoMixedPrecisionLists::ClearList();
+  if (mode_ == AutoMixedPrecisionMode::CPU) {
+    fp16_whitelist_ = AutoMixedPrecisionListsCpu::WhiteList();
+    fp16_blacklist_ = AutoMixedPrecisionListsCpu::BlackList();
+    fp16_graylist_ = AutoMixedPrecisionListsCpu::GrayList();
+    fp16_clearlist_ = AutoMixedPrecisionListsCpu::ClearList();
+  } else {
+    fp16_whitelist_ = AutoMixedPrecisionLists::WhiteList();
+    fp16_blacklist_ = AutoMixedPrecisionLists::BlackList();
+    fp16_graylist_ = AutoMixedPrecisionLists::GrayList();
+    fp16_clearlist_ = AutoMixedPrecisionLists::ClearList();
+  }
   TF_RETURN_IF_ERROR(ValidateLists(fp16_whitelist_, fp16_blacklist_,
                                    fp16_graylist_, fp16_clearlist_));
 
@@ -1160,8 +1185,12 @@ Status AutoMixedPrecisionImpl::Optimize() {
 
   VLOG(2) << "Identifying nodes that should be processed";
   for (const NodeDef& node : graph_->node()) {
-    if (!MustPreserve(node) && IsOnGPU(node) &&
-        (ShouldIgnorePerformance() || IsOnSuitableGPUArch(node))) {
+    const bool on_target_device =
+        mode_ == AutoMixedPrecisionMode::CPU
+            ? IsOnDevice(node, DEVICE_CPU)
+            : IsOnDevice(node, DEVICE_GPU) &&
+                  (ignore_performance_ || IsOnSuitableGPUArch(node));
+    if (!MustPreserve(node) && on_target_device) {
       should_process_nodes_.insert(&node);
     } else {
       LogSkippedNode(node);
@@ -1318,6 +1347,11 @@ void AutoMixedPrecisionImpl::AddWhitelistOps(
   for (int root_idx = 0; root_idx < graph_type_view_.num_nodes(); ++root_idx) {
     const NodeTypeId& root = *graph_type_view_.GetNode(root_idx);
     if (!ShouldProcess(*root.node)) continue;
+    // Unlike the GPUs, the CPUs have bfloat16 kernels for few ops, and only
+    // for some types.
+    if (mode_ == AutoMixedPrecisionMode::CPU && !SupportsFloat16(root)) {
+      continue;
+    }
     bool force_white = force_all_fp16_ && CanForceFP16(*root.node);
     if (fp16_whitelist_.count(root.node->op()) || force_white) {
       bool inserted = white_set->insert(root_idx).second;
@@ -1675,8 +1709,9 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
       bool src_is_white = white_set.count(node_type_idx);
       if (src_is_white) {
         VLOG(1) << "Changing type " << type_attr.DebugString() << " of "
-                << node->op() << " node " << node->name() << " to DT_HALF";
-        if (!SetDataType(node, type_attr, DT_HALF)) {
+                << node->op() << " node " << node->name() << " to "
+                << DataTypeString(target_dtype_);
+        if (!SetDataType(node, type_attr, target_dtype_)) {
           return errors::Internal("Failed to set type attribute");
         }
         ++num_nodes_changed;
@@ -1703,11 +1738,13 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
             if (!added_cast_node) {
               bool to_fp16 = dst_is_white;
               VLOG(1) << "Inserting cast to "
-                      << (to_fp16 ? "DT_HALF" : "DT_FLOAT") << " at "
+                      << DataTypeString(to_fp16 ? target_dtype_ : DT_FLOAT)
+                      << " at "
                       << src.node->op() << " " << src.node->name() << ":"
                       << src.port_id;
               added_cast_node = graph_view_.AddNode(
-                  BuildCastNode(src, to_fp16, src.node->device()));
+                  BuildCastNode(src, to_fp16, target_dtype_,
+                                src.node->device()));
               if (to_fp16 && !IsConstant(*node) && !IsVariable(*node) &&
                   !IsIdentityAfterVariable(*node)) {
                 ++num_nonvar_casts_to_fp16;
@@ -1720,9 +1757,12 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
       }
     }
   }
+  const char* precision =
+      target_dtype_ == DT_BFLOAT16 ? "bfloat16" : "float16";
   LOG(INFO) << "Converted " << num_nodes_changed << "/" << num_nodes_preop
-            << " nodes to float16 precision using " << num_nonvar_casts_to_fp16
-            << " cast(s) to float16 (excluding Const and Variable casts)";
+            << " nodes to " << precision << " precision using "
+            << num_nonvar_casts_to_fp16 << " cast(s) to " << precision
+            << " (excluding Const and Variable casts)";
   return Status::OK();
 }
 
@@ -1740,6 +1780,16 @@ int GetNumGPUs(const Cluster& cluster,
   return num_gpus;
 }
 
+int GetNumCPUs(const Cluster& cluster) {
+  int num_cpus = 0;
+  for (const auto& device : cluster.GetDevices()) {
+    if (device.second.type() == "CPU") {
+      num_cpus++;
+    }
+  }
+  return num_cpus;
+}
+
 }  // end namespace
 
 Status AutoMixedPrecision::Optimize(Cluster* cluster, const GrapplerItem& item,
@@ -1751,18 +1801,32 @@ Status AutoMixedPrecision::Optimize(Cluster* cluster, const GrapplerItem& item,
   // Start by copying input graph to output.
   *output = item.graph;
 
-  int num_gpus = ShouldIgnorePerformance() ? GetNumGPUs(*cluster)
-                                           : GetNumGPUs(*cluster, kMinGPUArch);
-  if (num_gpus < 1) {
-    // AutoMixedPrecision is currently only tuned for GPU.
-    LOG(WARNING) << "No (suitable) GPUs detected, skipping " << name()
-                 << " graph optimizer";
-    return Status::OK();
+  const bool ignore_performance =
+      ignore_performance_ || ShouldIgnorePerformance();
+  if (mode_ == AutoMixedPrecisionMode::CPU) {
+    // The conversions between float32 and bfloat16 are only cheap enough on
+    // the hosts with the AVX-512 BF16 instructions.
+    if (GetNumCPUs(*cluster) < 1 ||
+        !(ignore_performance ||
+          port::TestCPUFeature(port::CPUFeature::AVX512_BF16))) {
+      LOG(WARNING) << "No CPUs with AVX-512 BF16 instructions detected, "
+                   << "skipping " << name() << " graph optimizer";
+      return Status::OK();
+    }
+  } else {
+    int num_gpus = ignore_performance ? GetNumGPUs(*cluster)
+                                      : GetNumGPUs(*cluster, kMinGPUArch);
+    if (num_gpus < 1) {
+      // AutoMixedPrecision is currently only tuned for GPU.
+      LOG(WARNING) << "No (suitable) GPUs detected, skipping " << name()
+                   << " graph optimizer";
+      return Status::OK();
+    }
   }
 
   // Optimize the output graph in-place.
   AutoMixedPrecisionImpl optimizer(cluster, item.NodesToPreserve(), output,
-                                   item.id);
+                                   item.id, mode_, ignore_performance);
   if (item.id == "tf_graph") {
     LOG(INFO) << "Running " << name() << " graph optimizer";
   } else {
@@ -22,22 +22,43 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
-// Convert data types to float16 where appropriate to improve performance on
-// GPUs.
+enum class AutoMixedPrecisionMode {
+  // Convert to float16 the ops placed on GPUs.
+  CUDA,
+  // Convert to bfloat16 the ops placed on CPUs.
+  CPU,
+};
+
+// Convert data types to float16 (on GPUs) or bfloat16 (on CPUs) where
+// appropriate to improve performance.
 class AutoMixedPrecision : public GraphOptimizer {
  public:
+  // If `ignore_performance` is true, the graph is rewritten even if the
+  // devices have no fast float16 or bfloat16 instructions, like when the
+  // TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_IGNORE_PERFORMANCE environment
+  // variable is set. This is useful to test the numerical effects.
   explicit AutoMixedPrecision(
-      RewriterConfig::Toggle opt_level = RewriterConfig::ON) {}
+      RewriterConfig::Toggle opt_level = RewriterConfig::ON,
+      AutoMixedPrecisionMode mode = AutoMixedPrecisionMode::CUDA,
+      bool ignore_performance = false)
+      : mode_(mode), ignore_performance_(ignore_performance) {}
 
   ~AutoMixedPrecision() override {}
 
-  string name() const override { return "auto_mixed_precision"; };
+  string name() const override {
+    return mode_ == AutoMixedPrecisionMode::CPU ? "auto_mixed_precision_cpu"
+                                                : "auto_mixed_precision";
+  };
 
   Status Optimize(Cluster* cluster, const GrapplerItem& item,
                   GraphDef* output) override;
 
   void Feedback(Cluster* cluster, const GrapplerItem& item,
                 const GraphDef& optimize_output, double result) override;
+
+ private:
+  const AutoMixedPrecisionMode mode_;
+  const bool ignore_performance_;
 };
 
 }  // end namespace grappler
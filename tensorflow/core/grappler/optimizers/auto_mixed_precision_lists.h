@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/util/env_var.h"
 
 #if GOOGLE_CUDA
@@ -29,7 +30,7 @@ namespace tensorflow {
 namespace grappler {
 
 class AutoMixedPrecisionLists {
- private:
+ protected:
   static void UpdateList(gtl::FlatSet<string>* list, const string& to_add,
                          const string& to_remove) {
     for (auto x : str_util::Split(to_add, ",")) {
@@ -295,6 +296,56 @@ class AutoMixedPrecisionLists {
   }
 };
 
+// The lists of the conversion to bfloat16 of the ops placed on CPUs. Only the
+// whitelist differs from the conversion to float16: bfloat16 has the range of
+// float32 but an even shorter mantissa than float16, so the same ops are
+// numerically-dangerous. The ops of every list are only converted if they have
+// a bfloat16 CPU kernel. The lists can be updated with the
+// TF_AUTO_MIXED_PRECISION_CPU_GRAPH_REWRITE_<LIST>_ADD/REMOVE variables, in
+// addition to the variables of the float16 lists.
+class AutoMixedPrecisionListsCpu : public AutoMixedPrecisionLists {
+ private:
+  static gtl::FlatSet<string> UpdateCpuList(gtl::FlatSet<string> list,
+                                            const string& list_name) {
+    const string prefix = strings::StrCat(
+        "TF_AUTO_MIXED_PRECISION_CPU_GRAPH_REWRITE_", list_name);
+    string to_add, to_remove;
+    TF_CHECK_OK(ReadStringFromEnvVar(strings::StrCat(prefix, "_ADD"), "",
+                                     &to_add));
+    TF_CHECK_OK(ReadStringFromEnvVar(strings::StrCat(prefix, "_REMOVE"), "",
+                                     &to_remove));
+    UpdateList(&list, to_add, to_remove);
+    return list;
+  }
+
+ public:
+  // Returns the set of ops that dominate the memory traffic and the compute
+  // time of CPU graphs, and are always converted to bfloat16.
+  static gtl::FlatSet<string> WhiteList() {
+    return UpdateCpuList(
+        gtl::FlatSet<string>{
+            "BatchMatMul",
+            "Conv2D",
+            "Conv2DBackpropFilter",
+            "Conv2DBackpropInput",
+            "MatMul",
+        },
+        "WHITELIST");
+  }
+
+  static gtl::FlatSet<string> GrayList() {
+    return UpdateCpuList(AutoMixedPrecisionLists::GrayList(), "GRAYLIST");
+  }
+
+  static gtl::FlatSet<string> BlackList() {
+    return UpdateCpuList(AutoMixedPrecisionLists::BlackList(), "BLACKLIST");
+  }
+
+  static gtl::FlatSet<string> ClearList() {
+    return UpdateCpuList(AutoMixedPrecisionLists::ClearList(), "CLEARLIST");
+  }
+};
+
 }  // end namespace grappler
 }  // end namespace tensorflow
 
@@ -13,12 +13,6 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-// Currently, this test only passes when TensorFlow passes with CUDA, because
-// otherwise the optimizer will not turn clearlist nodes to float16. When
-// looking at clearlist nodes, this optimizer checks if the nodes have a float16
-// GPU OpKernel, but without CUDA there are no GPU OpKernels at all.
-#if GOOGLE_CUDA
-
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 
 #include <utility>
@@ -43,6 +37,77 @@ namespace tensorflow {
 namespace grappler {
 namespace {
 
+class AutoMixedPrecisionCpuTest : public GrapplerTest {
+ protected:
+  void SetUp() override {
+    DeviceProperties device_properties;
+    device_properties.set_type("CPU");
+    virtual_cluster_.reset(
+        new VirtualCluster({{"/CPU:0", device_properties}}));
+    TF_CHECK_OK(virtual_cluster_->Provision());
+  }
+
+  void TearDown() override { TF_CHECK_OK(virtual_cluster_->Shutdown()); }
+
+  std::unique_ptr<Cluster> virtual_cluster_;
+};
+
+TEST_F(AutoMixedPrecisionCpuTest, Simple) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output blk1 = ops::Exp(s.WithOpName("blk1"), input);
+  Output wht1 = ops::MatMul(s.WithOpName("wht1"), blk1, blk1);
+  Output blk2 = ops::Log(s.WithOpName("blk2"), wht1);
+  Output fetch1 = ops::Identity(s.WithOpName("fetch1"), blk2);
+  // There is no bfloat16 CPU kernel for Conv2D.
+  Output image = ops::Const(s.WithOpName("image"), 1.f, {1, 4, 4, 1});
+  Output filter = ops::Const(s.WithOpName("filter"), 2.f, {1, 1, 1, 1});
+  Output wht2 = ops::Conv2D(s.WithOpName("wht2"), image, filter, {1, 1, 1, 1},
+                            "SAME");
+  Output fetch2 = ops::Identity(s.WithOpName("fetch2"), wht2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch1", "fetch2"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+
+  // Run the optimizer even if the host doesn't have the AVX-512 BF16
+  // instructions.
+  AutoMixedPrecision optimizer(RewriterConfig::ON, AutoMixedPrecisionMode::CPU,
+                               /*ignore_performance=*/true);
+  EXPECT_EQ(optimizer.name(), "auto_mixed_precision_cpu");
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  GraphView output_view(&output);
+  EXPECT_EQ(output.node_size(), item.graph.node_size() + 2);
+  EXPECT_EQ(output_view.GetNode("blk1")->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("wht1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("blk2")->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("wht2")->attr().at("T").type(), DT_FLOAT);
+  const NodeDef* cast =
+      output_view.GetNode("blk1-0-CastToBf16-AutoMixedPrecision");
+  ASSERT_NE(cast, nullptr);
+  EXPECT_EQ(cast->attr().at("DstT").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("wht1")->input(0), cast->name());
+  EXPECT_EQ(output_view.GetNode("wht1")->input(1), cast->name());
+
+  auto tensors = EvaluateNodes(output, item.fetch);
+  EXPECT_EQ(tensors.size(), tensors_expected.size());
+  EXPECT_EQ(tensors.size(), item.fetch.size());
+  for (int i = 0; i < item.fetch.size(); ++i) {
+    test::ExpectClose(tensors_expected[i], tensors[i], -1, 1e-2);
+  }
+}
+
+// Currently, the tests below only pass when TensorFlow passes with CUDA,
+// because otherwise the optimizer will not turn clearlist nodes to float16.
+// When looking at clearlist nodes, this optimizer checks if the nodes have a
+// float16 GPU OpKernel, but without CUDA there are no GPU OpKernels at all.
+#if GOOGLE_CUDA
+
 const std::pair<int, int> kMinGPUArch = {7, 0};
 
 class AutoMixedPrecisionTest : public GrapplerTest {
@@ -664,8 +729,8 @@ TEST_F(AutoMixedPrecisionTest, StackV2) {
             DT_FLOAT);
 }
 
+#endif  // GOOGLE_CUDA
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
-
-#endif  // GOOGLE_CUDA
@@ -0,0 +1,179 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cost_based_optimizer.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/analytical_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/virtual_scheduler.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+CostBasedOptimizer::CostBasedOptimizer(
+    std::vector<std::unique_ptr<GraphOptimizer>> candidates,
+    int64 time_budget_usec)
+    : candidates_(std::move(candidates)), time_budget_usec_(time_budget_usec) {}
+
+Status CostBasedOptimizer::EstimateCost(Cluster* cluster,
+                                        const GrapplerItem& item,
+                                        const GraphDef& graph,
+                                        PlanCost* cost) const {
+  AnalyticalCostEstimator estimator(cluster, /*use_static_shapes=*/true,
+                                    /*use_aggressive_shape_inference=*/false);
+  TF_RETURN_IF_ERROR(estimator.Initialize(item));
+  Costs costs;
+  RunMetadata run_metadata;
+  TF_RETURN_IF_ERROR(estimator.PredictCosts(graph, &run_metadata, &costs));
+
+  cost->step_time = costs.execution_time;
+  cost->num_inaccurate_nodes = 0;
+  for (const auto& node : run_metadata.cost_graph().node()) {
+    if (node.inaccurate()) ++cost->num_inaccurate_nodes;
+  }
+  cost->peak_memory = 0;
+  cost->fits_in_memory = true;
+  const auto& devices = cluster->GetDevices();
+  for (const auto& device_memory :
+       estimator.GetScheduler()->GetPeakMemoryUsage()) {
+    cost->peak_memory = std::max(cost->peak_memory, device_memory.second);
+    auto it = devices.find(device_memory.first);
+    if (it != devices.end() && it->second.memory_size() > 0 &&
+        device_memory.second > it->second.memory_size()) {
+      cost->fits_in_memory = false;
+    }
+  }
+  return Status::OK();
+}
+
+bool CostBasedOptimizer::IsBetter(const PlanCost& cost,
+                                  const PlanCost& best_cost) {
+  // The cost of ops without a cost function (e.g. the fused ops created by the
+  // remapper, which is therefore not a candidate) is only a rough guess, which
+  // could make a rewrite look better than it is. Don't trust a plan that is
+  // estimated less accurately than the current one.
+  if (cost.num_inaccurate_nodes > best_cost.num_inaccurate_nodes) {
+    return false;
+  }
+  if (cost.fits_in_memory != best_cost.fits_in_memory) {
+    return cost.fits_in_memory;
+  }
+  if (!cost.fits_in_memory) {
+    return cost.peak_memory < best_cost.peak_memory;
+  }
+  return cost.step_time < best_cost.step_time;
+}
+
+Status CostBasedOptimizer::ApplyAllCandidates(Cluster* cluster,
+                                              const GrapplerItem& item,
+                                              GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  for (const auto& candidate : candidates_) {
+    GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+    GrapplerItem current = item.WithGraph(GraphDef(*optimized_graph));
+    GraphDef candidate_graph;
+    candidate->set_deadline_usec(deadline_usec());
+    Status status = candidate->Optimize(cluster, current, &candidate_graph);
+    if (status.ok()) {
+      optimized_graph->Swap(&candidate_graph);
+    } else {
+      VLOG(2) << candidate->name() << " failed: " << status;
+    }
+  }
+  return Status::OK();
+}
+
+Status CostBasedOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                    GraphDef* optimized_graph) {
+  PlanCost best_cost;
+  if (cluster == nullptr || cluster->GetDevices().empty() ||
+      !EstimateCost(cluster, item, item.graph, &best_cost).ok()) {
+    VLOG(1) << "Can't estimate the cost of grappler item " << item.id
+            << ", applying all the candidate optimizers";
+    return ApplyAllCandidates(cluster, item, optimized_graph);
+  }
+
+  const uint64 start_usec = Env::Default()->NowMicros();
+  const auto budget_exhausted = [this, start_usec]() {
+    return DeadlineExceeded() ||
+           (time_budget_usec_ > 0 &&
+            static_cast<int64>(Env::Default()->NowMicros() - start_usec) >
+                time_budget_usec_);
+  };
+
+  GraphDef best_graph = item.graph;
+  std::vector<bool> applied(candidates_.size(), false);
+  bool improved = true;
+  while (improved && !budget_exhausted()) {
+    improved = false;
+    for (int i = 0; i < candidates_.size(); ++i) {
+      if (applied[i]) continue;
+      if (budget_exhausted()) break;
+
+      GraphOptimizer* candidate = candidates_[i].get();
+      GrapplerItem current = item.WithGraph(GraphDef(best_graph));
+      GraphDef candidate_graph;
+      candidate->set_deadline_usec(deadline_usec());
+      Status status = candidate->Optimize(cluster, current, &candidate_graph);
+      if (!status.ok()) {
+        VLOG(2) << candidate->name() << " failed: " << status;
+        continue;
+      }
+      if (AreSerializedProtosEqual(candidate_graph, best_graph)) continue;
+
+      PlanCost cost;
+      status = EstimateCost(cluster, item, candidate_graph, &cost);
+      if (!status.ok()) {
+        VLOG(2) << "Can't estimate the cost of the graph rewritten by "
+                << candidate->name() << ": " << status;
+        continue;
+      }
+      VLOG(2) << candidate->name() << ": step time "
+              << cost.step_time.count() << "ns (best "
+              << best_cost.step_time.count() << "ns), peak memory "
+              << cost.peak_memory << " bytes (best " << best_cost.peak_memory
+              << " bytes), " << cost.num_inaccurate_nodes
+              << " inaccurately estimated nodes (best "
+              << best_cost.num_inaccurate_nodes << ")";
+      if (!IsBetter(cost, best_cost)) continue;
+
+      VLOG(1) << "Keeping the rewrite proposed by " << candidate->name();
+      best_graph.Swap(&candidate_graph);
+      best_cost = cost;
+      applied[i] = true;
+      improved = true;
+    }
+  }
+
+  optimized_graph->Swap(&best_graph);
+  return Status::OK();
+}
+
+void CostBasedOptimizer::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                  const GraphDef& optimized_graph,
+                                  double result) {
+  // Nothing to do for CostBasedOptimizer.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,90 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_OPTIMIZER_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/grappler/costs/cost_estimator.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Searches for the best combination of the rewrites proposed by a set of
+// heuristic optimizers, using the analytical cost model.
+//
+// Each candidate optimizer (e.g. the layout optimizer or the memory optimizer
+// with recomputation) proposes a rewrite of the best plan found so far. The
+// rewritten graph is simulated by the VirtualScheduler, and is kept only if it
+// is better than the current plan. A plan with more nodes whose cost is
+// inaccurate (e.g. ops without a cost function) is never better; otherwise:
+//   - a plan that fits in the memory of every device is better than one that
+//     doesn't,
+//   - among plans that fit, the one with the lowest step time is better,
+//   - among plans that don't fit, the one with the lowest peak memory is
+//     better.
+// The search is greedy: it keeps trying the candidates that were not applied
+// yet until none of them improves the plan, or the time budget is exhausted.
+//
+// Without a cluster to simulate the graph on, or if the cost of the original
+// graph can't be estimated, all the candidates are applied in order, like the
+// meta optimizer would do.
+class CostBasedOptimizer : public GraphOptimizer {
+ public:
+  // `time_budget_usec` bounds the duration of the search; 0 means that it's
+  // only bounded by the deadline of the optimizer.
+  CostBasedOptimizer(std::vector<std::unique_ptr<GraphOptimizer>> candidates,
+                     int64 time_budget_usec);
+  ~CostBasedOptimizer() override {}
+
+  string name() const override { return "cost_based_optimizer"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+
+ private:
+  // Estimated cost of running a graph.
+  struct PlanCost {
+    Costs::Duration step_time;
+    // Highest peak memory usage over all the devices.
+    int64 peak_memory = 0;
+    bool fits_in_memory = true;
+    // Number of nodes whose cost could only be guessed, e.g. because their op
+    // has no cost function.
+    int num_inaccurate_nodes = 0;
+  };
+
+  Status EstimateCost(Cluster* cluster, const GrapplerItem& item,
+                      const GraphDef& graph, PlanCost* cost) const;
+  static bool IsBetter(const PlanCost& cost, const PlanCost& best_cost);
+
+  // Applies all the candidates in order, without evaluating them.
+  Status ApplyAllCandidates(Cluster* cluster, const GrapplerItem& item,
+                            GraphDef* optimized_graph);
+
+  std::vector<std::unique_ptr<GraphOptimizer>> candidates_;
+  const int64 time_budget_usec_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_OPTIMIZER_H_
@@ -0,0 +1,188 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cost_based_optimizer.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/device_properties.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kDevice[] = "/job:localhost/replica:0/task:0/cpu:0";
+
+// Feeds "b" directly from "x", which removes the MatMul "a" from the graph.
+class SkipMatMulOptimizer : public GraphOptimizer {
+ public:
+  string name() const override { return "skip_matmul"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    *optimized_graph = item.graph;
+    for (NodeDef& node : *optimized_graph->mutable_node()) {
+      if (node.name() == "b") node.set_input(0, "x");
+    }
+    return Status::OK();
+  }
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+// Inserts an extra MatMul in front of "out".
+class AddMatMulOptimizer : public GraphOptimizer {
+ public:
+  string name() const override { return "add_matmul"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    *optimized_graph = item.graph;
+    for (NodeDef& node : *optimized_graph->mutable_node()) {
+      if (node.name() == "out") node.set_input(0, "extra");
+    }
+    NodeDef* extra = optimized_graph->add_node();
+    extra->set_name("extra");
+    extra->set_op("MatMul");
+    extra->set_device(kDevice);
+    extra->add_input("b");
+    extra->add_input("x");
+    (*extra->mutable_attr())["T"].set_type(DT_FLOAT);
+    (*extra->mutable_attr())["transpose_a"].set_b(false);
+    (*extra->mutable_attr())["transpose_b"].set_b(false);
+    return Status::OK();
+  }
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+// Replaces the MatMul "a" with a MatrixInverse, which has no cost function:
+// its estimated cost is much lower than the MatMul's, but inaccurate.
+class InverseMatMulOptimizer : public GraphOptimizer {
+ public:
+  string name() const override { return "inverse_matmul"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    *optimized_graph = item.graph;
+    for (NodeDef& node : *optimized_graph->mutable_node()) {
+      if (node.name() != "a") continue;
+      node.set_op("MatrixInverse");
+      node.mutable_input()->RemoveLast();
+      node.clear_attr();
+      (*node.mutable_attr())["T"].set_type(DT_FLOAT);
+      (*node.mutable_attr())["adjoint"].set_b(false);
+    }
+    return Status::OK();
+  }
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+class CostBasedOptimizerTest : public GrapplerTest {
+ protected:
+  void SetUp() override {
+    DeviceProperties cpu_device;
+    cpu_device.set_type("CPU");
+    cpu_device.set_frequency(1000);
+    cpu_device.set_num_cores(4);
+    cpu_device.set_bandwidth(32);
+    std::unordered_map<string, DeviceProperties> devices;
+    devices[kDevice] = cpu_device;
+    cluster_.reset(new VirtualCluster(devices));
+  }
+
+  // out = Identity(MatMul(MatMul(x, x), x))
+  GrapplerItem CreateItem() {
+    Scope s = Scope::NewRootScope().WithDevice(kDevice);
+    Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                                ops::Placeholder::Shape({256, 256}));
+    Output a = ops::MatMul(s.WithOpName("a"), x, x);
+    Output b = ops::MatMul(s.WithOpName("b"), a, x);
+    Output out = ops::Identity(s.WithOpName("out"), b);
+
+    GrapplerItem item;
+    item.fetch = {"out"};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    return item;
+  }
+
+  std::vector<std::unique_ptr<GraphOptimizer>> Candidates() {
+    std::vector<std::unique_ptr<GraphOptimizer>> candidates;
+    candidates.emplace_back(new AddMatMulOptimizer());
+    candidates.emplace_back(new SkipMatMulOptimizer());
+    return candidates;
+  }
+
+  std::unique_ptr<VirtualCluster> cluster_;
+};
+
+TEST_F(CostBasedOptimizerTest, KeepsRewritesThatLowerTheCost) {
+  GrapplerItem item = CreateItem();
+  CostBasedOptimizer optimizer(Candidates(), /*time_budget_usec=*/0);
+
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(cluster_.get(), item, &output));
+
+  NodeMap node_map(&output);
+  // The extra MatMul makes the step slower, skipping one makes it faster.
+  EXPECT_EQ(node_map.GetNode("extra"), nullptr);
+  ASSERT_NE(node_map.GetNode("out"), nullptr);
+  EXPECT_EQ(node_map.GetNode("out")->input(0), "b");
+  ASSERT_NE(node_map.GetNode("b"), nullptr);
+  EXPECT_EQ(node_map.GetNode("b")->input(0), "x");
+}
+
+TEST_F(CostBasedOptimizerTest, RejectsRewritesWithInaccurateCosts) {
+  GrapplerItem item = CreateItem();
+  std::vector<std::unique_ptr<GraphOptimizer>> candidates;
+  candidates.emplace_back(new InverseMatMulOptimizer());
+  CostBasedOptimizer optimizer(std::move(candidates), /*time_budget_usec=*/0);
+
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(cluster_.get(), item, &output));
+
+  NodeMap node_map(&output);
+  ASSERT_NE(node_map.GetNode("a"), nullptr);
+  EXPECT_EQ(node_map.GetNode("a")->op(), "MatMul");
+}
+
+TEST_F(CostBasedOptimizerTest, AppliesAllCandidatesWithoutCluster) {
+  GrapplerItem item = CreateItem();
+  CostBasedOptimizer optimizer(Candidates(), /*time_budget_usec=*/0);
+
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  NodeMap node_map(&output);
+  EXPECT_NE(node_map.GetNode("extra"), nullptr);
+  ASSERT_NE(node_map.GetNode("out"), nullptr);
+  EXPECT_EQ(node_map.GetNode("out")->input(0), "extra");
+  ASSERT_NE(node_map.GetNode("b"), nullptr);
+  EXPECT_EQ(node_map.GetNode("b")->input(0), "x");
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
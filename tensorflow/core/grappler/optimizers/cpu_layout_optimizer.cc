@@ -0,0 +1,417 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cpu_layout_optimizer.h"
+
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kSuffix[] = "CpuLayoutOptimizer";
+
+// Static dimensions of an NHWC tensor, but the batch size.
+struct NhwcDims {
+  int64 rows = -1;
+  int64 cols = -1;
+  int64 channels = -1;
+};
+
+bool GetNhwcDims(const OpInfo::TensorProperties& properties, NhwcDims* dims) {
+  const TensorShapeProto& shape = properties.shape();
+  if (shape.unknown_rank() || shape.dim_size() != 4) return false;
+  dims->rows = shape.dim(1).size();
+  dims->cols = shape.dim(2).size();
+  dims->channels = shape.dim(3).size();
+  return dims->rows > 0 && dims->cols > 0 && dims->channels > 0;
+}
+
+bool IsFullyDefined(const OpInfo::TensorProperties& properties, int rank) {
+  const TensorShapeProto& shape = properties.shape();
+  if (shape.unknown_rank() || shape.dim_size() != rank) return false;
+  for (const auto& dim : shape.dim()) {
+    if (dim.size() <= 0) return false;
+  }
+  return true;
+}
+
+bool IsOnCpu(const NodeDef& node, bool cluster_has_gpu) {
+  if (node.device().empty()) return !cluster_has_gpu;
+  DeviceNameUtils::ParsedName parsed_name;
+  return DeviceNameUtils::ParseFullName(node.device(), &parsed_name) &&
+         parsed_name.has_type &&
+         str_util::Lowercase(parsed_name.type) == "cpu";
+}
+
+bool HasFloatNhwcAttrs(const NodeDef& node) {
+  const auto& attr = node.attr();
+  if (!attr.count("T") || attr.at("T").type() != DT_FLOAT) return false;
+  return !attr.count("data_format") || attr.at("data_format").s() == "NHWC";
+}
+
+bool IsBlockableConv2D(const NodeDef& node, const GraphProperties& properties,
+                       int block_size) {
+  if (!IsConv2D(node) || !HasFloatNhwcAttrs(node)) return false;
+  const auto& attr = node.attr();
+  if (!attr.count("padding") || (attr.at("padding").s() != "SAME" &&
+                                 attr.at("padding").s() != "VALID")) {
+    return false;
+  }
+  if (attr.count("dilations")) {
+    for (int64 dilation : attr.at("dilations").list().i()) {
+      if (dilation != 1) return false;
+    }
+  }
+  const auto& inputs = properties.GetInputProperties(node.name());
+  NhwcDims input_dims;
+  return inputs.size() == 2 && GetNhwcDims(inputs[0], &input_dims) &&
+         input_dims.channels % block_size == 0 &&
+         IsFullyDefined(inputs[1], 4);
+}
+
+// Rewrites the graph, given the nodes that produce blocked outputs.
+class BlockedLayoutRewriter {
+ public:
+  BlockedLayoutRewriter(int block_size,
+                        const absl::flat_hash_map<string, NhwcDims>& blocked,
+                        const GraphProperties& properties, GraphDef* graph)
+      : block_size_(block_size),
+        blocked_(blocked),
+        properties_(properties),
+        graph_(graph) {
+    for (const NodeDef& node : graph->node()) {
+      graph_node_names_.insert(node.name());
+    }
+  }
+
+  static string BlockedName(const string& node_name) {
+    return strings::StrCat(node_name, "-Blocked-", kSuffix);
+  }
+
+  // Adds the blocked version of `node` to the graph.
+  void AddBlockedNode(const NodeDef& node) {
+    const auto& inputs = properties_.GetInputProperties(node.name());
+    NodeDef* blocked_node = graph_->add_node();
+    blocked_node->set_name(BlockedName(node.name()));
+    blocked_node->set_device(node.device());
+    auto* attr = blocked_node->mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+
+    NhwcDims input_dims;
+    GetNhwcDims(inputs[0], &input_dims);
+    blocked_node->add_input(BlockedInput(node.input(0), input_dims, node));
+
+    if (IsConv2D(node)) {
+      blocked_node->set_op("_BlockedConv2D");
+      blocked_node->add_input(BlockedFilter(node.input(1), inputs[1], node));
+      (*attr)["strides"] = node.attr().at("strides");
+      (*attr)["padding"] = node.attr().at("padding");
+      (*attr)["block_size"].set_i(block_size_);
+    } else if (IsBiasAdd(node)) {
+      // The bias is broadcast along the batch and spatial dimensions.
+      blocked_node->set_op("Add");
+      blocked_node->add_input(
+          BlockedBias(node.input(1), input_dims.channels, node));
+    } else {
+      blocked_node->set_op(node.op());
+    }
+
+    for (const string& input : node.input()) {
+      if (!IsControlInput(input)) continue;
+      const string input_node = NodeName(input);
+      blocked_node->add_input(AsControlDependency(
+          blocked_.count(input_node) ? BlockedName(input_node) : input_node));
+    }
+  }
+
+  // Turns `node` into the conversion of its blocked version back to NHWC, so
+  // that its fanouts are left untouched.
+  void ConvertBackToNhwc(NodeDef* node, const NhwcDims& dims) {
+    const string blocked_name = BlockedName(node->name());
+    const string prefix = strings::StrCat(node->name(), "-ToNHWC-", kSuffix);
+    // [N, C/b, H, W, b] -> [N, H, W, C/b, b] -> [N, H, W, C]
+    AddTranspose(prefix, blocked_name, {0, 2, 3, 1, 4}, node->device(),
+                 blocked_name);
+    const string shape_name = strings::StrCat(prefix, "/shape");
+    AddIntConst(shape_name, {-1, dims.rows, dims.cols, dims.channels},
+                node->device(), blocked_name);
+
+    node->set_op("Reshape");
+    node->clear_input();
+    node->add_input(prefix);
+    node->add_input(shape_name);
+    node->clear_attr();
+    auto* attr = node->mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["Tshape"].set_type(DT_INT32);
+  }
+
+ private:
+  // Returns the blocked version of the NHWC tensor `input` of `consumer`.
+  string BlockedInput(const string& input, const NhwcDims& dims,
+                      const NodeDef& consumer) {
+    if (blocked_.count(NodeName(input))) return BlockedName(NodeName(input));
+    // The prefix only depends on the tensor, so that "x" and "x:0" share
+    // their conversion.
+    const TensorId tensor = ParseTensorName(input);
+    const string prefix = strings::StrCat(tensor.node(), "-", tensor.index(),
+                                          "-ToBlocked-", kSuffix);
+    if (graph_node_names_.count(prefix)) return prefix;
+    const string control = string(tensor.node());
+    // [N, H, W, C] -> [N, H, W, C/b, b] -> [N, C/b, H, W, b]
+    AddReshape(strings::StrCat(prefix, "/Reshape"), input,
+               {-1, dims.rows, dims.cols, dims.channels / block_size_,
+                block_size_},
+               consumer.device(), control);
+    AddTranspose(prefix, strings::StrCat(prefix, "/Reshape"), {0, 3, 1, 2, 4},
+                 consumer.device(), control);
+    return prefix;
+  }
+
+  // Returns the blocked version of the HWIO filter `input` of `consumer`.
+  string BlockedFilter(const string& input,
+                       const OpInfo::TensorProperties& properties,
+                       const NodeDef& consumer) {
+    const TensorShapeProto& shape = properties.shape();
+    const TensorId tensor = ParseTensorName(input);
+    const string prefix = strings::StrCat(tensor.node(), "-", tensor.index(),
+                                          "-ToBlockedFilter-", kSuffix);
+    if (graph_node_names_.count(prefix)) return prefix;
+    const string control = string(tensor.node());
+    // [H, W, I, O] -> [H, W, I, O/b, b] -> [O/b, H, W, I, b]
+    AddReshape(strings::StrCat(prefix, "/Reshape"), input,
+               {shape.dim(0).size(), shape.dim(1).size(), shape.dim(2).size(),
+                shape.dim(3).size() / block_size_, block_size_},
+               consumer.device(), control);
+    AddTranspose(prefix, strings::StrCat(prefix, "/Reshape"), {3, 0, 1, 2, 4},
+                 consumer.device(), control);
+    return prefix;
+  }
+
+  // Returns the bias `input` of `consumer` reshaped to [C/b, 1, 1, b].
+  string BlockedBias(const string& input, int64 channels,
+                     const NodeDef& consumer) {
+    const TensorId tensor = ParseTensorName(input);
+    const string name = strings::StrCat(tensor.node(), "-", tensor.index(),
+                                        "-ToBlockedBias-", kSuffix);
+    if (graph_node_names_.count(name)) return name;
+    AddReshape(name, input, {channels / block_size_, 1, 1, block_size_},
+               consumer.device(), string(tensor.node()));
+    return name;
+  }
+
+  // The constants are anchored on `control` to stay in its frame.
+  void AddIntConst(const string& name, const std::vector<int64>& values,
+                   const string& device, const string& control) {
+    NodeDef* node = graph_->add_node();
+    graph_node_names_.insert(name);
+    node->set_name(name);
+    node->set_op("Const");
+    node->set_device(device);
+    node->add_input(AsControlDependency(control));
+    auto* attr = node->mutable_attr();
+    (*attr)["dtype"].set_type(DT_INT32);
+    Tensor value(DT_INT32, TensorShape({static_cast<int64>(values.size())}));
+    for (int i = 0; i < values.size(); ++i) {
+      value.flat<int32>()(i) = static_cast<int32>(values[i]);
+    }
+    value.AsProtoTensorContent((*attr)["value"].mutable_tensor());
+  }
+
+  void AddReshape(const string& name, const string& input,
+                  const std::vector<int64>& shape, const string& device,
+                  const string& control) {
+    const string shape_name = strings::StrCat(name, "/shape");
+    AddIntConst(shape_name, shape, device, control);
+    NodeDef* node = graph_->add_node();
+    graph_node_names_.insert(name);
+    node->set_name(name);
+    node->set_op("Reshape");
+    node->set_device(device);
+    node->add_input(input);
+    node->add_input(shape_name);
+    auto* attr = node->mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["Tshape"].set_type(DT_INT32);
+  }
+
+  void AddTranspose(const string& name, const string& input,
+                    const std::vector<int64>& perm, const string& device,
+                    const string& control) {
+    const string perm_name = strings::StrCat(name, "/perm");
+    AddIntConst(perm_name, perm, device, control);
+    NodeDef* node = graph_->add_node();
+    graph_node_names_.insert(name);
+    node->set_name(name);
+    node->set_op("Transpose");
+    node->set_device(device);
+    node->add_input(input);
+    node->add_input(perm_name);
+    auto* attr = node->mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["Tperm"].set_type(DT_INT32);
+  }
+
+  const int block_size_;
+  const absl::flat_hash_map<string, NhwcDims>& blocked_;
+  const GraphProperties& properties_;
+  GraphDef* graph_;
+  // Names of all the nodes of the graph, including the conversions added by
+  // an earlier run of the optimizer, which are reused rather than duplicated.
+  std::unordered_set<string> graph_node_names_;
+};
+
+}  // namespace
+
+CpuLayoutOptimizer::CpuLayoutOptimizer(int block_size)
+    : block_size_(block_size) {}
+
+Status CpuLayoutOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                    GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  bool has_conv2d = false;
+  for (const NodeDef& node : item.graph.node()) {
+    if (IsConv2D(node)) {
+      has_conv2d = true;
+      break;
+    }
+  }
+  if (!has_conv2d) return Status::OK();
+
+  const int block_size =
+      block_size_ > 0
+          ? block_size_
+          : (port::TestCPUFeature(port::CPUFeature::AVX512F) ? 16 : 8);
+  bool cluster_has_gpu = false;
+  if (cluster != nullptr) {
+    for (const auto& device : cluster->GetDevices()) {
+      if (device.second.type() == "GPU") cluster_has_gpu = true;
+    }
+  }
+
+  GraphProperties properties(item);
+  Status status = properties.InferStatically(/*assume_valid_feeds=*/false);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to infer the shapes of the graph: " << status;
+    return Status::OK();
+  }
+  if (!TopologicalSort(optimized_graph).ok()) return Status::OK();
+
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item.feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+
+  // Nodes whose output can be produced in the blocked layout: the blockable
+  // convolutions, and the supported element-wise ops that consume a blocked
+  // output, in topological order.
+  absl::flat_hash_map<string, NhwcDims> blocked;
+  std::vector<int> blocked_nodes;
+  for (int i = 0; i < optimized_graph->node_size(); ++i) {
+    const NodeDef& node = optimized_graph->node(i);
+    if (feeds.count(node.name()) || !IsOnCpu(node, cluster_has_gpu)) continue;
+    const auto& outputs = properties.GetOutputProperties(node.name());
+    NhwcDims output_dims;
+    if (outputs.size() != 1 || !GetNhwcDims(outputs[0], &output_dims) ||
+        output_dims.channels % block_size != 0) {
+      continue;
+    }
+    bool is_blockable = IsBlockableConv2D(node, properties, block_size);
+    if (!is_blockable && node.input_size() > 0 &&
+        (IsBiasAdd(node) || IsRelu(node) || IsRelu6(node)) &&
+        HasFloatNhwcAttrs(node)) {
+      const TensorId input = ParseTensorName(node.input(0));
+      is_blockable = input.index() == 0 && blocked.count(string(input.node()));
+      if (IsBiasAdd(node)) {
+        const auto& inputs = properties.GetInputProperties(node.name());
+        is_blockable &= inputs.size() == 2 && IsFullyDefined(inputs[1], 1);
+      }
+    }
+    if (is_blockable) {
+      blocked[node.name()] = output_dims;
+      blocked_nodes.push_back(i);
+    }
+  }
+  if (blocked.empty()) return Status::OK();
+
+  // A blocked node must still produce its NHWC output if it's preserved, or
+  // if anything but the blocked input of a blocked node consumes it.
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  NodeMap node_map(optimized_graph);
+  std::unordered_set<string> needs_nhwc_output;
+  for (const auto& entry : blocked) {
+    const string& name = entry.first;
+    if (nodes_to_preserve.count(name)) {
+      needs_nhwc_output.insert(name);
+      continue;
+    }
+    for (const NodeDef* fanout : node_map.GetOutputs(name)) {
+      bool uses_nhwc_output = !blocked.count(fanout->name());
+      for (int i = 1; i < fanout->input_size() && !uses_nhwc_output; ++i) {
+        uses_nhwc_output = !IsControlInput(fanout->input(i)) &&
+                           NodeName(fanout->input(i)) == name;
+      }
+      if (uses_nhwc_output) {
+        needs_nhwc_output.insert(name);
+        break;
+      }
+    }
+  }
+
+  VLOG(1) << "Converting " << blocked.size() << " nodes to the NCHW"
+          << block_size << "c layout";
+  BlockedLayoutRewriter rewriter(block_size, blocked, properties,
+                                 optimized_graph);
+  std::set<int> nodes_to_delete;
+  for (int i : blocked_nodes) {
+    NodeDef* node = optimized_graph->mutable_node(i);
+    rewriter.AddBlockedNode(*node);
+    if (needs_nhwc_output.count(node->name())) {
+      rewriter.ConvertBackToNhwc(node, blocked[node->name()]);
+    } else {
+      nodes_to_delete.insert(i);
+    }
+  }
+  EraseNodesFromGraph(nodes_to_delete, optimized_graph);
+  return Status::OK();
+}
+
+void CpuLayoutOptimizer::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                  const GraphDef& optimized_graph,
+                                  double result) {
+  // Nothing to do for CpuLayoutOptimizer.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,59 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CPU_LAYOUT_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CPU_LAYOUT_OPTIMIZER_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Converts subgraphs of NHWC convolutions placed on CPU to the blocked
+// NCHW[block_size]c layout, where the channels are split into blocks of
+// block_size contiguous values, the width of a SIMD register (8 floats with
+// AVX2, 16 with AVX-512).
+//
+// Conv2D ops are replaced by _BlockedConv2D, and the BiasAdd, Relu and Relu6
+// ops that consume them stay in the blocked layout, so that a chain of
+// convolutions only converts its input and output. The conversions are
+// Reshape+Transpose pairs, and the conversions of constant filters are folded
+// by the constant folding pass.
+//
+// The shapes of the converted ops (but the batch size) must be known
+// statically, and their number of channels must be a multiple of block_size.
+class CpuLayoutOptimizer : public GraphOptimizer {
+ public:
+  // `block_size` is the number of channels of a block, or 0 to pick it from
+  // the vector width of the host.
+  explicit CpuLayoutOptimizer(int block_size = 0);
+  ~CpuLayoutOptimizer() override {}
+
+  string name() const override { return "cpu_layout"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+
+ private:
+  const int block_size_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CPU_LAYOUT_OPTIMIZER_H_
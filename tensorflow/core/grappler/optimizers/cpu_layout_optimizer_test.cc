@@ -0,0 +1,232 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cpu_layout_optimizer.h"
+
+#include <unordered_set>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class CpuLayoutOptimizerTest : public GrapplerTest {
+ protected:
+  // Places all the nodes of the item on CPU.
+  void PlaceOnCpu(GrapplerItem* item) {
+    for (int i = 0; i < item->graph.node_size(); ++i) {
+      item->graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+};
+
+TEST_F(CpuLayoutOptimizerTest, BlocksConvolutionChain) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           Placeholder::Shape({2, 8, 8, 16}));
+  auto filter1 = Placeholder(s.WithOpName("filter1"), DT_FLOAT,
+                             Placeholder::Shape({3, 3, 16, 16}));
+  auto bias1 =
+      Placeholder(s.WithOpName("bias1"), DT_FLOAT, Placeholder::Shape({16}));
+  auto filter2 = Placeholder(s.WithOpName("filter2"), DT_FLOAT,
+                             Placeholder::Shape({1, 1, 16, 8}));
+
+  auto conv1 =
+      ops::Conv2D(s.WithOpName("conv1"), input, filter1, {1, 1, 1, 1}, "SAME");
+  auto bias_add1 = ops::BiasAdd(s.WithOpName("bias_add1"), conv1, bias1);
+  auto relu1 = ops::Relu(s.WithOpName("relu1"), bias_add1);
+  auto conv2 = ops::Conv2D(s.WithOpName("conv2"), relu1, filter2,
+                           {1, 2, 2, 1}, "VALID");
+  auto fetch = ops::Identity(s.WithOpName("fetch"), conv2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"input", GenerateRandomTensor<DT_FLOAT>({2, 8, 8, 16})},
+               {"filter1", GenerateRandomTensor<DT_FLOAT>({3, 3, 16, 16})},
+               {"bias1", GenerateRandomTensor<DT_FLOAT>({16})},
+               {"filter2", GenerateRandomTensor<DT_FLOAT>({1, 1, 16, 8})}};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  PlaceOnCpu(&item);
+
+  CpuLayoutOptimizer optimizer(/*block_size=*/8);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  NodeMap node_map(&output);
+  // Only the output of the chain is converted back to NHWC.
+  EXPECT_EQ(node_map.GetNode("conv1"), nullptr);
+  EXPECT_EQ(node_map.GetNode("bias_add1"), nullptr);
+  EXPECT_EQ(node_map.GetNode("relu1"), nullptr);
+  const NodeDef* new_conv2 = node_map.GetNode("conv2");
+  ASSERT_NE(new_conv2, nullptr);
+  EXPECT_EQ(new_conv2->op(), "Reshape");
+
+  const NodeDef* blocked_conv1 =
+      node_map.GetNode("conv1-Blocked-CpuLayoutOptimizer");
+  ASSERT_NE(blocked_conv1, nullptr);
+  EXPECT_EQ(blocked_conv1->op(), "_BlockedConv2D");
+  EXPECT_EQ(blocked_conv1->input(0), "input-0-ToBlocked-CpuLayoutOptimizer");
+  EXPECT_EQ(blocked_conv1->attr().at("block_size").i(), 8);
+  const NodeDef* blocked_bias_add1 =
+      node_map.GetNode("bias_add1-Blocked-CpuLayoutOptimizer");
+  ASSERT_NE(blocked_bias_add1, nullptr);
+  EXPECT_EQ(blocked_bias_add1->op(), "Add");
+  EXPECT_EQ(blocked_bias_add1->input(0), "conv1-Blocked-CpuLayoutOptimizer");
+  const NodeDef* blocked_relu1 =
+      node_map.GetNode("relu1-Blocked-CpuLayoutOptimizer");
+  ASSERT_NE(blocked_relu1, nullptr);
+  EXPECT_EQ(blocked_relu1->op(), "Relu");
+  const NodeDef* blocked_conv2 =
+      node_map.GetNode("conv2-Blocked-CpuLayoutOptimizer");
+  ASSERT_NE(blocked_conv2, nullptr);
+  EXPECT_EQ(blocked_conv2->input(0), "relu1-Blocked-CpuLayoutOptimizer");
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-4);
+}
+
+TEST_F(CpuLayoutOptimizerTest, SharesInputConversions) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           Placeholder::Shape({2, 8, 8, 16}));
+  auto filter = Placeholder(s.WithOpName("filter"), DT_FLOAT,
+                            Placeholder::Shape({3, 3, 16, 16}));
+  auto conv1 =
+      ops::Conv2D(s.WithOpName("conv1"), input, filter, {1, 1, 1, 1}, "SAME");
+  auto conv2 =
+      ops::Conv2D(s.WithOpName("conv2"), input, filter, {1, 1, 1, 1}, "SAME");
+  auto fetch = ops::Add(s.WithOpName("fetch"), conv1, conv2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  PlaceOnCpu(&item);
+  // The same tensor, named differently.
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "conv2") node.set_input(0, "input:0");
+  }
+
+  CpuLayoutOptimizer optimizer(/*block_size=*/8);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int num_conversions = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "input-0-ToBlocked-CpuLayoutOptimizer") {
+      ++num_conversions;
+    }
+  }
+  EXPECT_EQ(num_conversions, 1);
+  NodeMap node_map(&output);
+  for (const string& conv : {"conv1", "conv2"}) {
+    const NodeDef* blocked_conv =
+        node_map.GetNode(strings::StrCat(conv, "-Blocked-CpuLayoutOptimizer"));
+    ASSERT_NE(blocked_conv, nullptr);
+    EXPECT_EQ(blocked_conv->input(0), "input-0-ToBlocked-CpuLayoutOptimizer");
+  }
+}
+
+TEST_F(CpuLayoutOptimizerTest, ReusesConversionsOfEarlierRuns) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           Placeholder::Shape({2, 8, 8, 16}));
+  auto filter = Placeholder(s.WithOpName("filter"), DT_FLOAT,
+                            Placeholder::Shape({3, 3, 16, 16}));
+  auto conv1 =
+      ops::Conv2D(s.WithOpName("conv1"), input, filter, {1, 1, 1, 1}, "SAME");
+  auto conv2 =
+      ops::Conv2D(s.WithOpName("conv2"), input, filter, {1, 1, 1, 1}, "SAME");
+  auto fetch = ops::Add(s.WithOpName("fetch"), conv1, conv2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  PlaceOnCpu(&item);
+  // Only conv1 is blocked by the first run.
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "conv2") node.set_device("/device:GPU:0");
+  }
+
+  CpuLayoutOptimizer optimizer(/*block_size=*/8);
+  GraphDef first_output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &first_output));
+  ASSERT_NE(NodeMap(&first_output).GetNode("conv1-Blocked-CpuLayoutOptimizer"),
+            nullptr);
+
+  // The second run blocks conv2, whose inputs were already converted.
+  GrapplerItem second_item = item.WithGraph(std::move(first_output));
+  for (NodeDef& node : *second_item.graph.mutable_node()) {
+    if (node.name() == "conv2") node.set_device("/device:CPU:0");
+  }
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, second_item, &output));
+
+  std::unordered_set<string> node_names;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_TRUE(node_names.insert(node.name()).second) << node.name();
+  }
+  NodeMap node_map(&output);
+  const NodeDef* blocked_conv2 =
+      node_map.GetNode("conv2-Blocked-CpuLayoutOptimizer");
+  ASSERT_NE(blocked_conv2, nullptr);
+  EXPECT_EQ(blocked_conv2->input(0), "input-0-ToBlocked-CpuLayoutOptimizer");
+  EXPECT_EQ(blocked_conv2->input(1),
+            "filter-0-ToBlockedFilter-CpuLayoutOptimizer");
+}
+
+TEST_F(CpuLayoutOptimizerTest, KeepsUnblockableConvolutions) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  // 3 input channels can't be split in blocks of 8.
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           Placeholder::Shape({2, 8, 8, 3}));
+  auto filter = Placeholder(s.WithOpName("filter"), DT_FLOAT,
+                            Placeholder::Shape({3, 3, 3, 16}));
+  auto conv =
+      ops::Conv2D(s.WithOpName("conv"), input, filter, {1, 1, 1, 1}, "SAME");
+  auto fetch = ops::Identity(s.WithOpName("fetch"), conv);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  PlaceOnCpu(&item);
+
+  CpuLayoutOptimizer optimizer(/*block_size=*/8);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -81,6 +81,12 @@ class LoopInvariantNodeMotionOptimizer {
   std::map<int, int> frame_parent_;
   std::map<int, const NodeDef*> loop_cond_;
   std::map<int, std::vector<NodeDef*>> invariant_enters_;
+  // Constants placed in the frame by a control dependency, which seed the
+  // search of the invariant subgraphs that don't read any invariant Enter
+  // (e.g. the Fill of a constant shape).
+  std::map<int, std::vector<NodeDef*>> frame_constants_;
+  // An Enter node of each frame, to copy the frame attributes from.
+  std::map<int, const NodeDef*> frame_enter_;
   int new_enter_id_;
 };
 
@@ -118,6 +124,19 @@ Status LoopInvariantNodeMotionOptimizer::HandleConst(NodeDef* node,
                                                      const int num_outputs,
                                                      const int frame_id) {
   NodeDef* const_node = nullptr;
+  if (num_outputs > 0) {
+    // Leave the constant in the frame if none of its consumers is moved.
+    bool has_invariant_consumer = false;
+    for (auto* consumer : node_map_->GetOutputs(node->name())) {
+      if (invariant_nodes_.count(consumer)) {
+        has_invariant_consumer = true;
+        break;
+      }
+    }
+    if (!has_invariant_consumer) {
+      return Status::OK();
+    }
+  }
   if (num_outputs == 0) {
     // all successor nodes are invariant
     // Remove the control inputs from this frame to the const node,
@@ -210,9 +229,9 @@ Status LoopInvariantNodeMotionOptimizer::HandleInvariantNode(
                                        &output_types));
 
   auto consumers = node_map_->GetOutputs(node->name());
-  string fname = invariant_enters_[frame_id][0]->attr().at("frame_name").s();
-  int piterations =
-      invariant_enters_[frame_id][0]->attr().at("parallel_iterations").i();
+  const NodeDef* frame_enter = frame_enter_[frame_id];
+  string fname = frame_enter->attr().at("frame_name").s();
+  int piterations = frame_enter->attr().at("parallel_iterations").i();
   for (auto* consumer : consumers) {
     if (!invariant_nodes_.count(consumer)) {
       for (int i = 0; i < consumer->input_size(); ++i) {
@@ -345,6 +364,11 @@ Status LoopInvariantNodeMotionOptimizer::FindInvariantNodes(
       if (invariant_nodes_.count(consumer) || ModifiesFrameInfo(*consumer)) {
         continue;
       }
+      // Stateful nodes (e.g. random ops, or reads of variables updated in the
+      // loop) must run at every iteration.
+      if (!IsFreeOfSideEffect(*consumer)) {
+        continue;
+      }
       bool is_invariant = true;
       for (const auto& input : consumer->input()) {
         if (!IsControlInput(input)) {
@@ -411,8 +435,15 @@ Status LoopInvariantNodeMotionOptimizer::Optimize() {
         }
         loop_cond_[frame_ids.back()] = &node;
       }
-      if (IsEnter(node) && node.attr().at("is_constant").b()) {
-        invariant_enters_[frame_ids.back()].push_back(
+      if (IsEnter(node)) {
+        frame_enter_.emplace(frame_ids.back(), &node);
+        if (node.attr().at("is_constant").b()) {
+          invariant_enters_[frame_ids.back()].push_back(
+              const_cast<NodeDef*>(&node));
+        }
+      }
+      if (IsConstant(node)) {
+        frame_constants_[frame_ids.back()].push_back(
             const_cast<NodeDef*>(&node));
       }
     }
@@ -437,13 +468,21 @@ Status LoopInvariantNodeMotionOptimizer::Optimize() {
       }
     }
 
-    if (invariant_enters_[frame_id].empty()) {
+    if (invariant_enters_[frame_id].empty() &&
+        frame_constants_[frame_id].empty()) {
       continue;
     }
+    if (!frame_enter_.count(frame_id)) {
+      return errors::InvalidArgument("Frame ", frame_id,
+                                     " doesn't have an Enter node");
+    }
     invariant_nodes_.clear();
     for (auto* enter : invariant_enters_[frame_id]) {
       TF_RETURN_IF_ERROR(FindInvariantNodes(enter));
     }
+    for (auto* constant : frame_constants_[frame_id]) {
+      TF_RETURN_IF_ERROR(FindInvariantNodes(constant));
+    }
 
     // revert invariant nodes that have control outputs to variant nodes
     TF_RETURN_IF_ERROR(RevertInvariantNodes());
@@ -703,7 +742,7 @@ LoopOptimizer::LoopOptimizer(RewriterConfig::Toggle opt_level,
                              DeviceBase* cpu_device)
     : opt_level_(opt_level),
       cpu_device_(cpu_device),
-      options_(LoopOptimizerOptions::Default(RewriterConfig::ON)) {
+      options_(LoopOptimizerOptions::Default(opt_level)) {
   resource_mgr_.reset(new ResourceMgr());
 }
 
@@ -55,6 +55,10 @@ class LoopOptimizer : public GraphOptimizer {
 
     static LoopOptimizerOptions Default(RewriterConfig::Toggle opt_level) {
       LoopOptimizerOptions options;
+      // Hoisting loop invariant subgraphs adds an Enter node per tensor that
+      // crosses the frame boundary, so it's only enabled in aggressive mode.
+      options.enable_loop_invariant_node_motion =
+          opt_level == RewriterConfig::AGGRESSIVE;
       return options;
     }
   };
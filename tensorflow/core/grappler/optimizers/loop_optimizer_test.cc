@@ -74,6 +74,10 @@ class LoopOptimizerTest : public GrapplerTest {
     DisableAllStages(optimizer);
     optimizer->options_.enable_stack_push_removal = true;
   }
+
+  bool IsLoopInvariantNodeMotionEnabled(const LoopOptimizer& optimizer) {
+    return optimizer.options_.enable_loop_invariant_node_motion;
+  }
 };
 
 TEST_F(LoopOptimizerTest, Basic) {
@@ -513,6 +517,94 @@ void VerifyGraphsEqual(const GraphDef& original_graph,
   }
 }
 
+TEST_F(LoopOptimizerTest, ConstSubgraph) {
+  GraphDef graph;
+  AddSimpleNode("In", "Identity", {}, &graph);
+  AddEnterNode("VariantEnter", "while/while_context", false, 1, {"In"}, &graph);
+  AddSimpleNode("Merge", "Merge", {"VariantEnter", "NextIteration"}, &graph);
+  AddSimpleNode("Less/y", "Const", {"^Identity"}, &graph);
+  AddSimpleNode("Less", "Less", {"VariantAdd", "Less/y"}, &graph);
+  AddSimpleNode("LoopCond", "LoopCond", {"Less"}, &graph);
+  AddSimpleNode("Switch", "Switch", {"Merge", "LoopCond"}, &graph);
+  AddSimpleNode("Identity", "Identity", {"Switch:1"}, &graph);
+  // The loop doesn't have any invariant Enter: the invariant subgraph only
+  // reads constants.
+  AddSimpleNode("Const1", "Const", {"^Identity"}, &graph);
+  AddSimpleNode("Const2", "Const", {"^Identity"}, &graph);
+  AddSimpleNode("InvariantAdd", "Add", {"Const1", "Const2"}, &graph);
+  AddSimpleNode("VariantAdd", "Add", {"InvariantAdd", "Identity"}, &graph);
+  AddSimpleNode("NextIteration", "NextIteration", {"VariantAdd"}, &graph);
+  AddSimpleNode("Exit", "Exit", {"Switch"}, &graph);
+  AddSimpleNode("Out", "Identity", {"Exit"}, &graph);
+
+  GrapplerItem item;
+  item.graph = graph;
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopInvariantNodeMotion(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  GraphView view(&output);
+  FrameView frames;
+  TF_EXPECT_OK(frames.InferFromGraphView(view));
+
+  EXPECT_EQ(frames.num_frames(), 1);
+  EXPECT_EQ(frames.Frames(*view.GetNode("Const1")).size(), 0);
+  EXPECT_EQ(frames.Frames(*view.GetNode("Const2")).size(), 0);
+  EXPECT_EQ(frames.Frames(*view.GetNode("InvariantAdd")).size(), 0);
+  ASSERT_EQ(frames.Frames(*view.GetNode("VariantAdd")).size(), 1);
+  EXPECT_EQ(frames.Frames(*view.GetNode("VariantAdd")).back(), 0);
+  // The constant only read by a variant node stays in the loop, and isn't
+  // duplicated.
+  ASSERT_EQ(frames.Frames(*view.GetNode("Less/y")).size(), 1);
+  EXPECT_EQ(view.GetNode(AddPrefixToNodeName("Less/y", kLoopOptimizer)),
+            nullptr);
+}
+
+TEST_F(LoopOptimizerTest, StatefulNodeNotHoisted) {
+  GraphDef graph;
+  AddSimpleNode("In", "Identity", {}, &graph);
+  AddEnterNode("InvariantEnter", "while/while_context", true, 1, {"In"},
+               &graph);
+  AddSimpleNode("Random", "RandomUniform", {"InvariantEnter"}, &graph);
+  AddSimpleNode("VariantAdd", "Add", {"Random", "Identity"}, &graph);
+  AddEnterNode("VariantEnter", "while/while_context", false, 1, {"In"}, &graph);
+  AddSimpleNode("Merge", "Merge", {"VariantEnter", "NextIteration"}, &graph);
+  AddSimpleNode("Less/y", "Const", {"^Identity"}, &graph);
+  AddSimpleNode("Less", "Less", {"VariantAdd", "Less/y"}, &graph);
+  AddSimpleNode("LoopCond", "LoopCond", {"Less"}, &graph);
+  AddSimpleNode("Switch", "Switch", {"Merge", "LoopCond"}, &graph);
+  AddSimpleNode("Identity", "Identity", {"Switch:1"}, &graph);
+  AddSimpleNode("NextIteration", "NextIteration", {"VariantAdd"}, &graph);
+  AddSimpleNode("Exit", "Exit", {"Switch"}, &graph);
+  AddSimpleNode("Out", "Identity", {"Exit"}, &graph);
+
+  GrapplerItem item;
+  item.graph = graph;
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopInvariantNodeMotion(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  GraphView view(&output);
+  FrameView frames;
+  TF_EXPECT_OK(frames.InferFromGraphView(view));
+
+  // The random op draws a new value at every iteration.
+  ASSERT_EQ(frames.Frames(*view.GetNode("Random")).size(), 1);
+  EXPECT_EQ(frames.Frames(*view.GetNode("Random")).back(), 0);
+  EXPECT_EQ(view.GetNode("Random")->input(0), "InvariantEnter");
+}
+
+TEST_F(LoopOptimizerTest, InvariantNodeMotionEnabledInAggressiveMode) {
+  LoopOptimizer aggressive(RewriterConfig::AGGRESSIVE, nullptr);
+  EXPECT_TRUE(IsLoopInvariantNodeMotionEnabled(aggressive));
+  LoopOptimizer on(RewriterConfig::ON, nullptr);
+  EXPECT_FALSE(IsLoopInvariantNodeMotionEnabled(on));
+}
+
 TEST_F(LoopOptimizerTest, NoOp) {
   // This trivial graph is so basic there's nothing to optimize.
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
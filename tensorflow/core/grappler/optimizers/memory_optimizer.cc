@@ -420,6 +420,17 @@ void RecomputeSubgraph(
   }
 }
 
+// Nodes whose inputs we may want to recompute. This matches node names that
+// contain recomputation_targets_name_scope as a name scope, meaning it either
+// begins with or contains the name scope. Defaults to "gradients/" which will
+// match any node names that begins with "gradients/" or contains
+// "/gradients/".
+bool IsRecomputationTarget(const NodeDef& node,
+                           const string& recomputation_targets_name_scope) {
+  return node.name().find(recomputation_targets_name_scope) == 0 ||
+         node.name().find("/" + recomputation_targets_name_scope) != -1;
+}
+
 void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
                                 const string& recomputation_targets_name_scope,
                                 GraphDef* graph, const GrapplerItem& item) {
@@ -447,13 +458,7 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
   std::function<bool(const NodeDef&)> is_target =
       [&recomputation_targets_name_scope](const NodeDef& node) {
-        // Nodes whose inputs we may want to recompute. This matches node names
-        // that contain recomputation_targets_name_scope as a name scope,
-        // meaning it either begins with or contains the name scope.
-        // Defaults to "gradients/" which will match any node names that begins
-        // with "gradients/" or contains "/gradients/".
-        return node.name().find(recomputation_targets_name_scope) == 0 ||
-               node.name().find("/" + recomputation_targets_name_scope) != -1;
+        return IsRecomputationTarget(node, recomputation_targets_name_scope);
       };
 
   if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
@@ -496,6 +501,116 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
 }
 
+// Recomputes groups of cheap ops feeding the backward pass, like the
+// recomputation heuristics, but only those whose outputs are live at the peak
+// memory usage of a host device, and only until the estimated peak memory
+// usage of every host device fits in `budget_bytes`. The group that frees the
+// most memory at the peak is recomputed first. Returns true if the graph was
+// modified.
+bool HostMemoryBudgetRecomputationPass(
+    int64 budget_bytes, const string& recomputation_targets_name_scope,
+    Cluster* cluster, GrapplerItem* item) {
+  const std::unordered_map<string, DeviceProperties>& devices =
+      cluster->GetDevices();
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item->feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+  const std::unordered_set<string> cheap_to_recompute_ops =
+      GetCheapToRecomputeOps();
+  const string recomputed_prefix = strings::StrCat(kRecomputedNodePrefix, "/");
+  const string trigger_prefix =
+      strings::StrCat(kRecomputeTriggerNodePrefix, "/");
+
+  std::function<bool(const NodeDef&)> is_target =
+      [&recomputation_targets_name_scope](const NodeDef& node) {
+        return IsRecomputationTarget(node, recomputation_targets_name_scope);
+      };
+  std::function<bool(const NodeDef&)> should_recompute =
+      [&](const NodeDef& node) {
+        // Don't recompute the copies created by previous rewrites.
+        if (str_util::StartsWith(node.name(), recomputed_prefix) ||
+            str_util::StartsWith(node.name(), trigger_prefix)) {
+          return false;
+        }
+        return !is_target(node) && feeds.count(node.name()) == 0 &&
+               (cheap_to_recompute_ops.count(node.op()) > 0 ||
+                node.attr().count(kRecomputeHint) > 0);
+      };
+
+  bool updated_graph = false;
+  // Bound the number of rewrites, since the memory usage is estimated again
+  // after each of them.
+  for (int i = 0; i < 100; ++i) {
+    GraphMemory memory(*item);
+    Status s = memory.InferStatically(devices);
+    if (!s.ok()) {
+      VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+      break;
+    }
+
+    // Find the host device that exceeds the budget the most.
+    const GraphMemory::MemoryUsage* peak_usage = nullptr;
+    for (const auto& device : devices) {
+      if (device.second.type() != "CPU") continue;
+      const GraphMemory::MemoryUsage& usage =
+          memory.GetPeakMemoryUsage(device.first);
+      if (usage.used_memory > budget_bytes &&
+          (peak_usage == nullptr ||
+           usage.used_memory > peak_usage->used_memory)) {
+        peak_usage = &usage;
+      }
+    }
+    if (peak_usage == nullptr) break;
+
+    std::unordered_map<string, int64> live_bytes_at_peak;
+    for (const GraphMemory::LiveTensor& live : peak_usage->live_tensors) {
+      live_bytes_at_peak[live.node] += live.memory_used;
+    }
+
+    if (!TopologicalSort(&item->graph).ok()) break;
+    NodeMap node_map(&item->graph);
+    std::vector<RecomputedSubGraph> subgraphs = GetOpGroupsToRecompute(
+        &item->graph, node_map, should_recompute, is_target);
+
+    const RecomputedSubGraph* best_subgraph = nullptr;
+    int64 best_savings = 0;
+    for (const RecomputedSubGraph& subgraph : subgraphs) {
+      int64 savings = 0;
+      for (const NodeDef* node : subgraph.recomputed_source_nodes) {
+        auto it = live_bytes_at_peak.find(node->name());
+        if (it != live_bytes_at_peak.end()) savings += it->second;
+      }
+      if (savings > best_savings) {
+        best_subgraph = &subgraph;
+        best_savings = savings;
+      }
+    }
+    if (best_subgraph == nullptr) {
+      VLOG(1) << "Peak host memory usage of " << peak_usage->used_memory
+              << " bytes exceeds the budget of " << budget_bytes
+              << " bytes, but nothing else can be recomputed";
+      break;
+    }
+
+    VLOG(1) << "Recomputing " << best_subgraph->recomputed_source_nodes.size()
+            << " nodes to save up to " << best_savings
+            << " bytes at the peak host memory usage of "
+            << peak_usage->used_memory << " bytes";
+    std::unordered_map<const NodeDef*, int> topological_numbering;
+    const int num_nodes = item->graph.node_size();
+    for (int node_number = 0; node_number < num_nodes; ++node_number) {
+      topological_numbering[item->graph.mutable_node(node_number)] =
+          num_nodes - node_number - 1;
+    }
+    RecomputeSubgraph(best_subgraph->recomputed_source_nodes,
+                      best_subgraph->target_nodes, node_map,
+                      topological_numbering, &item->graph);
+    updated_graph = true;
+  }
+  return updated_graph;
+}
+
 bool SchedulingPass(Cluster* cluster, GrapplerItem* item) {
   // Look for AddN nodes (and equivalent) and record input names.
   MutableGraphView view(&item->graph);
@@ -1340,9 +1455,16 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                  GraphDef* optimized_graph) {
   GrapplerItem optimized_item(item);
 
-  RecomputationRewritingPass(optimization_level_,
-                             recomputation_targets_name_scope_,
-                             &optimized_item.graph, item);
+  if (host_memory_budget_bytes_ > 0 &&
+      optimization_level_ != RewriterConfig::MANUAL && cluster != nullptr) {
+    HostMemoryBudgetRecomputationPass(host_memory_budget_bytes_,
+                                      recomputation_targets_name_scope_,
+                                      cluster, &optimized_item);
+  } else {
+    RecomputationRewritingPass(optimization_level_,
+                               recomputation_targets_name_scope_,
+                               &optimized_item.graph, item);
+  }
 
   std::unordered_set<string> skip_list;
   // Bound the number of rewrite passes to avoid long processing times on graphs
@@ -33,11 +33,16 @@ class MemoryOptimizer : public GraphOptimizer {
   // recomputation_targets_name_scope: Name scope for potential outputs of
   //   recomputations. See
   //   RewriterConfig::memory_optimizer_target_node_name_scope.
+  // host_memory_budget_bytes: If positive, only recompute what is needed for
+  //   the peak host memory usage to fit in the budget. See
+  //   RewriterConfig::memory_optimizer_host_memory_budget_bytes.
   explicit MemoryOptimizer(
       RewriterConfig::MemOptType optimization_level,
-      const string& recomputation_targets_name_scope = "gradients/")
+      const string& recomputation_targets_name_scope = "gradients/",
+      int64 host_memory_budget_bytes = 0)
       : optimization_level_(optimization_level),
-        recomputation_targets_name_scope_(recomputation_targets_name_scope) {}
+        recomputation_targets_name_scope_(recomputation_targets_name_scope),
+        host_memory_budget_bytes_(host_memory_budget_bytes) {}
   ~MemoryOptimizer() override {}
 
   string name() const override { return "memory_optimizer"; };
@@ -51,6 +56,7 @@ class MemoryOptimizer : public GraphOptimizer {
  private:
   RewriterConfig::MemOptType optimization_level_;
   string recomputation_targets_name_scope_;
+  int64 host_memory_budget_bytes_;
 };
 
 }  // end namespace grappler
@@ -447,6 +447,49 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, RecomputationToFitHostMemoryBudget) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output v = ops::Variable(s.WithOpName("v"), {128, 128}, DT_FLOAT);
+  // "a" is live from the forward pass until the end of the backward pass.
+  Output a = ops::Sigmoid(s.WithOpName("a"), v);
+  Output b = ops::MatMul(s.WithOpName("b"), a, v);
+  Output c = ops::MatMul(s.WithOpName("gradients/c"), b, v);
+  Output d = ops::MatMul(s.WithOpName("gradients/d"), c, v);
+  Output e = ops::AddN(s.WithOpName("gradients/e"), {d, a});
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"gradients/e"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+
+  // Without a budget, the default heuristics don't recompute anything.
+  MemoryOptimizer default_optimizer(RewriterConfig::DEFAULT_MEM_OPT);
+  GraphDef output;
+  TF_EXPECT_OK(default_optimizer.Optimize(cluster.get(), item, &output));
+  EXPECT_EQ(nullptr, NodeMap(&output).GetNode("Recomputed/a"));
+
+  // The graph already fits in a large budget.
+  MemoryOptimizer large_budget_optimizer(RewriterConfig::DEFAULT_MEM_OPT,
+                                         "gradients/", 1024 * 1024 * 1024);
+  TF_EXPECT_OK(large_budget_optimizer.Optimize(cluster.get(), item, &output));
+  EXPECT_EQ(nullptr, NodeMap(&output).GetNode("Recomputed/a"));
+
+  // With a small budget, "a" is recomputed for the backward pass.
+  MemoryOptimizer small_budget_optimizer(RewriterConfig::DEFAULT_MEM_OPT,
+                                         "gradients/", 1024);
+  TF_EXPECT_OK(small_budget_optimizer.Optimize(cluster.get(), item, &output));
+  NodeMap node_map(&output);
+  const NodeDef* recomputed_a = node_map.GetNode("Recomputed/a");
+  ASSERT_NE(nullptr, recomputed_a);
+  EXPECT_EQ("Sigmoid", recomputed_a->op());
+  const NodeDef* new_e = node_map.GetNode("gradients/e");
+  ASSERT_NE(nullptr, new_e);
+  EXPECT_EQ("Recomputed/a", new_e->input(1));
+  // The forward pass still uses the original "a".
+  EXPECT_EQ("a", node_map.GetNode("b")->input(0));
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
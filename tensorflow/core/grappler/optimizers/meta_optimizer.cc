@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
 
+#include <cstdlib>
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/function.pb.h"
@@ -23,10 +26,13 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/optimizers/arithmetic_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 #include "tensorflow/core/grappler/optimizers/auto_parallel.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
+#include "tensorflow/core/grappler/optimizers/cost_based_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/cpu_layout_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/optimizers/debug_stripper.h"
 #include "tensorflow/core/grappler/optimizers/dependency_optimizer.h"
@@ -46,7 +52,16 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/tpu.h"
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/public/version.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/ptr_util.h"
 
@@ -57,6 +72,8 @@ namespace {
 
 constexpr int kDefaultNumberOfIterations = 2;
 constexpr int kDefaultMinGraphNodes = 4;
+// Time budget of the cost based search over the heuristic rewrites.
+constexpr int64 kCostBasedOptimizationBudgetUsec = 30 * 1000 * 1000;
 
 int64 NumEdges(const GraphDef& graph) {
   int64 num_edges = 0;
@@ -82,7 +99,8 @@ int NumIterations(const RewriterConfig& cfg) {
 // Check if optimizer is allowed to run only once.
 bool IsRunOnceOptimizer(const string& name) {
   return name == "layout" || name == "memory_optimizer" ||
-         name == "loop_optimizer" || name == "auto_mixed_precision";
+         name == "loop_optimizer" || name == "auto_mixed_precision" ||
+         name == "auto_mixed_precision_cpu" || name == "cost_based_optimizer";
 }
 
 uint64 DeadlineMicroSeconds(const RewriterConfig& cfg) {
@@ -119,6 +137,22 @@ bool AutoMixedPrecisionEnabled(RewriterConfig::Toggle opt_level) {
   return false;
 }
 
+// Writes the optimized graph to `path`, through a temporary file so that the
+// processes sharing the cache directory never read a partially written graph.
+Status WriteOptimizedGraphToCache(const string& path, const GraphDef& graph) {
+  Env* env = Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(string(io::Dirname(path))));
+  const string tmp_path = strings::StrCat(path, ".tmp", random::New64());
+  Status status = WriteBinaryProto(env, tmp_path, graph);
+  if (status.ok()) {
+    status = env->RenameFile(tmp_path, path);
+  }
+  if (!status.ok()) {
+    env->DeleteFile(tmp_path).IgnoreError();
+  }
+  return status;
+}
+
 }  // namespace
 
 #define MK_OPT(NAME, VALUE) \
@@ -132,8 +166,12 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
   MK_OPT("shape", new ShapeOptimizer());
   MK_OPT("remap", new Remapper(cfg_.remapping()));
   MK_OPT("layout", new LayoutOptimizer());
+  MK_OPT("cpu_layout", new CpuLayoutOptimizer());
   MK_OPT("auto_mixed_precision",
          new AutoMixedPrecision(cfg_.auto_mixed_precision()));
+  MK_OPT("auto_mixed_precision_cpu",
+         new AutoMixedPrecision(cfg_.auto_mixed_precision_cpu(),
+                                AutoMixedPrecisionMode::CPU));
   MK_OPT("memory", new MemoryOptimizer(RewriterConfig::MANUAL));
   MK_OPT("arithmetic", new ArithmeticOptimizer(cfg_.arithmetic_optimization()));
   MK_OPT("autoparallel", new AutoParallel(cfg_.auto_parallel().num_replicas()));
@@ -184,6 +222,21 @@ Status MetaOptimizer::InitializeOptimizers(
   if (cfg_.shape_optimization() != RewriterConfig::OFF) {
     optimizers->push_back(MakeUnique<ShapeOptimizer>());
   }
+#ifndef INTEL_MKL
+  // Runs before the remapper, which would fuse the convolutions.
+  if (cfg_.cpu_layout_optimizer() == RewriterConfig::ON) {
+    optimizers->push_back(MakeUnique<CpuLayoutOptimizer>());
+  }
+#endif  // !INTEL_MKL
+  // With cost based optimization, the layout and memory optimizers only
+  // propose rewrites, that are kept if the cost model finds them profitable.
+  // The remapper is always applied: the cost model has no cost functions for
+  // the fused ops it creates, so it can't tell if they are profitable.
+  std::vector<std::unique_ptr<GraphOptimizer>> cost_based_candidates;
+  auto* heuristic_optimizers =
+      cfg_.cost_based_optimization() == RewriterConfig::ON
+          ? &cost_based_candidates
+          : optimizers;
   if (cfg_.remapping() != RewriterConfig::OFF) {
     optimizers->push_back(MakeUnique<Remapper>(cfg_.remapping()));
   }
@@ -203,22 +256,43 @@ Status MetaOptimizer::InitializeOptimizers(
         MakeUnique<DependencyOptimizer>(cfg_.dependency_optimization()));
   }
   if (cfg_.layout_optimizer() != RewriterConfig::OFF) {
-    optimizers->push_back(MakeUnique<LayoutOptimizer>());
+    heuristic_optimizers->push_back(MakeUnique<LayoutOptimizer>());
   }
   if (AutoMixedPrecisionEnabled(cfg_.auto_mixed_precision())) {
     optimizers->push_back(
         MakeUnique<AutoMixedPrecision>(cfg_.auto_mixed_precision()));
   }
+  if (AutoMixedPrecisionEnabled(cfg_.auto_mixed_precision_cpu())) {
+    optimizers->push_back(MakeUnique<AutoMixedPrecision>(
+        cfg_.auto_mixed_precision_cpu(), AutoMixedPrecisionMode::CPU));
+  }
   if (cfg_.memory_optimization() != RewriterConfig::NO_MEM_OPT) {
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
-      optimizers->push_back(
+      heuristic_optimizers->push_back(MakeUnique<MemoryOptimizer>(
           // Use the default target node name prefix "gradients/"
-          MakeUnique<MemoryOptimizer>(cfg_.memory_optimization()));
+          cfg_.memory_optimization(), "gradients/",
+          cfg_.memory_optimizer_host_memory_budget_bytes()));
     } else {
-      optimizers->push_back(MakeUnique<MemoryOptimizer>(
+      heuristic_optimizers->push_back(MakeUnique<MemoryOptimizer>(
           cfg_.memory_optimization(),
-          cfg_.memory_optimizer_target_node_name_scope()));
+          cfg_.memory_optimizer_target_node_name_scope(),
+          cfg_.memory_optimizer_host_memory_budget_bytes()));
     }
+    // Recomputation is not part of the default heuristics, but the cost model
+    // can decide when it's worth trading compute for memory.
+    if (heuristic_optimizers == &cost_based_candidates &&
+        cfg_.memory_optimization() == RewriterConfig::DEFAULT_MEM_OPT) {
+      const string& name_scope =
+          cfg_.memory_optimizer_target_node_name_scope().empty()
+              ? "gradients/"
+              : cfg_.memory_optimizer_target_node_name_scope();
+      cost_based_candidates.push_back(MakeUnique<MemoryOptimizer>(
+          RewriterConfig::RECOMPUTATION_HEURISTICS, name_scope));
+    }
+  }
+  if (!cost_based_candidates.empty()) {
+    optimizers->push_back(MakeUnique<CostBasedOptimizer>(
+        std::move(cost_based_candidates), kCostBasedOptimizationBudgetUsec));
   }
   if (cfg_.auto_parallel().enable()) {
     optimizers->push_back(
@@ -318,8 +392,9 @@ void MetaOptimizer::InitializeVerifiers(
   }
 }
 
-Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
-                                    GraphDef* optimized_graph) {
+Status MetaOptimizer::OptimizeGraph(
+    Cluster* cluster, const GrapplerItem& item, GraphDef* optimized_graph,
+    GraphOptimizationResult* optimization_result) {
   int min_graph_nodes = cfg_.min_graph_nodes() == 0 ? kDefaultMinGraphNodes
                                                     : cfg_.min_graph_nodes();
   if (item.graph.node_size() < min_graph_nodes) {
@@ -363,12 +438,15 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
     return Status::OK();
   }
 
+  // Optimizers that run on a graph that was not rewritten since the last shape
+  // inference reuse the inferred properties.
+  GraphPropertiesCache graph_properties_cache;
+
   // Invariant: optimized_graph contains the most recently optimized version of
   // the graph.
   GrapplerItem optimized_item = item;
   optimized_graph->Swap(&optimized_item.graph);
 
-  GraphOptimizationResult optimization_result(item.id);
   GraphOptimizer* fusion_optimizer = nullptr;
   GraphOptimizer* sa_optimizer = nullptr;
 
@@ -403,7 +481,7 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
       }
 
       TF_RETURN_IF_ERROR(RunOptimizer(optimizer.get(), cluster, &optimized_item,
-                                      optimized_graph, &optimization_result));
+                                      optimized_graph, optimization_result));
 
       if (VLOG_IS_ON(4)) {
         DumpGraphDefToFile(
@@ -437,26 +515,27 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
   // functions, and we can't optimize across function boundaries.
   if (fusion_optimizer != nullptr) {
     TF_RETURN_IF_ERROR(RunOptimizer(fusion_optimizer, cluster, &optimized_item,
-                                    optimized_graph, &optimization_result));
+                                    optimized_graph, optimization_result));
   }
 
   // ScopedAllocatorOptimizer must run last.
   if (sa_optimizer != nullptr) {
     TF_RETURN_IF_ERROR(RunOptimizer(sa_optimizer, cluster, &optimized_item,
-                                    optimized_graph, &optimization_result));
+                                    optimized_graph, optimization_result));
   }
 
+  VLOG(2) << "Reused graph properties " << graph_properties_cache.num_hits()
+          << " times, inferred them " << graph_properties_cache.num_misses()
+          << " times";
+
   // Compress the constants in the final graph.
   TF_RETURN_IF_ERROR(CompressConstants(optimized_graph));
 
-  bool is_optimized = std::find_if(optimization_result.results.begin(),
-                                   optimization_result.results.end(),
+  bool is_optimized = std::find_if(optimization_result->results.begin(),
+                                   optimization_result->results.end(),
                                    [](const OptimizerResult& result) {
                                      return result.status.ok();
-                                   }) != optimization_result.results.end();
-
-  // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+                                   }) != optimization_result->results.end();
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -491,7 +570,8 @@ Status MetaOptimizer::RunOptimizer(
           strings::StrCat(status.ToString(), ", time = ", duration_ms, "ms.");
       LOG(WARNING) << optimizer->name() << " failed: " << message;
     } else {
-      message = status.ToString();
+      message =
+          strings::StrCat(status.ToString(), ", time = ", duration_ms, "ms.");
       LOG(ERROR) << optimizer->name() << " failed: " << message;
     }
   } else {
@@ -501,7 +581,8 @@ Status MetaOptimizer::RunOptimizer(
     VLOG(1) << optimizer->name() << ": " << message;
   }
 
-  OptimizerResult optimizer_result{optimizer->name(), message, status};
+  OptimizerResult optimizer_result{optimizer->name(), message, status,
+                                   end_us - start_us};
   optimization_result->results.push_back(optimizer_result);
 
   if (!status.ok() && cfg_.fail_on_optimizer_errors()) return status;
@@ -509,8 +590,217 @@ Status MetaOptimizer::RunOptimizer(
   return Status::OK();
 }
 
+int MetaOptimizer::NumFunctionOptimizationThreads() const {
+  if (cfg_.meta_optimizer_num_threads() > 0) {
+    return cfg_.meta_optimizer_num_threads();
+  }
+  // Custom optimizers are not required to be thread-safe.
+  if (!cfg_.custom_optimizers().empty()) return 1;
+  for (const string& optimizer_name : cfg_.optimizers()) {
+    if (MakeNewOptimizer(optimizer_name) == nullptr) return 1;
+  }
+  return std::max(1, port::NumSchedulableCPUs());
+}
+
+Status MetaOptimizer::OptimizeFunctions(
+    Cluster* cluster, bool is_tpu_graph,
+    const std::vector<GrapplerFunctionItem>& func_items, int num_threads,
+    std::vector<GraphDef>* optimized_func_graphs,
+    std::vector<GraphOptimizationResult>* func_results) {
+  std::vector<Status> statuses(func_items.size());
+
+  const auto optimize_function = [&](int i) {
+    if (is_tpu_graph) {
+      // Skip optimizing functions if this is a TPU graph. Currently, Grappler
+      // passes do not handle TPU functions correctly in a variety of ways
+      // (Note that due to the pre-placement TPU graph rewriting passes, the
+      // TPU-related ops are encapsulated away into functions). For example,
+      // TPU graphs contain TPUReplicateMetadata node that carries relevant
+      // TPU metadata and Grappler passes could prune that away. Grappler
+      // passes could also cause issues around shape inference. Since the
+      // desired and existing behavior is to not optimize TPU functions with
+      // Grappler, this check preserves that. The only execption is
+      // implementation selector what is required to swap in some TPU specific
+      // lowering code and is verified the work correctly on TPUs.
+      ImplementationSelector implementation_selector;
+      statuses[i] = implementation_selector.Optimize(
+          cluster, func_items[i], &(*optimized_func_graphs)[i]);
+    } else {
+      statuses[i] = OptimizeGraph(cluster, func_items[i],
+                                  &(*optimized_func_graphs)[i],
+                                  &(*func_results)[i]);
+    }
+  };
+
+  num_threads = std::min<int>(num_threads, func_items.size());
+  if (num_threads <= 1) {
+    for (int i = 0; i < func_items.size(); ++i) {
+      optimize_function(i);
+      // Stop at the first error, like the sequential optimization did.
+      TF_RETURN_IF_ERROR(statuses[i]);
+    }
+    return Status::OK();
+  }
+
+  {
+    // Functions are scheduled in the library order, and the pool is destroyed
+    // (joined) before the results are inspected.
+    thread::ThreadPool pool(Env::Default(), "meta_optimizer", num_threads);
+    for (int i = 0; i < func_items.size(); ++i) {
+      pool.Schedule([&optimize_function, i]() { optimize_function(i); });
+    }
+  }
+
+  // Report the error of the first failed function in the library order, so
+  // that the returned status doesn't depend on the scheduling.
+  for (const Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
+  return Status::OK();
+}
+
+string MetaOptimizer::OptimizedGraphCachePath(
+    const Cluster* cluster, const GrapplerItem& item) const {
+  // Every value is prefixed by its size, so that the key is unambiguous.
+  string key;
+  const auto append = [&key](StringPiece value) {
+    strings::StrAppend(&key, value.size(), ":", value);
+  };
+  const auto append_proto = [&append](const protobuf::MessageLite& proto) {
+    string serialized;
+    SerializeToStringDeterministic(proto, &serialized);
+    append(serialized);
+  };
+  const auto append_list = [&append](const std::vector<string>& values) {
+    append(strings::StrCat(values.size()));
+    for (const string& value : values) append(value);
+  };
+
+  // The optimizers themselves.
+  append(TF_VERSION_STRING);
+  append_proto(cfg_);
+  append(cpu_device_ == nullptr ? "" : cpu_device_->name());
+
+  // The host: some optimizers only rewrite the graph if its CPU has the
+  // instructions for it (e.g. auto_mixed_precision_cpu), or are configured by
+  // environment variables.
+  string cpu_features;
+  for (int feature = 0; feature <= port::AVX512_BF16; ++feature) {
+    const bool supported =
+        port::TestCPUFeature(static_cast<port::CPUFeature>(feature));
+    cpu_features.push_back(supported ? '1' : '0');
+  }
+  append(cpu_features);
+  for (const char* prefix : {"TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_",
+                             "TF_AUTO_MIXED_PRECISION_CPU_GRAPH_REWRITE_"}) {
+    for (const char* variable :
+         {"LEVEL", "IGNORE_PERFORMANCE", "WHITELIST_ADD", "WHITELIST_REMOVE",
+          "GRAYLIST_ADD", "GRAYLIST_REMOVE", "BLACKLIST_ADD",
+          "BLACKLIST_REMOVE", "CLEARLIST_ADD", "CLEARLIST_REMOVE"}) {
+      const string name = strings::StrCat(prefix, variable);
+      const char* value = std::getenv(name.c_str());
+      append(value == nullptr ? "" : value);
+    }
+  }
+
+  // The graph and the nodes to preserve.
+  append_proto(item.graph);
+  append(strings::StrCat(item.feed.size()));
+  for (const auto& feed : item.feed) {
+    append(feed.first);
+    TensorProto tensor;
+    feed.second.AsProtoTensorContent(&tensor);
+    append_proto(tensor);
+  }
+  append_list(item.fetch);
+  append_list(item.init_ops);
+  append_list(item.keep_ops);
+  append(item.save_op);
+  append(item.restore_op);
+  append(item.save_restore_loc_tensor);
+  append(strings::StrCat(item.queue_runners.size()));
+  for (const QueueRunnerDef& queue_runner : item.queue_runners) {
+    append_proto(queue_runner);
+  }
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  append(strings::StrCat(options.allow_non_differentiable_rewrites,
+                         options.allow_pruning_stateful_and_dataset_ops,
+                         options.optimize_function_library));
+
+  // The devices.
+  std::vector<string> item_devices(item.devices().begin(),
+                                   item.devices().end());
+  std::sort(item_devices.begin(), item_devices.end());
+  append_list(item_devices);
+  if (cluster != nullptr) {
+    std::map<string, DeviceProperties> cluster_devices(
+        cluster->GetDevices().begin(), cluster->GetDevices().end());
+    append(strings::StrCat(cluster_devices.size()));
+    for (const auto& device : cluster_devices) {
+      append(device.first);
+      append_proto(device.second);
+    }
+  }
+
+  const Fprint128 fingerprint = Fingerprint128(key);
+  return io::JoinPath(
+      cfg_.meta_optimizer_cache_dir(),
+      strings::Printf("%016llx%016llx.pb",
+                      static_cast<unsigned long long>(fingerprint.high64),
+                      static_cast<unsigned long long>(fingerprint.low64)));
+}
+
 Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                GraphDef* optimized_graph) {
+  if (cfg_.meta_optimizer_cache_dir().empty()) {
+    return OptimizeGraphAndFunctions(cluster, item, optimized_graph);
+  }
+
+  const string cache_path = OptimizedGraphCachePath(cluster, item);
+  Env* env = Env::Default();
+  if (env->FileExists(cache_path).ok()) {
+    Status status = ReadBinaryProto(env, cache_path, optimized_graph);
+    if (status.ok()) {
+      VLOG(1) << "Read the optimized graph of grappler item " << item.id
+              << " from " << cache_path;
+      optimization_results_.clear();
+      return Status::OK();
+    }
+    LOG(WARNING) << "Failed to read the optimized graph from " << cache_path
+                 << ", optimizing the graph again: " << status;
+  }
+
+  TF_RETURN_IF_ERROR(OptimizeGraphAndFunctions(cluster, item, optimized_graph));
+  // Optimizers that failed or timed out are skipped, unless
+  // fail_on_optimizer_errors is set. Don't cache the partially optimized
+  // graph, since they may succeed the next time.
+  for (const GraphOptimizationResult& graph_result : optimization_results_) {
+    for (const OptimizerResult& result : graph_result.results) {
+      if (!result.status.ok()) {
+        VLOG(1) << "Not caching the optimized graph of grappler item "
+                << item.id << ", since " << result.optimizer_name
+                << " failed: " << result.status;
+        return Status::OK();
+      }
+    }
+  }
+  if (DeadlineExceeded()) return Status::OK();
+  // The optimized graph is still valid if it can't be cached.
+  Status status = WriteOptimizedGraphToCache(cache_path, *optimized_graph);
+  if (status.ok()) {
+    VLOG(1) << "Wrote the optimized graph of grappler item " << item.id
+            << " to " << cache_path;
+  } else {
+    LOG(WARNING) << "Failed to write the optimized graph to " << cache_path
+                 << ": " << status;
+  }
+  return Status::OK();
+}
+
+Status MetaOptimizer::OptimizeGraphAndFunctions(Cluster* cluster,
+                                                const GrapplerItem& item,
+                                                GraphDef* optimized_graph) {
   VLOG(1) << "Starting optimization for grappler item: " << item.id;
   optimization_results_.clear();
 
@@ -542,7 +832,10 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       trimmed_item.graph.library().function_size());
 
   // 1. Optimize main graph
-  TF_RETURN_IF_ERROR(OptimizeGraph(cluster, trimmed_item, optimized_graph));
+  GraphOptimizationResult main_graph_result(trimmed_item.id);
+  TF_RETURN_IF_ERROR(OptimizeGraph(cluster, trimmed_item, optimized_graph,
+                                   &main_graph_result));
+  optimization_results_.push_back(std::move(main_graph_result));
   VLOG(1) << "Optimized main graph.";
   GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
 
@@ -575,9 +868,20 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   bool optimize_function_library =
       item.optimization_options().optimize_function_library;
 
+  const bool is_tpu_graph = IsTPUGraphDef(*optimized_graph);
+  const int num_threads = NumFunctionOptimizationThreads();
+
+  // Functions are optimized in rounds. All functions of a round are
+  // instantiated from the same version of the function library, optimized
+  // independently of each other (possibly in parallel), and then added back to
+  // the library in the library order. The optimized graph therefore doesn't
+  // depend on the number of threads.
   while (optimize_function_library) {
     optimize_function_library = false;
 
+    std::vector<string> func_names;
+    std::vector<GrapplerFunctionItem> func_items;
+
     for (const FunctionDef& func : optimized_graph->library().function()) {
       GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
 
@@ -646,27 +950,31 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
         }
       }
 
-      // Optimize function body graph.
-      GraphDef optimized_func_graph;
-      if (IsTPUGraphDef(*optimized_graph)) {
-        // Skip optimizing functions if this is a TPU graph. Currently, Grappler
-        // passes do not handle TPU functions correctly in a variety of ways
-        // (Note that due to the pre-placement TPU graph rewriting passes, the
-        // TPU-related ops are encapsulated away into functions). For example,
-        // TPU graphs contain TPUReplicateMetadata node that carries relevant
-        // TPU metadata and Grappler passes could prune that away. Grappler
-        // passes could also cause issues around shape inference. Since the
-        // desired and existing behavior is to not optimize TPU functions with
-        // Grappler, this check preserves that. The only execption is
-        // implementation selector what is required to swap in some TPU specific
-        // lowering code and is verified the work correctly on TPUs.
-        ImplementationSelector implementation_selector;
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        TF_RETURN_IF_ERROR(
-            OptimizeGraph(cluster, func_item, &optimized_func_graph));
-      }
+      func_names.push_back(func_name);
+      func_items.push_back(std::move(func_item));
+    }
+
+    if (func_items.empty()) break;
+
+    // Optimize function body graphs.
+    std::vector<GraphDef> optimized_func_graphs(func_items.size());
+    std::vector<GraphOptimizationResult> func_results;
+    func_results.reserve(func_items.size());
+    for (const GrapplerFunctionItem& func_item : func_items) {
+      func_results.emplace_back(func_item.id);
+    }
+    const uint64 start_us = Env::Default()->NowMicros();
+    TF_RETURN_IF_ERROR(OptimizeFunctions(cluster, is_tpu_graph, func_items,
+                                         num_threads, &optimized_func_graphs,
+                                         &func_results));
+    VLOG(1) << absl::Substitute(
+        "Optimized $0 function bodies in $1ms using $2 threads",
+        func_items.size(), (Env::Default()->NowMicros() - start_us) / 1000,
+        std::min<int>(num_threads, func_items.size()));
+
+    for (int i = 0; i < func_items.size(); ++i) {
+      GrapplerFunctionItem& func_item = func_items[i];
+      GraphDef& optimized_func_graph = optimized_func_graphs[i];
 
       // Function body optimization might have created new specialized
       // functions for each instantiation context. Add them to the library.
@@ -683,13 +991,15 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
 
       // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
-    }
+      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_names[i], optimized_func));
 
-    // If optimized at least one function, update the graph library.
-    if (optimize_function_library) {
-      *optimized_graph->mutable_library() = flib.ToProto();
+      if (!func_results[i].results.empty()) {
+        optimization_results_.push_back(std::move(func_results[i]));
+      }
     }
+
+    // Update the graph library with the optimized functions.
+    *optimized_graph->mutable_library() = flib.ToProto();
   }
 
   VLOG(1) << "Optimized " << optimized_funcs.size()
@@ -705,10 +1015,28 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
 }
 
 void MetaOptimizer::PrintResult() {
+  // Total time spent in each optimizer, in the order of the first run.
+  std::vector<std::pair<string, uint64>> total_duration_us;
+  absl::flat_hash_map<string, int> total_duration_index;
+
   for (const GraphOptimizationResult& graph_result : optimization_results_) {
     LOG(INFO) << "Optimization results for grappler item: " << graph_result.id;
     for (const OptimizerResult& result : graph_result.results) {
       LOG(INFO) << "  " << result.optimizer_name << ": " << result.message;
+
+      auto it = total_duration_index.emplace(result.optimizer_name,
+                                             total_duration_us.size());
+      if (it.second) total_duration_us.emplace_back(result.optimizer_name, 0);
+      total_duration_us[it.first->second].second += result.duration_us;
+    }
+  }
+
+  if (optimization_results_.size() > 1) {
+    LOG(INFO) << "Total optimization time over "
+              << optimization_results_.size() << " grappler items:";
+    for (const auto& optimizer_duration : total_duration_us) {
+      LOG(INFO) << "  " << optimizer_duration.first << ": "
+                << optimizer_duration.second / 1000.0f << "ms.";
     }
   }
 }
@@ -725,10 +1053,12 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
   }
   return !rewrite_cfg.disable_model_pruning() ||
          rewrite_cfg.layout_optimizer() != RewriterConfig::OFF ||
+         rewrite_cfg.cpu_layout_optimizer() == RewriterConfig::ON ||
          rewrite_cfg.function_optimization() != RewriterConfig::OFF ||
          rewrite_cfg.constant_folding() != RewriterConfig::OFF ||
          rewrite_cfg.shape_optimization() != RewriterConfig::OFF ||
          rewrite_cfg.remapping() != RewriterConfig::OFF ||
+         rewrite_cfg.cost_based_optimization() == RewriterConfig::ON ||
          rewrite_cfg.arithmetic_optimization() != RewriterConfig::OFF ||
          rewrite_cfg.loop_optimization() != RewriterConfig::OFF ||
          rewrite_cfg.dependency_optimization() != RewriterConfig::OFF ||
@@ -738,6 +1068,7 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
          rewrite_cfg.scoped_allocator_optimization() == RewriterConfig::ON ||
          rewrite_cfg.pin_to_host_optimization() == RewriterConfig::ON ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision()) ||
+         AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision_cpu()) ||
          !rewrite_cfg.optimizers().empty() ||
          !rewrite_cfg.custom_optimizers().empty();
 }
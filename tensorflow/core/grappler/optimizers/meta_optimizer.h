@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils/functions.h"
 #include "tensorflow/core/grappler/verifiers/graph_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
@@ -71,11 +72,6 @@ class MetaOptimizer : public GraphOptimizer {
       std::vector<std::unique_ptr<GraphVerifier>>* post_optimization_verifiers)
       const;
 
-  // Run optimization pass over a single GrapplerItem. Meta optimizer might run
-  // multiple such passes: 1) for the main graph 2) for the function library
-  Status OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
-                       GraphDef* optimized_graph);
-
   DeviceBase* const cpu_device_;  // may be NULL
   ConfigProto config_proto_;
   RewriterConfig& cfg_;
@@ -84,6 +80,7 @@ class MetaOptimizer : public GraphOptimizer {
     string optimizer_name;
     string message;
     Status status;
+    uint64 duration_us;
   };
 
   struct GraphOptimizationResult {
@@ -92,6 +89,37 @@ class MetaOptimizer : public GraphOptimizer {
     std::vector<OptimizerResult> results;
   };
 
+  // Optimizes the main graph of `item`, and then its function library.
+  Status OptimizeGraphAndFunctions(Cluster* cluster, const GrapplerItem& item,
+                                   GraphDef* optimized_graph);
+
+  // Returns the path of the optimized graph of `item` in the cache directory
+  // (RewriterConfig.meta_optimizer_cache_dir). The file name is a fingerprint
+  // of all the inputs of the optimizers, including the CPU features and the
+  // environment variables they read.
+  string OptimizedGraphCachePath(const Cluster* cluster,
+                                 const GrapplerItem& item) const;
+
+  // Run optimization pass over a single GrapplerItem. Meta optimizer might run
+  // multiple such passes: 1) for the main graph 2) for the function library.
+  // Results of individual optimizers are appended to `optimization_result`.
+  // Doesn't modify the state of the meta optimizer, and can be called
+  // concurrently for different items.
+  Status OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
+                       GraphDef* optimized_graph,
+                       GraphOptimizationResult* optimization_result);
+
+  // Optimizes function bodies on up to `num_threads` threads. Result `i` is
+  // written to `(*optimized_func_graphs)[i]` and `(*func_results)[i]`.
+  Status OptimizeFunctions(Cluster* cluster, bool is_tpu_graph,
+                           const std::vector<GrapplerFunctionItem>& func_items,
+                           int num_threads,
+                           std::vector<GraphDef>* optimized_func_graphs,
+                           std::vector<GraphOptimizationResult>* func_results);
+
+  // Number of threads used to optimize the function library.
+  int NumFunctionOptimizationThreads() const;
+
   Status RunOptimizer(GraphOptimizer* optimizer, Cluster* cluster,
                       GrapplerItem* optimized_item, GraphDef* optimized_graph,
                       GraphOptimizationResult* optimization_result);
@@ -21,17 +21,22 @@ limitations under the License.
 #include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/device_properties.pb.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -88,6 +93,18 @@ class TestOptimizerWithParams : public TestOptimizer {
 
 REGISTER_GRAPH_OPTIMIZER(TestOptimizerWithParams);
 
+class FailingOptimizer : public TestOptimizer {
+ public:
+  string name() const override { return "failing_optimizer"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    return errors::Internal("Failing optimizer");
+  }
+};
+
+REGISTER_GRAPH_OPTIMIZER(FailingOptimizer);
+
 // Record various properties of the GrapplerItems passed for optimization.
 class GrapplerItemPropertiesAccumulator : public CustomGraphOptimizer {
  public:
@@ -232,6 +249,123 @@ TEST_F(MetaOptimizerTest, RunToggleOptimizersAndCustomGraphOptimizerTwice) {
   EXPECT_TRUE(TestGraphOptimizer::IsOptimized());
 }
 
+TEST_F(MetaOptimizerTest, RemapsWithCostBasedOptimization) {
+  constexpr char kCpu[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+  Scope s = Scope::NewRootScope().WithDevice(kCpu);
+  auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                            ops::Placeholder::Shape({8, 32}));
+  auto y = ops::Placeholder(s.WithOpName("y"), DT_FLOAT,
+                            ops::Placeholder::Shape({8, 32}));
+  auto add = ops::Add(s.WithOpName("add"), x, y);
+  auto out = ops::Sigmoid(s.WithOpName("out"), add);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), out);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_cost_based_optimization(RewriterConfig::ON);
+  rewriter_config.set_arithmetic_optimization(RewriterConfig::OFF);
+  rewriter_config.set_dependency_optimization(RewriterConfig::OFF);
+  rewriter_config.set_min_graph_nodes(-1);
+
+  DeviceProperties cpu_device;
+  cpu_device.set_type("CPU");
+  cpu_device.set_frequency(1000);
+  cpu_device.set_num_cores(4);
+  cpu_device.set_bandwidth(32);
+  VirtualCluster cluster({{kCpu, cpu_device}});
+
+  // The cost model can't estimate the fused op, but the remapper still runs.
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(&cluster, item, &output));
+
+  NodeMap node_map(&output);
+  ASSERT_NE(node_map.GetNode("out"), nullptr);
+  EXPECT_EQ("_FusedElementwise", node_map.GetNode("out")->op());
+  EXPECT_EQ(node_map.GetNode("add"), nullptr);
+}
+
+TEST_F(MetaOptimizerTest, ReadsOptimizedGraphFromCache) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("TestOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_cache_dir(cache_dir);
+
+  // The first optimization runs the optimizers and caches the result.
+  TestOptimizer::SetOptimized(false);
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(TestOptimizer::IsOptimized());
+  std::vector<string> cached_files;
+  TF_EXPECT_OK(Env::Default()->GetChildren(cache_dir, &cached_files));
+  EXPECT_EQ(cached_files.size(), 1);
+
+  // Optimizing the same item again reads the cached graph.
+  TestOptimizer::SetOptimized(false);
+  MetaOptimizer cached_optimizer(nullptr, config_proto);
+  GraphDef cached_output;
+  TF_EXPECT_OK(cached_optimizer.Optimize(nullptr, item, &cached_output));
+  EXPECT_FALSE(TestOptimizer::IsOptimized());
+  CompareGraphs(output, cached_output);
+
+  // A different set of fetch nodes misses the cache.
+  item.fetch.push_back(item.graph.node(0).name());
+  TestOptimizer::SetOptimized(false);
+  MetaOptimizer other_optimizer(nullptr, config_proto);
+  GraphDef other_output;
+  TF_EXPECT_OK(other_optimizer.Optimize(nullptr, item, &other_output));
+  EXPECT_TRUE(TestOptimizer::IsOptimized());
+  TF_EXPECT_OK(Env::Default()->GetChildren(cache_dir, &cached_files));
+  EXPECT_EQ(cached_files.size(), 2);
+}
+
+TEST_F(MetaOptimizerTest, DoesNotCacheGraphIfAnOptimizerFails) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_failure_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("FailingOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_cache_dir(cache_dir);
+
+  // The failure is only logged, and the graph is not cached.
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  std::vector<string> cached_files;
+  Env::Default()->GetChildren(cache_dir, &cached_files).IgnoreError();
+  EXPECT_TRUE(cached_files.empty());
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibrary) {
   using test::function::NDef;
 
@@ -687,6 +821,82 @@ TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryWithRestrictions) {
       optimization_options_my_mul_2->allow_non_differentiable_rewrites);
 }
 
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryInParallel) {
+  using test::function::NDef;
+
+  // Define function library:
+  //
+  //   MyMul(x, y)    = x * y
+  //  *MySquare(x)    = MyMul(x, x)
+  //  *MyQuadratic(x) = MySquare(MySquare(x))
+  //
+  //  * - marked as noinline
+  FunctionDef mul_func = FunctionDefHelper::Create(
+      "MyMul", {"x:T", "y:T"}, {"z:T"}, {"T: {float, double}"},
+      {{{"mul"}, "Mul", {"x", "y"}, {{"T", "$T"}}}},
+      /*ret_def=*/
+      {{"z", "mul:z:0"}});
+
+  FunctionDef square_func = FunctionDefHelper::Create(
+      "MySquare", {"x:T"}, {"z:T"}, {"T: {float, double}"},
+      {{{"my_mul"}, "MyMul", {"x", "x"}, {{"T", "$T"}}}},
+      /*ret_def=*/
+      {{"z", "my_mul:z:0"}});
+  (*square_func.mutable_attr())["_noinline"].set_b(true);
+
+  FunctionDef quadratic_func = FunctionDefHelper::Create(
+      "MyQuadratic", {"x:T"}, {"z:T"}, {"T: {float, double}"},
+      {{{"square"}, "MySquare", {"x"}, {{"T", "$T"}}},
+       {{"quadratic"}, "MySquare", {"square:z"}, {{"T", "$T"}}}},
+      /*ret_def=*/
+      {{"z", "quadratic:z:0"}});
+  (*quadratic_func.mutable_attr())["_noinline"].set_b(true);
+
+  // Call every function from several call sites, so that each round of
+  // function library optimization has many specializations to optimize.
+  std::vector<NodeDef> nodes = {
+      NDef("a", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  GrapplerItem item;
+  item.id = "tf_graph";
+  for (int i = 0; i < 8; ++i) {
+    const string square = strings::StrCat("square_", i);
+    const string quadratic = strings::StrCat("quadratic_", i);
+    nodes.push_back(
+        NDef(square, "MySquare", {"a"}, {{"T", DT_FLOAT}}, kDevice));
+    nodes.push_back(
+        NDef(quadratic, "MyQuadratic", {square}, {{"T", DT_FLOAT}}, kDevice));
+    item.fetch.push_back(quadratic);
+  }
+  item.graph = test::function::GDef(
+      nodes, /*funcs=*/{mul_func, square_func, quadratic_func});
+
+  const auto optimize = [&item](int num_threads, GraphDef* output) {
+    ConfigProto config_proto;
+    auto& rewriter_config =
+        *config_proto.mutable_graph_options()->mutable_rewrite_options();
+    rewriter_config.set_meta_optimizer_iterations(RewriterConfig::TWO);
+    rewriter_config.set_min_graph_nodes(-1);
+    rewriter_config.set_meta_optimizer_num_threads(num_threads);
+
+    MetaOptimizer optimizer(nullptr, config_proto);
+    return optimizer.Optimize(nullptr, item, output);
+  };
+
+  GraphDef sequential;
+  TF_ASSERT_OK(optimize(/*num_threads=*/1, &sequential));
+  GraphDef parallel;
+  TF_ASSERT_OK(optimize(/*num_threads=*/4, &parallel));
+
+  // The optimized graph must not depend on the number of threads.
+  CompareGraphs(sequential, parallel);
+  ASSERT_EQ(sequential.library().function_size(),
+            parallel.library().function_size());
+  for (int i = 0; i < sequential.library().function_size(); ++i) {
+    CompareFunctions(sequential.library().function(i),
+                     parallel.library().function(i));
+  }
+}
+
 class SleepingOptimizer : public CustomGraphOptimizer {
  public:
   SleepingOptimizer() {}
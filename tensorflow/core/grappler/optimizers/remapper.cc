@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/symbolic_shapes.h"
 #include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace tensorflow {
@@ -40,12 +42,16 @@ namespace grappler {
 // MatMul + ... -> _FusedMatMul:
 //   (1) MatMul + BiasAdd + <Activation>
 //
+// Element-wise ops -> _FusedElementwise:
+//   (1) A tree of element-wise ops, e.g. Mul + Add + Sigmoid + Mul
+//
 // Both Conv2D and MatMul implemented as Tensor contraction (on CPU), so all the
 // patterns are "ContractionWith...".
 namespace {
 
 constexpr char kFusedConv2D[] = "_FusedConv2D";
 constexpr char kFusedMatMul[] = "_FusedMatMul";
+constexpr char kFusedElementwise[] = "_FusedElementwise";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
@@ -149,6 +155,18 @@ struct ContractionWithBatchNormAndActivation {
   float epsilon = 0.0;
 };
 
+// Tree of element-wise ops, in which every op but the root feeds only its
+// parent, evaluated by a single _FusedElementwise node.
+struct ElementwiseChain {
+  const NodeDef* root = nullptr;
+  // Fused ops in evaluation order; the root comes last.
+  std::vector<const NodeDef*> ops;
+  // Inputs of the fused node, and the operands of each fused op, as in the
+  // `fused_op_operands` attribute of _FusedElementwise.
+  std::vector<string> args;
+  std::vector<int32> operands;
+};
+
 bool IsInPreserveSet(const RemapperContext& ctx, const NodeDef* node) {
   return ctx.nodes_to_preserve.count(node->name()) > 0;
 }
@@ -531,6 +549,137 @@ bool FindFusedBatchNorm(const RemapperContext& ctx, const NodeDef* node,
   return true;
 }
 
+// Returns the number of inputs of an element-wise op that _FusedElementwise
+// can evaluate, or 0 if it cannot evaluate `node`. Keep in sync with
+// FusedElementwiseFns() in kernels/fused_elementwise_op.cc.
+int NumElementwiseOperands(const NodeDef& node) {
+  static const auto* const kUnaryOps = new absl::flat_hash_set<string>(
+      {"Abs", "Exp", "Log", "Neg", "Reciprocal", "Relu", "Rsqrt", "Sigmoid",
+       "Sqrt", "Square", "Tanh"});
+  static const auto* const kBinaryOps = new absl::flat_hash_set<string>(
+      {"Add", "AddV2", "Maximum", "Minimum", "Mul", "RealDiv",
+       "SquaredDifference", "Sub"});
+  const DataType dtype = GetDataTypeFromAttr(node, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return 0;
+  if (kUnaryOps->count(node.op()) > 0) return 1;
+  if (kBinaryOps->count(node.op()) > 0) return 2;
+  return 0;
+}
+
+// Check that given node can be the root of an element-wise chain. We use this
+// check to lazily infer graph properties.
+bool IsElementwiseChainCandidate(const RemapperContext& ctx,
+                                 const NodeDef& node) {
+  return NumElementwiseOperands(node) > 0 && NodeIsOnCpu(&node) &&
+         !HasControlFaninOrFanout(ctx.graph_view, &node);
+}
+
+// Returns true if `node` can be fused into the element-wise chain rooted at
+// `root`.
+bool CanFuseIntoElementwiseChain(const RemapperContext& ctx,
+                                 const NodeDef& node, const NodeDef& root) {
+  if (NumElementwiseOperands(node) == 0 || !HaveSameDataType(&node, &root) ||
+      node.device() != root.device() ||
+      HasControlFaninOrFanout(ctx.graph_view, &node) ||
+      !HasSingleFanoutNode(ctx.graph_view, &node) ||
+      IsInPreserveSet(ctx, &node)) {
+    return false;
+  }
+  // Leave activations of a Conv2D or MatMul with BiasAdd to the contraction
+  // fusions.
+  if (IsSupportedActivation(node)) {
+    const auto bias_add =
+        ctx.graph_view.GetRegularFanin(GraphView::InputPort(&node, 0));
+    ContractionWithBiasAdd contraction;
+    if (FindContractionWithBias(ctx, bias_add.node, &contraction)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds `node` and the element-wise ops feeding it to `matched`, in evaluation
+// order, and collects the arguments of the chain. Returns false if one of the
+// arguments is neither a scalar nor of the shape of the root's output.
+bool CollectElementwiseChain(const RemapperContext& ctx, const NodeDef* node,
+                             const TensorShapeProto& root_shape,
+                             ElementwiseChain* matched,
+                             absl::flat_hash_map<string, int>* arg_index) {
+  const auto& props = ctx.graph_properties.GetInputProperties(node->name());
+  const int num_operands = NumElementwiseOperands(*node);
+  if (props.size() != num_operands) return false;
+  for (int i = 0; i < num_operands; ++i) {
+    const auto fanin =
+        ctx.graph_view.GetRegularFanin(GraphView::InputPort(node, i));
+    if (fanin.node != nullptr &&
+        CanFuseIntoElementwiseChain(ctx, *fanin.node, *matched->root)) {
+      if (!CollectElementwiseChain(ctx, fanin.node, root_shape, matched,
+                                   arg_index)) {
+        return false;
+      }
+      continue;
+    }
+    const TensorShapeProto& shape = props[i].shape();
+    const bool is_scalar = !shape.unknown_rank() && shape.dim_size() == 0;
+    if (!is_scalar && !ShapesSymbolicallyEqual(shape, root_shape)) {
+      return false;
+    }
+    if (arg_index->count(node->input(i)) == 0) {
+      arg_index->emplace(node->input(i), matched->args.size());
+      matched->args.push_back(node->input(i));
+    }
+  }
+  matched->ops.push_back(node);
+  return true;
+}
+
+bool FindElementwiseChain(const RemapperContext& ctx, const NodeDef* root,
+                          ElementwiseChain* matched) {
+  if (!IsElementwiseChainCandidate(ctx, *root)) return false;
+
+  const auto& output_props =
+      ctx.graph_properties.GetOutputProperties(root->name());
+  if (output_props.empty() || output_props[0].shape().unknown_rank()) {
+    return false;
+  }
+
+  ElementwiseChain chain;
+  chain.root = root;
+  absl::flat_hash_map<string, int> arg_index;
+  if (!CollectElementwiseChain(ctx, root, output_props[0].shape(), &chain,
+                               &arg_index)) {
+    return false;
+  }
+  // A single op gains nothing from being fused.
+  if (chain.ops.size() < 2) return false;
+
+  // Values 0..num_args-1 are the arguments, and value num_args + i is the
+  // result of the i-th op.
+  const int num_args = chain.args.size();
+  absl::flat_hash_map<const NodeDef*, int> op_index;
+  for (const NodeDef* op : chain.ops) {
+    const int num_operands = NumElementwiseOperands(*op);
+    for (int i = 0; i < 2; ++i) {
+      if (i >= num_operands) {
+        chain.operands.push_back(-1);
+        continue;
+      }
+      const auto fanin =
+          ctx.graph_view.GetRegularFanin(GraphView::InputPort(op, i));
+      auto it = op_index.find(fanin.node);
+      if (it != op_index.end()) {
+        chain.operands.push_back(num_args + it->second);
+      } else {
+        chain.operands.push_back(arg_index.at(op->input(i)));
+      }
+    }
+    op_index.emplace(op, op_index.size());
+  }
+
+  *matched = std::move(chain);
+  return true;
+}
+
 void CopyConv2DAttributes(const NodeDef* conv2d, NodeDef* fused_conv2d) {
   DCHECK(IsConv2D(*conv2d)) << "Input node must be a Conv2D";
 
@@ -869,6 +1018,30 @@ void AddBatchNormNodes(const FusedBatchNorm& matched,
   *r->add_input() = a->name();
   *r->add_input() = c->name();
 }
+
+void AddFusedElementwiseNode(
+    const ElementwiseChain& matched, GraphDef* optimized_graph,
+    absl::flat_hash_set<const NodeDef*>* invalidated_nodes) {
+  std::vector<string> fused_ops;
+  for (const NodeDef* op : matched.ops) fused_ops.push_back(op->op());
+
+  VLOG(2) << "Fuse element-wise ops [" << str_util::Join(fused_ops, ", ")
+          << "] into " << matched.root->name();
+
+  NodeDef* fused_op = optimized_graph->add_node();
+  fused_op->set_name(matched.root->name());
+  fused_op->set_op(kFusedElementwise);
+  fused_op->set_device(matched.root->device());
+  for (const string& arg : matched.args) fused_op->add_input(arg);
+
+  auto* attr = fused_op->mutable_attr();
+  (*attr)["T"] = matched.root->attr().at("T");
+  SetAttrValue(static_cast<int32>(matched.args.size()), &(*attr)["num_args"]);
+  SetAttrValue(fused_ops, &(*attr)["fused_ops"]);
+  SetAttrValue(matched.operands, &(*attr)["fused_op_operands"]);
+
+  for (const NodeDef* op : matched.ops) invalidated_nodes->insert(op);
+}
 }  // namespace
 
 Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
@@ -881,6 +1054,7 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
   ContractionWithBatchNorm              contract_with_batch_norm;
   ContractionWithBatchNormAndActivation contract_with_batch_norm_and_activation;
   ContractionWithSqueezeAndBiasAdd      contract_with_squeeze_and_bias;
+  ElementwiseChain                      elementwise_chain;
   // clang-format on
 
   // Processing graph in reverse-topological sorted order allows to remap
@@ -972,6 +1146,21 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
       continue;
     }
 
+    // Remap a tree of element-wise ops into the _FusedElementwise, which
+    // evaluates it without materializing the intermediate results.
+    if (allow_non_differentiable_rewrites &&
+        IsElementwiseChainCandidate(ctx, node)) {
+      if (!ctx.inferred_graph_properties) {
+        TF_RETURN_IF_ERROR(ctx.graph_properties.InferStatically(false));
+        ctx.inferred_graph_properties = true;
+      }
+      if (FindElementwiseChain(ctx, &node, &elementwise_chain)) {
+        AddFusedElementwiseNode(elementwise_chain, optimized_graph,
+                                &invalidated_nodes);
+        continue;
+      }
+    }
+
     // If we didn't match a node to any pattern copy it to the optimized graph.
     *optimized_graph->add_node() = node;
   }
@@ -632,5 +632,130 @@ TEST_F(RemapperTest, FuseConv2DWithSqueezeAndBias) {
   test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
 }
 
+TEST_F(RemapperTest, FuseElementwiseChain) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto x =
+      Placeholder(s.WithOpName("x"), DT_FLOAT, Placeholder::Shape({8, 32}));
+  auto y =
+      Placeholder(s.WithOpName("y"), DT_FLOAT, Placeholder::Shape({8, 32}));
+
+  auto mul = ops::Mul(s.WithOpName("mul"), x, y);
+  auto add = ops::Add(s.WithOpName("add"), mul, x);
+  auto sigmoid = ops::Sigmoid(s.WithOpName("sigmoid"), add);
+  auto out = ops::Mul(s.WithOpName("out"), sigmoid, y);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), out);
+
+  auto x_t = GenerateRandomTensor<DT_FLOAT>({8, 32});
+  auto y_t = GenerateRandomTensor<DT_FLOAT>({8, 32});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"x", x_t}, {"y", y_t}};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("mul", node.name());
+    EXPECT_NE("add", node.name());
+    EXPECT_NE("sigmoid", node.name());
+    if (node.name() == "out") {
+      EXPECT_EQ("_FusedElementwise", node.op());
+      ASSERT_EQ(2, node.input_size());
+      EXPECT_EQ("x", node.input(0));
+      EXPECT_EQ("y", node.input(1));
+      EXPECT_EQ(2, node.attr().at("num_args").i());
+
+      const auto fused_ops = node.attr().at("fused_ops").list().s();
+      ASSERT_EQ(4, fused_ops.size());
+      EXPECT_EQ("Mul", fused_ops[0]);
+      EXPECT_EQ("Add", fused_ops[1]);
+      EXPECT_EQ("Sigmoid", fused_ops[2]);
+      EXPECT_EQ("Mul", fused_ops[3]);
+
+      const auto operands = node.attr().at("fused_op_operands").list().i();
+      EXPECT_EQ(std::vector<int64>({0, 1, 2, 0, 3, -1, 4, 1}),
+                std::vector<int64>(operands.begin(), operands.end()));
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  EXPECT_EQ(1, tensors_expected.size());
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseElementwiseChainWithSharedInput) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto x =
+      Placeholder(s.WithOpName("x"), DT_FLOAT, Placeholder::Shape({8, 32}));
+  auto half = ops::Const(s.WithOpName("half"), 0.5f);
+
+  // `scaled` feeds two ops, so it is an argument of the fused node.
+  auto scaled = ops::Mul(s.WithOpName("scaled"), x, half);
+  auto tanh = ops::Tanh(s.WithOpName("tanh"), scaled);
+  auto add = ops::Add(s.WithOpName("add"), tanh, scaled);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), add);
+
+  auto x_t = GenerateRandomTensor<DT_FLOAT>({8, 32});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"x", x_t}};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "add") {
+      EXPECT_EQ("_FusedElementwise", node.op());
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("scaled", node.input(0));
+
+      const auto fused_ops = node.attr().at("fused_ops").list().s();
+      ASSERT_EQ(2, fused_ops.size());
+      EXPECT_EQ("Tanh", fused_ops[0]);
+      EXPECT_EQ("Add", fused_ops[1]);
+      found++;
+    } else if (node.name() == "scaled") {
+      // A single op is not worth fusing.
+      EXPECT_EQ("Mul", node.op());
+      found++;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  EXPECT_EQ(1, tensors_expected.size());
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
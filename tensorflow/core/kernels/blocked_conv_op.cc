@@ -0,0 +1,235 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/nn_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <functional>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/padding.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+// Dimensions of a _BlockedConv2D, in elements.
+struct BlockedConvDims {
+  int64 batch;
+  int64 in_blocks;
+  int64 in_rows;
+  int64 in_cols;
+  int64 in_channels;
+  int64 out_blocks;
+  int64 filter_rows;
+  int64 filter_cols;
+  int64 out_rows;
+  int64 out_cols;
+  int64 stride_rows;
+  int64 stride_cols;
+  int64 pad_rows;
+  int64 pad_cols;
+};
+
+// Computes the output rows [begin, end) of the blocked convolution, where the
+// rows are numbered over (batch, out_block, out_row).
+//
+// Each output pixel of a block is a vector of kBlockSize output channels, which
+// fits in one (or two) SIMD registers, and is accumulated as the sum of
+// in_channel * filter_height * filter_width products of an input value by a
+// contiguous vector of kBlockSize filter weights.
+template <typename T, int kBlockSize>
+void BlockedConvRows(const BlockedConvDims& dims, const T* input,
+                     const T* filter, T* output, int64 begin, int64 end) {
+  using Vector = Eigen::Array<T, kBlockSize, 1>;
+  using ConstVectorMap = Eigen::Map<const Vector, Eigen::Unaligned>;
+  using VectorMap = Eigen::Map<Vector, Eigen::Unaligned>;
+
+  const int64 in_block_stride = dims.in_rows * dims.in_cols * kBlockSize;
+  const int64 filter_pixel_stride = dims.in_channels * kBlockSize;
+
+  for (int64 row = begin; row < end; ++row) {
+    const int64 out_row = row % dims.out_rows;
+    const int64 out_block = (row / dims.out_rows) % dims.out_blocks;
+    const int64 b = row / (dims.out_rows * dims.out_blocks);
+
+    const T* input_batch = input + b * dims.in_blocks * in_block_stride;
+    const T* filter_block = filter + out_block * dims.filter_rows *
+                                         dims.filter_cols *
+                                         filter_pixel_stride;
+    T* output_row = output + row * dims.out_cols * kBlockSize;
+
+    for (int64 out_col = 0; out_col < dims.out_cols; ++out_col) {
+      Vector acc = Vector::Zero();
+      for (int64 fr = 0; fr < dims.filter_rows; ++fr) {
+        const int64 in_row = out_row * dims.stride_rows - dims.pad_rows + fr;
+        if (in_row < 0 || in_row >= dims.in_rows) continue;
+        for (int64 fc = 0; fc < dims.filter_cols; ++fc) {
+          const int64 in_col = out_col * dims.stride_cols - dims.pad_cols + fc;
+          if (in_col < 0 || in_col >= dims.in_cols) continue;
+          const T* input_pixel =
+              input_batch + (in_row * dims.in_cols + in_col) * kBlockSize;
+          const T* filter_pixel =
+              filter_block + (fr * dims.filter_cols + fc) * filter_pixel_stride;
+          for (int64 in_block = 0; in_block < dims.in_blocks; ++in_block) {
+            const T* in = input_pixel + in_block * in_block_stride;
+            const T* f = filter_pixel + in_block * kBlockSize * kBlockSize;
+            for (int lane = 0; lane < kBlockSize; ++lane) {
+              acc += in[lane] * ConstVectorMap(f + lane * kBlockSize);
+            }
+          }
+        }
+      }
+      VectorMap(output_row + out_col * kBlockSize) = acc;
+    }
+  }
+}
+
+template <typename T>
+class BlockedConv2DOp : public OpKernel {
+ public:
+  explicit BlockedConv2DOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
+    OP_REQUIRES(context, strides_.size() == 4,
+                errors::InvalidArgument("Sliding window strides field must "
+                                        "specify 4 dimensions"));
+    OP_REQUIRES(context, strides_[0] == 1 && strides_[3] == 1,
+                errors::Unimplemented(
+                    "Current implementation does not yet support "
+                    "strides in the batch and depth dimensions."));
+    OP_REQUIRES(context, strides_[1] > 0 && strides_[2] > 0,
+                errors::InvalidArgument("Strides must be positive"));
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+    OP_REQUIRES_OK(context, context->GetAttr("block_size", &block_size_));
+    OP_REQUIRES(
+        context, block_size_ == 8 || block_size_ == 16,
+        errors::Unimplemented("Unsupported block size: ", block_size_,
+                              ". Only blocks of 8 and 16 channels are "
+                              "supported."));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    const Tensor& filter = context->input(1);
+    OP_REQUIRES(context, input.dims() == 5,
+                errors::InvalidArgument("input must be 5-dimensional: ",
+                                        input.shape().DebugString()));
+    OP_REQUIRES(context, filter.dims() == 5,
+                errors::InvalidArgument("filter must be 5-dimensional: ",
+                                        filter.shape().DebugString()));
+    OP_REQUIRES(context,
+                input.dim_size(4) == block_size_ &&
+                    filter.dim_size(4) == block_size_,
+                errors::InvalidArgument(
+                    "The last dimension of the input and filter must be the "
+                    "block size ",
+                    block_size_, ": ", input.shape().DebugString(), " vs ",
+                    filter.shape().DebugString()));
+
+    BlockedConvDims dims;
+    dims.batch = input.dim_size(0);
+    dims.in_blocks = input.dim_size(1);
+    dims.in_rows = input.dim_size(2);
+    dims.in_cols = input.dim_size(3);
+    dims.in_channels = dims.in_blocks * block_size_;
+    dims.out_blocks = filter.dim_size(0);
+    dims.filter_rows = filter.dim_size(1);
+    dims.filter_cols = filter.dim_size(2);
+    OP_REQUIRES(context, filter.dim_size(3) == dims.in_channels,
+                errors::InvalidArgument(
+                    "filter must have as many input channels as the input: ",
+                    filter.dim_size(3), " vs ", dims.in_channels));
+    dims.stride_rows = strides_[1];
+    dims.stride_cols = strides_[2];
+
+    int64 unused_pad_after;
+    OP_REQUIRES_OK(context, GetWindowedOutputSizeVerbose(
+                                dims.in_rows, dims.filter_rows,
+                                dims.stride_rows, padding_, &dims.out_rows,
+                                &dims.pad_rows, &unused_pad_after));
+    OP_REQUIRES_OK(context, GetWindowedOutputSizeVerbose(
+                                dims.in_cols, dims.filter_cols,
+                                dims.stride_cols, padding_, &dims.out_cols,
+                                &dims.pad_cols, &unused_pad_after));
+
+    TensorShape out_shape({dims.batch, dims.out_blocks, dims.out_rows,
+                           dims.out_cols, block_size_});
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, out_shape, &output));
+    if (out_shape.num_elements() == 0) return;
+
+    const T* input_data = input.flat<T>().data();
+    const T* filter_data = filter.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    const int64 num_rows = dims.batch * dims.out_blocks * dims.out_rows;
+
+    std::function<void(int64, int64)> compute_fn;
+    if (block_size_ == 8) {
+      compute_fn = [&dims, input_data, filter_data, output_data](int64 begin,
+                                                                 int64 end) {
+        BlockedConvRows<T, 8>(dims, input_data, filter_data, output_data,
+                              begin, end);
+      };
+    } else {
+      compute_fn = [&dims, input_data, filter_data, output_data](int64 begin,
+                                                                 int64 end) {
+        BlockedConvRows<T, 16>(dims, input_data, filter_data, output_data,
+                               begin, end);
+      };
+    }
+
+    // Each output row does one multiply-add of a block for every input
+    // channel of every filter tap of every output pixel.
+    const double flops_per_row = 2.0 * dims.out_cols * dims.filter_rows *
+                                 dims.filter_cols * dims.in_channels *
+                                 block_size_;
+    const Eigen::TensorOpCost cost(
+        /*bytes_loaded=*/sizeof(T) * dims.out_cols * dims.filter_rows *
+            dims.filter_cols * dims.in_channels * (1 + block_size_),
+        /*bytes_stored=*/sizeof(T) * dims.out_cols * block_size_,
+        /*compute_cycles=*/flops_per_row);
+    const CPUDevice& device = context->eigen_device<CPUDevice>();
+    device.parallelFor(num_rows, cost, std::move(compute_fn));
+  }
+
+ private:
+  std::vector<int32> strides_;
+  Padding padding_;
+  int64 block_size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BlockedConv2DOp);
+};
+
+}  // namespace
+
+#define REGISTER_CPU(T)                                                 \
+  REGISTER_KERNEL_BUILDER(                                              \
+      Name("_BlockedConv2D").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      BlockedConv2DOp<T>);
+
+REGISTER_CPU(float);
+
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
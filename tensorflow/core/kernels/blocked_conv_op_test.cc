@@ -0,0 +1,153 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class BlockedConv2DOpTest : public OpsTestBase {
+ protected:
+  // Runs a _BlockedConv2D on an NHWC input and an HWIO filter converted to the
+  // blocked layouts, and compares its output, converted back to NHWC, with a
+  // direct computation of the convolution.
+  void RunAndCompare(int batch, int rows, int cols, int in_depth,
+                     int filter_size, int out_depth, int stride,
+                     const string& padding, int block_size) {
+    TF_ASSERT_OK(NodeDefBuilder("blocked_conv", "_BlockedConv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", padding)
+                     .Attr("block_size", block_size)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    std::vector<float> input(batch * rows * cols * in_depth);
+    for (int i = 0; i < input.size(); ++i) input[i] = (i % 7) * 0.5f - 1.5f;
+    std::vector<float> filter(filter_size * filter_size * in_depth *
+                              out_depth);
+    for (int i = 0; i < filter.size(); ++i) filter[i] = (i % 5) * 0.25f - 0.5f;
+
+    const int in_blocks = in_depth / block_size;
+    const int out_blocks = out_depth / block_size;
+    std::vector<float> blocked_input(input.size());
+    for (int b = 0; b < batch; ++b)
+      for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < cols; ++c)
+          for (int d = 0; d < in_depth; ++d) {
+            const int nhwc = ((b * rows + r) * cols + c) * in_depth + d;
+            const int blocked =
+                (((b * in_blocks + d / block_size) * rows + r) * cols + c) *
+                    block_size +
+                d % block_size;
+            blocked_input[blocked] = input[nhwc];
+          }
+    std::vector<float> blocked_filter(filter.size());
+    for (int fr = 0; fr < filter_size; ++fr)
+      for (int fc = 0; fc < filter_size; ++fc)
+        for (int i = 0; i < in_depth; ++i)
+          for (int o = 0; o < out_depth; ++o) {
+            const int hwio =
+                ((fr * filter_size + fc) * in_depth + i) * out_depth + o;
+            const int blocked =
+                (((o / block_size * filter_size + fr) * filter_size + fc) *
+                     in_depth +
+                 i) * block_size +
+                o % block_size;
+            blocked_filter[blocked] = filter[hwio];
+          }
+    AddInputFromArray<float>(
+        TensorShape({batch, in_blocks, rows, cols, block_size}),
+        blocked_input);
+    AddInputFromArray<float>(TensorShape({out_blocks, filter_size,
+                                          filter_size, in_depth, block_size}),
+                             blocked_filter);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Padding padding_type = padding == "SAME" ? SAME : VALID;
+    int64 out_rows, out_cols, pad_rows, pad_cols, unused;
+    TF_ASSERT_OK(GetWindowedOutputSizeVerbose(rows, filter_size, stride,
+                                              padding_type, &out_rows,
+                                              &pad_rows, &unused));
+    TF_ASSERT_OK(GetWindowedOutputSizeVerbose(cols, filter_size, stride,
+                                              padding_type, &out_cols,
+                                              &pad_cols, &unused));
+    Tensor expected(DT_FLOAT, TensorShape({batch, out_blocks, out_rows,
+                                           out_cols, block_size}));
+    auto expected_values = expected.tensor<float, 5>();
+    for (int b = 0; b < batch; ++b)
+      for (int r = 0; r < out_rows; ++r)
+        for (int c = 0; c < out_cols; ++c)
+          for (int o = 0; o < out_depth; ++o) {
+            float sum = 0.0f;
+            for (int fr = 0; fr < filter_size; ++fr)
+              for (int fc = 0; fc < filter_size; ++fc) {
+                const int in_r = r * stride - pad_rows + fr;
+                const int in_c = c * stride - pad_cols + fc;
+                if (in_r < 0 || in_r >= rows || in_c < 0 || in_c >= cols) {
+                  continue;
+                }
+                for (int i = 0; i < in_depth; ++i) {
+                  sum += input[((b * rows + in_r) * cols + in_c) * in_depth +
+                               i] *
+                         filter[((fr * filter_size + fc) * in_depth + i) *
+                                    out_depth +
+                                o];
+                }
+              }
+            expected_values(b, o / block_size, r, c, o % block_size) = sum;
+          }
+    test::ExpectClose(expected, *GetOutput(0), 1e-4);
+  }
+};
+
+TEST_F(BlockedConv2DOpTest, Block8SamePadding) {
+  RunAndCompare(/*batch=*/2, /*rows=*/5, /*cols=*/6, /*in_depth=*/16,
+                /*filter_size=*/3, /*out_depth=*/8, /*stride=*/1, "SAME",
+                /*block_size=*/8);
+}
+
+TEST_F(BlockedConv2DOpTest, Block16ValidPaddingStrided) {
+  RunAndCompare(/*batch=*/1, /*rows=*/7, /*cols=*/7, /*in_depth=*/16,
+                /*filter_size=*/3, /*out_depth=*/32, /*stride=*/2, "VALID",
+                /*block_size=*/16);
+}
+
+TEST_F(BlockedConv2DOpTest, RejectsUnsupportedBlockSize) {
+  TF_ASSERT_OK(NodeDefBuilder("blocked_conv", "_BlockedConv2D")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("strides", {1, 1, 1, 1})
+                   .Attr("padding", "SAME")
+                   .Attr("block_size", 4)
+                   .Finalize(node_def()));
+  Status s = InitOp();
+  EXPECT_TRUE(errors::IsUnimplemented(s)) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,299 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/cwise_ops.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+// Number of elements of each operand and intermediate result that are
+// evaluated at a time. Chosen so that the tiles of a typical chain stay in the
+// L1/L2 cache while the whole expression is evaluated.
+constexpr int64 kTileSize = 1024;
+
+template <typename T>
+struct FusedElementwiseFn {
+  using InputBuffer = typename TTypes<T>::ConstFlat;
+  using OutputBuffer = typename TTypes<T>::Flat;
+
+  using UnaryFn = void (*)(const InputBuffer&, OutputBuffer*);
+  using BinaryFn = void (*)(const InputBuffer&, const InputBuffer&,
+                            OutputBuffer*);
+
+  // Exactly one of `unary` and `binary` is set.
+  UnaryFn unary = nullptr;
+  BinaryFn binary = nullptr;
+  int cost = 0;
+};
+
+template <typename T, typename Functor>
+void ComputeUnary(const typename TTypes<T>::ConstFlat& in,
+                  typename TTypes<T>::Flat* out) {
+  *out = in.unaryExpr(typename Functor::func());
+}
+
+template <typename T>
+void ComputeRelu(const typename TTypes<T>::ConstFlat& in,
+                 typename TTypes<T>::Flat* out) {
+  *out = in.cwiseMax(static_cast<T>(0));
+}
+
+template <typename T, typename Functor>
+void ComputeBinary(const typename TTypes<T>::ConstFlat& lhs,
+                   const typename TTypes<T>::ConstFlat& rhs,
+                   typename TTypes<T>::Flat* out) {
+  *out = lhs.binaryExpr(rhs, typename Functor::func());
+}
+
+template <typename T, typename Functor>
+FusedElementwiseFn<T> Unary() {
+  FusedElementwiseFn<T> fn;
+  fn.unary = ComputeUnary<T, Functor>;
+  fn.cost = Eigen::internal::functor_traits<typename Functor::func>::Cost;
+  return fn;
+}
+
+template <typename T, typename Functor>
+FusedElementwiseFn<T> Binary() {
+  FusedElementwiseFn<T> fn;
+  fn.binary = ComputeBinary<T, Functor>;
+  fn.cost = Eigen::internal::functor_traits<typename Functor::func>::Cost;
+  return fn;
+}
+
+// Returns the compute functions of the ops that can be fused, by op name. Keep
+// in sync with NumElementwiseOperands() in grappler/optimizers/remapper.cc.
+template <typename T>
+const std::unordered_map<string, FusedElementwiseFn<T>>& FusedElementwiseFns() {
+  static const auto* fns = [] {
+    auto* fns = new std::unordered_map<string, FusedElementwiseFn<T>>();
+    // Unary ops.
+    (*fns)["Abs"] = Unary<T, functor::abs<T>>();
+    (*fns)["Exp"] = Unary<T, functor::exp<T>>();
+    (*fns)["Log"] = Unary<T, functor::log<T>>();
+    (*fns)["Neg"] = Unary<T, functor::neg<T>>();
+    (*fns)["Reciprocal"] = Unary<T, functor::inverse<T>>();
+    (*fns)["Rsqrt"] = Unary<T, functor::rsqrt<T>>();
+    (*fns)["Sigmoid"] = Unary<T, functor::sigmoid<T>>();
+    (*fns)["Sqrt"] = Unary<T, functor::sqrt<T>>();
+    (*fns)["Square"] = Unary<T, functor::square<T>>();
+    (*fns)["Tanh"] = Unary<T, functor::tanh<T>>();
+    FusedElementwiseFn<T> relu;
+    relu.unary = ComputeRelu<T>;
+    relu.cost = Eigen::internal::functor_traits<
+        Eigen::internal::scalar_max_op<T>>::Cost;
+    (*fns)["Relu"] = relu;
+    // Binary ops.
+    (*fns)["Add"] = Binary<T, functor::add<T>>();
+    (*fns)["AddV2"] = Binary<T, functor::add<T>>();
+    (*fns)["Sub"] = Binary<T, functor::sub<T>>();
+    (*fns)["Mul"] = Binary<T, functor::mul<T>>();
+    (*fns)["RealDiv"] = Binary<T, functor::div<T>>();
+    (*fns)["Maximum"] = Binary<T, functor::maximum<T>>();
+    (*fns)["Minimum"] = Binary<T, functor::minimum<T>>();
+    (*fns)["SquaredDifference"] = Binary<T, functor::squared_difference<T>>();
+    return fns;
+  }();
+  return *fns;
+}
+
+}  // namespace
+
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  using Fn = FusedElementwiseFn<T>;
+  using InputBuffer = typename Fn::InputBuffer;
+  using OutputBuffer = typename Fn::OutputBuffer;
+
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args_));
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops_));
+    std::vector<int32> operands;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_op_operands", &operands));
+
+    OP_REQUIRES(context, !fused_ops_.empty(),
+                errors::InvalidArgument(
+                    "_FusedElementwise must have at least one fused op"));
+    OP_REQUIRES(context, operands.size() == 2 * fused_ops_.size(),
+                errors::InvalidArgument(
+                    "_FusedElementwise must have two operands per fused op, "
+                    "got ",
+                    operands.size(), " operands for ", fused_ops_.size(),
+                    " ops"));
+
+    const auto& fns = FusedElementwiseFns<T>();
+    for (int i = 0; i < fused_ops_.size(); ++i) {
+      auto it = fns.find(fused_ops_[i]);
+      OP_REQUIRES(context, it != fns.end(),
+                  errors::InvalidArgument("Unsupported fused op: ",
+                                          fused_ops_[i]));
+      Step step{it->second, operands[2 * i], operands[2 * i + 1]};
+      // Operands refer to the arguments, or to the results of earlier ops.
+      const int num_values = num_args_ + i;
+      const bool valid_lhs = step.lhs >= 0 && step.lhs < num_values;
+      const bool valid_rhs = step.fn.unary != nullptr
+                                 ? step.rhs == -1
+                                 : step.rhs >= 0 && step.rhs < num_values;
+      OP_REQUIRES(context, valid_lhs && valid_rhs,
+                  errors::InvalidArgument("Invalid operands ", step.lhs, ", ",
+                                          step.rhs, " of fused op ", i, ": ",
+                                          fused_ops_[i]));
+      steps_.push_back(step);
+      cost_ += step.fn.cost;
+    }
+
+    VLOG(2) << "Fused elementwise ops: [" << str_util::Join(fused_ops_, ", ")
+            << "]; num_args=" << num_args_ << " cost=" << cost_;
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    // All arguments that are not scalars must have the same shape, which is
+    // the shape of the output. Scalars are broadcast.
+    TensorShape shape;
+    std::vector<int> non_scalar_args;
+    for (int i = 0; i < num_args_; ++i) {
+      const Tensor& arg = ctx->input(i);
+      if (TensorShapeUtils::IsScalar(arg.shape())) continue;
+      if (non_scalar_args.empty()) {
+        shape = arg.shape();
+      } else {
+        OP_REQUIRES(ctx, arg.shape() == shape,
+                    errors::InvalidArgument(
+                        "_FusedElementwise arguments must be scalars or have "
+                        "the same shape, got ",
+                        shape.DebugString(), " and ", arg.shape().DebugString(),
+                        " for argument ", i));
+      }
+      non_scalar_args.push_back(i);
+    }
+
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->forward_input_or_allocate_output(
+                            non_scalar_args, 0, shape, &out));
+    const int64 num_elements = shape.num_elements();
+    if (num_elements == 0) return;
+
+    std::vector<const T*> args(num_args_);
+    std::vector<bool> is_scalar(num_args_);
+    for (int i = 0; i < num_args_; ++i) {
+      args[i] = ctx->input(i).flat<T>().data();
+      is_scalar[i] = TensorShapeUtils::IsScalar(ctx->input(i).shape());
+    }
+    T* out_data = out->flat<T>().data();
+
+    auto compute_fn = [this, &args, &is_scalar, out_data](int64 begin,
+                                                          int64 end) {
+      EvaluateRange(args, is_scalar, out_data, begin, end);
+    };
+
+    const CPUDevice& device = ctx->eigen_device<CPUDevice>();
+    const int kOverheadCycles = static_cast<int>(steps_.size()) * 10;
+    Eigen::TensorOpCost cost(/*bytes_loaded=*/sizeof(T) * num_args_,
+                             /*bytes_stored=*/sizeof(T),
+                             kOverheadCycles + cost_);
+    device.parallelFor(num_elements, cost, std::move(compute_fn));
+  }
+
+ private:
+  struct Step {
+    Fn fn;
+    int lhs;
+    int rhs;  // -1 for unary ops.
+  };
+
+  // Evaluates the fused ops for the elements [begin, end) of the output, one
+  // tile at a time, so that the intermediate results never leave the cache.
+  void EvaluateRange(const std::vector<const T*>& args,
+                     const std::vector<bool>& is_scalar, T* out_data,
+                     int64 begin, int64 end) const {
+    const int num_steps = steps_.size();
+    // One tile for each scalar argument, filled with its value, and one tile
+    // for the result of each op but the last, which is written to the output.
+    int num_scalar_args = 0;
+    for (bool scalar : is_scalar) num_scalar_args += scalar;
+    const int64 tile_size = std::min(kTileSize, end - begin);
+    std::vector<T> scratch((num_scalar_args + num_steps - 1) * tile_size);
+    T* next_tile = scratch.data();
+
+    // Pointers to the current tile of each argument and intermediate result.
+    std::vector<const T*> values(num_args_ + num_steps);
+    for (int i = 0; i < num_args_; ++i) {
+      if (!is_scalar[i]) continue;
+      std::fill(next_tile, next_tile + tile_size, *args[i]);
+      values[i] = next_tile;
+      next_tile += tile_size;
+    }
+    std::vector<T*> results(num_steps);
+    for (int i = 0; i < num_steps - 1; ++i) {
+      results[i] = next_tile;
+      next_tile += tile_size;
+    }
+
+    for (int64 offset = begin; offset < end; offset += tile_size) {
+      const int64 len = std::min(tile_size, end - offset);
+      for (int i = 0; i < num_args_; ++i) {
+        if (!is_scalar[i]) values[i] = args[i] + offset;
+      }
+      results[num_steps - 1] = out_data + offset;
+      for (int i = 0; i < num_steps; ++i) {
+        const Step& step = steps_[i];
+        const InputBuffer lhs(values[step.lhs], len);
+        OutputBuffer result(results[i], len);
+        if (step.fn.unary != nullptr) {
+          step.fn.unary(lhs, &result);
+        } else {
+          const InputBuffer rhs(values[step.rhs], len);
+          step.fn.binary(lhs, rhs, &result);
+        }
+        values[num_args_ + i] = results[i];
+      }
+    }
+  }
+
+  int num_args_;
+  std::vector<string> fused_ops_;
+  std::vector<Step> steps_;
+  int cost_ = 0;
+};
+
+#define REGISTER_CPU(T)                                                    \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedElementwise").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedElementwiseOp<T>);
+
+REGISTER_CPU(float);
+REGISTER_CPU(double);
+
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
@@ -0,0 +1,96 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status InitFusedOp(int num_args, const std::vector<string>& fused_ops,
+                     const std::vector<int>& operands) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("fused", "_FusedElementwise")
+                           .Input(FakeInput(num_args, DT_FLOAT))
+                           .Attr("T", DT_FLOAT)
+                           .Attr("num_args", num_args)
+                           .Attr("fused_ops", fused_ops)
+                           .Attr("fused_op_operands", operands)
+                           .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedElementwiseOpTest, EvaluatesChain) {
+  // (sigmoid(x * y + x) * y), over more elements than fit in one tile.
+  TF_ASSERT_OK(InitFusedOp(2, {"Mul", "Add", "Sigmoid", "Mul"},
+                           {0, 1, 2, 0, 3, -1, 4, 1}));
+  const int n = 5000;
+  std::vector<float> x(n), y(n), expected(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = (i % 17) * 0.25f - 2.0f;
+    y[i] = (i % 13) * 0.5f - 3.0f;
+    expected[i] = y[i] / (1.0f + std::exp(-(x[i] * y[i] + x[i])));
+  }
+  AddInputFromArray<float>(TensorShape({n}), x);
+  AddInputFromArray<float>(TensorShape({n}), y);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_tensor(DT_FLOAT, TensorShape({n}));
+  test::FillValues<float>(&expected_tensor, expected);
+  test::ExpectClose(expected_tensor, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, BroadcastsScalars) {
+  // relu(x * 2 - 1)
+  TF_ASSERT_OK(InitFusedOp(3, {"Mul", "Sub", "Relu"}, {0, 1, 3, 2, 4, -1}));
+  AddInputFromArray<float>(TensorShape({2, 2}), {-1, 0, 1, 2});
+  AddInputFromArray<float>(TensorShape({}), {2});
+  AddInputFromArray<float>(TensorShape({}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {0, 0, 1, 3});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, RejectsInvalidOperands) {
+  // The second op refers to its own result.
+  Status s = InitFusedOp(1, {"Neg", "Mul"}, {0, -1, 1, 2});
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  // Unsupported op.
+  s = InitFusedOp(1, {"MatMul"}, {0, 0});
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(FusedElementwiseOpTest, RejectsMismatchedShapes) {
+  TF_ASSERT_OK(InitFusedOp(2, {"Add"}, {0, 1}));
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -29,6 +29,8 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
@@ -114,9 +116,14 @@ struct PopulationCount<CPUDevice, T> {
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
 
+    // The static cost above is a rough guess; shard with the measured cost
+    // per element once it is known.
+    static thread::AdaptiveCostEstimate* estimate =
+        new thread::AdaptiveCostEstimate(strings::StrCat(
+            "PopulationCount/", DataTypeString(DataTypeToEnum<T>::value)));
     auto worker_threads = *(c->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, total_shards,
-          shard_cost, shard);
+          shard_cost, estimate, shard);
   }
 };
 
@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/lib/core/threadpool.h"
 
+#include <algorithm>
+#include <atomic>
+
 #define EIGEN_USE_THREADS
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/denormal.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -58,6 +62,11 @@ struct EigenEnvironment {
       if (thread_options_.numa_node != port::kNUMANoAffinity) {
         port::NUMASetThreadNodeAffinity(thread_options_.numa_node);
       }
+      if (!thread_options_.cpu_affinity.empty() &&
+          !port::SetCurrentThreadCPUAffinity(thread_options_.cpu_affinity)) {
+        LOG(WARNING) << "Could not pin thread of pool " << name_
+                     << " to the requested CPUs";
+      }
       f();
     });
   }
@@ -106,6 +115,79 @@ struct ThreadPool::Impl : Eigen::ThreadPoolTempl<EigenEnvironment> {
   Eigen::Allocator* allocator_;
 };
 
+namespace {
+
+// Weight of the newest measurement in AdaptiveCostEstimate's moving average.
+constexpr double kAdaptiveCostSmoothing = 0.25;
+
+mutex* AdaptiveCostEstimateRegistryMu() {
+  static mutex* mu = new mutex;
+  return mu;
+}
+
+std::vector<AdaptiveCostEstimate*>* AdaptiveCostEstimateRegistry() {
+  static std::vector<AdaptiveCostEstimate*>* registry =
+      new std::vector<AdaptiveCostEstimate*>;
+  return registry;
+}
+
+}  // namespace
+
+AdaptiveCostEstimate::AdaptiveCostEstimate(const string& name) : name_(name) {
+  mutex_lock l(*AdaptiveCostEstimateRegistryMu());
+  AdaptiveCostEstimateRegistry()->push_back(this);
+}
+
+AdaptiveCostEstimate::~AdaptiveCostEstimate() {
+  mutex_lock l(*AdaptiveCostEstimateRegistryMu());
+  auto* registry = AdaptiveCostEstimateRegistry();
+  registry->erase(std::remove(registry->begin(), registry->end(), this),
+                  registry->end());
+}
+
+int64 AdaptiveCostEstimate::CostPerUnit(int64 static_cost_per_unit) {
+  mutex_lock l(mu_);
+  static_cost_per_unit_ = static_cost_per_unit;
+  if (num_calls_ == 0) return static_cost_per_unit;
+  return std::max<int64>(1, static_cast<int64>(cost_per_unit_ + 0.5));
+}
+
+void AdaptiveCostEstimate::Record(int64 num_units, int64 busy_nanos) {
+  if (num_units <= 0) return;
+  const double measured = static_cast<double>(busy_nanos) / num_units;
+  mutex_lock l(mu_);
+  cost_per_unit_ = num_calls_ == 0
+                       ? measured
+                       : cost_per_unit_ + kAdaptiveCostSmoothing *
+                                              (measured - cost_per_unit_);
+  ++num_calls_;
+  num_units_ += num_units;
+  busy_nanos_ += busy_nanos;
+}
+
+AdaptiveCostEstimate::Stats AdaptiveCostEstimate::GetStats() const {
+  Stats stats;
+  stats.name = name_;
+  mutex_lock l(mu_);
+  stats.num_calls = num_calls_;
+  stats.num_units = num_units_;
+  stats.busy_nanos = busy_nanos_;
+  stats.static_cost_per_unit = static_cost_per_unit_;
+  stats.cost_per_unit =
+      num_calls_ == 0 ? 0 : static_cast<int64>(cost_per_unit_ + 0.5);
+  return stats;
+}
+
+/* static */
+std::vector<AdaptiveCostEstimate::Stats> AdaptiveCostEstimate::GetAllStats() {
+  std::vector<Stats> all;
+  mutex_lock l(*AdaptiveCostEstimateRegistryMu());
+  for (const AdaptiveCostEstimate* estimate : *AdaptiveCostEstimateRegistry()) {
+    all.push_back(estimate->GetStats());
+  }
+  return all;
+}
+
 ThreadPool::ThreadPool(Env* env, const string& name, int num_threads)
     : ThreadPool(env, ThreadOptions(), name, num_threads, true, nullptr) {}
 
@@ -181,6 +263,25 @@ void ThreadPool::ParallelFor(int64 total, int64 cost_per_unit,
   impl_->ParallelFor(total, cost_per_unit, std::move(fn));
 }
 
+void ThreadPool::ParallelFor(int64 total, int64 cost_per_unit,
+                             AdaptiveCostEstimate* estimate,
+                             std::function<void(int64, int64)> fn) {
+  if (estimate == nullptr) {
+    impl_->ParallelFor(total, cost_per_unit, std::move(fn));
+    return;
+  }
+  Env* env = Env::Default();
+  std::atomic<int64> busy_nanos(0);
+  impl_->ParallelFor(total, estimate->CostPerUnit(cost_per_unit),
+                     [env, &busy_nanos, &fn](int64 start, int64 limit) {
+                       const uint64 start_nanos = env->NowNanos();
+                       fn(start, limit);
+                       busy_nanos.fetch_add(env->NowNanos() - start_nanos,
+                                            std::memory_order_relaxed);
+                     });
+  estimate->Record(total, busy_nanos.load(std::memory_order_relaxed));
+}
+
 void ThreadPool::ParallelForWithWorkerId(
     int64 total, int64 cost_per_unit,
     const std::function<void(int64, int64, int)>& fn) {
@@ -18,9 +18,12 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace Eigen {
@@ -30,6 +33,64 @@ class ThreadPoolInterface;
 namespace tensorflow {
 namespace thread {
 
+// Learns the actual cost of one unit of work at a ParallelFor call site.
+//
+// Kernels pass a static cost_per_unit to ParallelFor, which is frequently off
+// by an order of magnitude. A ParallelFor given an AdaptiveCostEstimate times
+// every shard it runs and shards later calls using an exponential moving
+// average of the measured nanoseconds per unit instead of the static value.
+// Estimates are meant to be long-lived, typically one function-level static
+// per call site:
+//
+//   static thread::AdaptiveCostEstimate* estimate =
+//       new thread::AdaptiveCostEstimate("MyOp::Compute");
+//   pool->ParallelFor(total, kStaticCost, estimate, fn);
+//
+// Shard() in util/work_sharder.h also accepts an estimate.
+//
+// All live estimates are registered process-wide so that benchmarks can
+// inspect them with GetAllStats(). Thread-safe.
+class AdaptiveCostEstimate {
+ public:
+  explicit AdaptiveCostEstimate(const string& name);
+  ~AdaptiveCostEstimate();
+
+  // Returns the cost per unit that ParallelFor should shard with: the learned
+  // estimate once a call has been recorded, "static_cost_per_unit" before.
+  // Also remembers "static_cost_per_unit" for GetStats().
+  int64 CostPerUnit(int64 static_cost_per_unit);
+
+  // Records that "num_units" units of work took "busy_nanos" of thread time,
+  // summed over all shards.
+  void Record(int64 num_units, int64 busy_nanos);
+
+  struct Stats {
+    string name;
+    int64 num_calls = 0;
+    int64 num_units = 0;
+    int64 busy_nanos = 0;
+    // Last static cost passed by the call site, and the current estimate (0
+    // if nothing has been recorded yet).
+    int64 static_cost_per_unit = 0;
+    int64 cost_per_unit = 0;
+  };
+  Stats GetStats() const;
+
+  // Returns the statistics of every live estimate in the process.
+  static std::vector<Stats> GetAllStats();
+
+ private:
+  const string name_;
+  mutable mutex mu_;
+  int64 num_calls_ GUARDED_BY(mu_) = 0;
+  int64 num_units_ GUARDED_BY(mu_) = 0;
+  int64 busy_nanos_ GUARDED_BY(mu_) = 0;
+  int64 static_cost_per_unit_ GUARDED_BY(mu_) = 0;
+  double cost_per_unit_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AdaptiveCostEstimate);
+};
+
 class ThreadPool {
  public:
   // Constructs a pool that contains "num_threads" threads with specified
@@ -96,6 +157,15 @@ class ThreadPool {
   void ParallelFor(int64 total, int64 cost_per_unit,
                    std::function<void(int64, int64)> fn);
 
+  // Like ParallelFor above, but shards with the cost per unit learned by
+  // "estimate" (see AdaptiveCostEstimate), falling back to "cost_per_unit"
+  // until the first call completes, and feeds the measured cost of this call
+  // back into "estimate". "estimate" may be null, in which case this is
+  // equivalent to ParallelFor(total, cost_per_unit, fn).
+  void ParallelFor(int64 total, int64 cost_per_unit,
+                   AdaptiveCostEstimate* estimate,
+                   std::function<void(int64, int64)> fn);
+
   // Shards the "total" units of work. For more details, see "ParallelFor".
   //
   // The function is passed a thread_id between 0 and NumThreads() *inclusive*.
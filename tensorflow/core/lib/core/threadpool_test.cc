@@ -188,6 +188,42 @@ TEST(ThreadPool, ParallelForWithWorkerId) {
   }
 }
 
+TEST(ThreadPool, ParallelForAdaptive) {
+  // A static cost this large would put every unit in its own shard.
+  const int64 kHugeCost = 1 << 30;
+  const int kWorkItems = 1000;
+  AdaptiveCostEstimate estimate("ParallelForAdaptive");
+  EXPECT_EQ(kHugeCost, estimate.CostPerUnit(kHugeCost));
+  ThreadPool pool(Env::Default(), "test", kNumThreads);
+  for (int call = 0; call < 3; ++call) {
+    std::vector<std::atomic<bool>> work(kWorkItems);
+    for (auto& w : work) w = false;
+    pool.ParallelFor(kWorkItems, kHugeCost, &estimate,
+                     [&work](int64 begin, int64 end) {
+                       for (int64 i = begin; i < end; ++i) {
+                         ASSERT_FALSE(work[i].exchange(true));
+                       }
+                     });
+    for (const auto& w : work) ASSERT_TRUE(w);
+  }
+
+  const AdaptiveCostEstimate::Stats stats = estimate.GetStats();
+  EXPECT_EQ("ParallelForAdaptive", stats.name);
+  EXPECT_EQ(3, stats.num_calls);
+  EXPECT_EQ(3 * kWorkItems, stats.num_units);
+  EXPECT_EQ(kHugeCost, stats.static_cost_per_unit);
+  EXPECT_GE(stats.cost_per_unit, 1);
+  // Setting a bool takes far less than a second per unit.
+  EXPECT_LT(stats.cost_per_unit, kHugeCost);
+  EXPECT_EQ(stats.cost_per_unit, estimate.CostPerUnit(kHugeCost));
+
+  bool found = false;
+  for (const auto& s : AdaptiveCostEstimate::GetAllStats()) {
+    if (s.name == "ParallelForAdaptive") found = true;
+  }
+  EXPECT_TRUE(found);
+}
+
 static void BM_Sequential(int iters) {
   ThreadPool pool(Env::Default(), "test", kNumThreads);
   // Decrement count sequentially until 0.
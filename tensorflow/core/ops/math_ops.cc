@@ -323,6 +323,40 @@ REGISTER_OP("_UnaryOpsComposition")
 expected to create these operators.
 )doc");
 
+// Evaluates a tree of element-wise ops in a single pass over its arguments.
+// `fused_ops` are evaluated in order; the operands of op `i` are
+// `fused_op_operands[2 * i]` and `fused_op_operands[2 * i + 1]` (-1 for unary
+// ops), where values `0..num_args-1` are the arguments and value
+// `num_args + j` is the result of op `j`. The result of the last op is the
+// output. Arguments are scalars or all have the shape of the output.
+REGISTER_OP("_FusedElementwise")
+    .Input("args: num_args * T")
+    .Output("y: T")
+    .Attr("T: {float, double}")
+    .Attr("num_args: int >= 1")
+    .Attr("fused_ops: list(string)")
+    .Attr("fused_op_operands: list(int)")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle out = c->Scalar();
+      bool has_non_scalar_arg = false;
+      for (int i = 0; i < c->num_inputs(); ++i) {
+        ShapeHandle arg = c->input(i);
+        if (c->RankKnown(arg) && c->Rank(arg) == 0) continue;
+        if (!has_non_scalar_arg) {
+          out = arg;
+          has_non_scalar_arg = true;
+        } else {
+          TF_RETURN_IF_ERROR(c->Merge(out, arg, &out));
+        }
+      }
+      c->set_output(0, out);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
 #undef UNARY
 #undef UNARY_REAL
 #undef UNARY_COMPLEX
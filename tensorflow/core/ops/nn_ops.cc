@@ -341,6 +341,68 @@ REGISTER_OP("_FusedConv2D")
 expected to create these operators.
 )doc");
 
+// 2D convolution in the blocked NCHW[block_size]c layout:
+//   input:  [batch, in_channels / block_size, height, width, block_size]
+//   filter: [out_channels / block_size, filter_height, filter_width,
+//            in_channels, block_size]
+//   output: [batch, out_channels / block_size, out_height, out_width,
+//            block_size]
+// `strides` are given in the NHWC order, like for Conv2D.
+REGISTER_OP("_BlockedConv2D")
+    .Input("input: T")
+    .Input("filter: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("strides: list(int)")
+    .Attr(GetPaddingAttrString())
+    .Attr("block_size: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 5, &input));
+      ShapeHandle filter;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 5, &filter));
+
+      int64 block_size;
+      TF_RETURN_IF_ERROR(c->GetAttr("block_size", &block_size));
+      std::vector<int32> strides;
+      TF_RETURN_IF_ERROR(c->GetAttr("strides", &strides));
+      if (strides.size() != 4) {
+        return errors::InvalidArgument(
+            "_BlockedConv2D requires the stride attribute to contain 4 "
+            "values, but got: ",
+            strides.size());
+      }
+      Padding padding;
+      TF_RETURN_IF_ERROR(c->GetAttr("padding", &padding));
+
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->WithValue(c->Dim(input, 4), block_size, &unused));
+      TF_RETURN_IF_ERROR(
+          c->WithValue(c->Dim(filter, 4), block_size, &unused));
+      DimensionHandle in_channels;
+      TF_RETURN_IF_ERROR(
+          c->Multiply(c->Dim(input, 1), block_size, &in_channels));
+      TF_RETURN_IF_ERROR(c->Merge(in_channels, c->Dim(filter, 3), &unused));
+
+      DimensionHandle out_rows;
+      DimensionHandle out_cols;
+      TF_RETURN_IF_ERROR(GetWindowedOutputSizeFromDims(
+          c, c->Dim(input, 2), c->Dim(filter, 1), strides[1], padding,
+          &out_rows));
+      TF_RETURN_IF_ERROR(GetWindowedOutputSizeFromDims(
+          c, c->Dim(input, 3), c->Dim(filter, 2), strides[2], padding,
+          &out_cols));
+      c->set_output(0, c->MakeShape({c->Dim(input, 0), c->Dim(filter, 0),
+                                     out_rows, out_cols,
+                                     c->MakeDim(block_size)}));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
 namespace {
 
 Status CommonFusedConvCalculations(InferenceContext* c, bool has_resize) {
@@ -85,6 +85,7 @@ class CPUIDInfo {
         have_avx512ifma_(0),
         have_avx512_4vnniw_(0),
         have_avx512_4fmaps_(0),
+        have_avx512_bf16_(0),
         have_bmi1_(0),
         have_bmi2_(0),
         have_cmov_(0),
@@ -180,6 +181,7 @@ class CPUIDInfo {
     // Architectures Software Developer's Manual Volume 2A: Instruction Set
     // Reference, A-M CPUID).
     GETCPUID(eax, ebx, ecx, edx, 7, 0);
+    const uint32 max_level7_subleaf = eax;
 
     cpuid->have_adx_ = (ebx >> 19) & 0x1;
     cpuid->have_avx2_ = have_avx && ((ebx >> 5) & 0x1);
@@ -200,6 +202,13 @@ class CPUIDInfo {
     cpuid->have_avx512ifma_ = have_avx512 && ((ebx >> 21) & 0x1);
     cpuid->have_avx512_4vnniw_ = have_avx512 && ((edx >> 2) & 0x1);
     cpuid->have_avx512_4fmaps_ = have_avx512 && ((edx >> 3) & 0x1);
+
+    // Get the level 7 structured extension features of sub-leaf 1, which
+    // report the AVX-512 BF16 instructions (Cooper Lake and beyond).
+    if (max_level7_subleaf >= 1) {
+      GETCPUID(eax, ebx, ecx, edx, 7, 1);
+      cpuid->have_avx512_bf16_ = have_avx512 && ((eax >> 5) & 0x1);
+    }
   }
 
   static bool TestFeature(CPUFeature feature) {
@@ -221,6 +230,7 @@ class CPUIDInfo {
       case AVX512IFMA:    return cpuid->have_avx512ifma_;
       case AVX512_4VNNIW: return cpuid->have_avx512_4vnniw_;
       case AVX512_4FMAPS: return cpuid->have_avx512_4fmaps_;
+      case AVX512_BF16:   return cpuid->have_avx512_bf16_;
       case BMI1:          return cpuid->have_bmi1_;
       case BMI2:          return cpuid->have_bmi2_;
       case CMOV:          return cpuid->have_cmov_;
@@ -270,6 +280,7 @@ class CPUIDInfo {
   int have_avx512ifma_ : 1;
   int have_avx512_4vnniw_ : 1;
   int have_avx512_4fmaps_ : 1;
+  int have_avx512_bf16_ : 1;
   int have_bmi1_ : 1;
   int have_bmi2_ : 1;
   int have_cmov_ : 1;
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_PLATFORM_CPU_INFO_H_
 
 #include <string>
+#include <vector>
 
 // TODO(ahentz): This is not strictly required here but, for historical
 // reasons, many people depend on cpu_info.h in order to use kLittleEndian.
@@ -58,6 +59,11 @@ int NumTotalCPUs();
 // identified.  If successful, the return value will be in [0, NumTotalCPUs()).
 int GetCurrentCPU();
 
+// Restricts the calling thread to run only on the given logical CPU ids.
+// Returns false if the platform does not support CPU pinning or the request
+// failed (e.g. none of the ids is available to the process).
+bool SetCurrentThreadCPUAffinity(const std::vector<int>& cpus);
+
 // Returns an estimate of the number of hyperthreads per physical core
 // on the CPU
 int NumHyperthreadsPerCore();
@@ -116,6 +122,7 @@ enum CPUFeature {
   AVX512IFMA = 35,     // Integer multiply-add
   AVX512_4VNNIW = 36,  // Integer neural network
   AVX512_4FMAPS = 37,  // Floating point neural network
+  AVX512_BF16 = 38,    // Bfloat16 conversions and dot products
 };
 
 // Checks whether the current processor supports one of the features above.
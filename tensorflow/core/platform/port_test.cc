@@ -42,6 +42,23 @@ TEST(Port, GetCurrentCPU) {
 #endif
 }
 
+TEST(Port, SetCurrentThreadCPUAffinity) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  // The CPU we are running on is one the process may be pinned to.
+  const int cpu = GetCurrentCPU();
+  ASSERT_GE(cpu, 0);
+  ThreadOptions thread_options;
+  thread_options.cpu_affinity = {cpu};
+  int observed_cpu = -1;
+  {
+    thread::ThreadPool pool(Env::Default(), thread_options, "pinned", 1);
+    pool.Schedule([&observed_cpu]() { observed_cpu = GetCurrentCPU(); });
+  }
+  EXPECT_EQ(cpu, observed_cpu);
+  EXPECT_FALSE(SetCurrentThreadCPUAffinity({}));
+#endif
+}
+
 TEST(ConditionVariable, WaitForMilliseconds_Timeout) {
   mutex m;
   mutex_lock l(m);
@@ -116,6 +116,19 @@ int GetCurrentCPU() {
   return kUnknownCPU;
 }
 
+bool SetCurrentThreadCPUAffinity(const std::vector<int>& cpus) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpuset);
+  }
+  if (CPU_COUNT(&cpuset) == 0) return false;
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) return true;
+#endif
+  return false;
+}
+
 int NumHyperthreadsPerCore() {
   static const int ht_per_core = tensorflow::port::CPUIDNumSMT();
   return (ht_per_core > 0) ? ht_per_core : 1;
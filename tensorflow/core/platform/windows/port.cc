@@ -175,6 +175,10 @@ int64 AvailableRam() {
   return INT64_MAX;
 }
 
+bool SetCurrentThreadCPUAffinity(const std::vector<int>& cpus) {
+  return false;
+}
+
 int NumHyperthreadsPerCore() {
   static const int ht_per_core = tensorflow::port::CPUIDNumSMT();
   return (ht_per_core > 0) ? ht_per_core : 1;
@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/util/work_sharder.h"
 
+#include <atomic>
+
 #include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace tensorflow {
@@ -31,6 +34,13 @@ int GetPerThreadMaxParallelism() { return per_thread_max_parallism; }
 
 void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
            int64 cost_per_unit, std::function<void(int64, int64)> work) {
+  Shard(max_parallelism, workers, total, cost_per_unit, /*estimate=*/nullptr,
+        std::move(work));
+}
+
+void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
+           int64 cost_per_unit, thread::AdaptiveCostEstimate* estimate,
+           std::function<void(int64, int64)> work) {
   CHECK_GE(total, 0);
   if (total == 0) {
     return;
@@ -42,12 +52,27 @@ void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
     return;
   }
   if (max_parallelism >= workers->NumThreads()) {
-    workers->ParallelFor(total, cost_per_unit, work);
+    workers->ParallelFor(total, cost_per_unit, estimate, work);
+    return;
+  }
+  const Sharder::Runner runner = [&workers](Sharder::Closure c) {
+    workers->Schedule(c);
+  };
+  if (estimate == nullptr) {
+    Sharder::Do(total, cost_per_unit, work, runner, max_parallelism);
     return;
   }
-  Sharder::Do(total, cost_per_unit, work,
-              [&workers](Sharder::Closure c) { workers->Schedule(c); },
-              max_parallelism);
+  Env* env = Env::Default();
+  std::atomic<int64> busy_nanos(0);
+  Sharder::Do(total, estimate->CostPerUnit(cost_per_unit),
+              [env, &busy_nanos, &work](int64 start, int64 limit) {
+                const uint64 start_nanos = env->NowNanos();
+                work(start, limit);
+                busy_nanos.fetch_add(env->NowNanos() - start_nanos,
+                                     std::memory_order_relaxed);
+              },
+              runner, max_parallelism);
+  estimate->Record(total, busy_nanos.load(std::memory_order_relaxed));
 }
 
 // DEPRECATED: Prefer threadpool->TransformRangeConcurrently, which allows you
@@ -57,6 +57,14 @@ namespace tensorflow {
 void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
            int64 cost_per_unit, std::function<void(int64, int64)> work);
 
+// Like Shard() above, but shards with the cost per unit learned by "estimate"
+// (see thread::AdaptiveCostEstimate), falling back to "cost_per_unit" until a
+// call has been recorded. If "estimate" is nullptr, this is equivalent to
+// Shard(max_parallelism, workers, total, cost_per_unit, work).
+void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
+           int64 cost_per_unit, thread::AdaptiveCostEstimate* estimate,
+           std::function<void(int64, int64)> work);
+
 // Each thread has an associated option to express the desired maximum
 // parallelism. Its default is a very large quantity.
 //
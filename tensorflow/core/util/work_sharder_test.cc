@@ -89,6 +89,25 @@ TEST(Shard, OverflowTest) {
   }
 }
 
+TEST(Shard, AdaptiveCostEstimate) {
+  thread::ThreadPool threads(Env::Default(), "test", 16);
+  thread::AdaptiveCostEstimate estimate("ShardAdaptiveCostEstimate");
+  const int64 total = 1000;
+  // Both with the pool's sharding and with a capped parallelism.
+  for (auto workers : {4, 100}) {
+    std::atomic<int64> num_done_work(0);
+    Shard(workers, &threads, total, 1000, &estimate,
+          [&num_done_work](int64 start, int64 limit) {
+            num_done_work += limit - start;
+          });
+    EXPECT_EQ(total, num_done_work.load());
+  }
+  const thread::AdaptiveCostEstimate::Stats stats = estimate.GetStats();
+  EXPECT_EQ(2, stats.num_calls);
+  EXPECT_EQ(2 * total, stats.num_units);
+  EXPECT_EQ(1000, stats.static_cost_per_unit);
+}
+
 void BM_Sharding(int iters, int arg) {
   thread::ThreadPool threads(Env::Default(), "test", 16);
   const int64 total = 1LL << 30;